@@ -0,0 +1,149 @@
+/*
+  qcp-degenerate
+
+  Checks that the QCP superposition used by alignment::kabsch() finds
+  the optimal rotation for degenerate (linear and planar) structures,
+  by comparing it against the SVD solution from alignment::kabschCore().
+*/
+
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <loos.hpp>
+
+using namespace std;
+using namespace loos;
+using namespace loos::alignment;
+
+
+const uint natoms = 12;
+
+
+// Atoms along a line through the origin in direction d, unevenly spaced
+vecDouble linear(const GCoord& d, const double scale) {
+  vecDouble v;
+  GCoord u = d / d.length();
+  for (uint i=0; i<natoms; ++i) {
+    double t = scale * (i + 0.3 * (i % 3)) - 5.0;
+    for (uint j=0; j<3; ++j)
+      v.push_back(t * u[j]);
+  }
+  return(v);
+}
+
+
+// Atoms on the plane spanned by a and b
+vecDouble planar(const GCoord& a, const GCoord& b, const double scale) {
+  vecDouble v;
+  for (uint i=0; i<natoms; ++i) {
+    double s = scale * cos(0.9 * i) * (1.0 + 0.1 * i);
+    double t = 2.0 * sin(1.3 * i);
+    GCoord c = s * a + t * b;
+    for (uint j=0; j<3; ++j)
+      v.push_back(c[j]);
+  }
+  return(v);
+}
+
+
+vecDouble random3d(const int seed) {
+  base_generator_type& rng = rng_singleton();
+  rng.seed(seed);
+  boost::uniform_real<> dist(-5.0, 5.0);
+  boost::variate_generator<base_generator_type&, boost::uniform_real<> > uni(rng, dist);
+
+  vecDouble v;
+  for (uint i=0; i<3*natoms; ++i)
+    v.push_back(uni());
+  return(v);
+}
+
+
+// Best possible RMSD, from the singular values of the correlation matrix
+double svdRMSD(const vecDouble& U, const vecDouble& V) {
+  vecDouble cU(U), cV(V);
+  centerAtOrigin(cU);
+  centerAtOrigin(cV);
+
+  SVDTupleVec svd = kabschCore(cU, cV);
+  const vecDouble& S = boost::get<1>(svd);
+
+  double e = 0.0;
+  for (uint i=0; i<cU.size(); ++i)
+    e += cU[i] * cU[i] + cV[i] * cV[i];
+  e -= 2.0 * (S[0] + S[1] + S[2]);
+
+  return(sqrt(fabs(e) / natoms));
+}
+
+
+// RMSD after actually applying the transform from kabsch()
+double superposedRMSD(const vecDouble& U, const vecDouble& V) {
+  GMatrix M = kabsch(U, V);
+  vecDouble W(U);
+  applyTransform(M, W);
+  return(rmsd(W, V));
+}
+
+
+int check(const string& label, const vecDouble& U, const vecDouble& V) {
+  double expected = svdRMSD(U, V);
+  double found = superposedRMSD(U, V);
+  double qcp = alignedRMSD(U, V);
+
+  if (fabs(found - expected) > 1e-4 || fabs(qcp - expected) > 1e-4) {
+    cerr << label << ": SVD RMSD = " << expected << ", QCP RMSD = " << qcp
+         << ", RMSD after superposition = " << found << endl;
+    return(1);
+  }
+  return(0);
+}
+
+
+int main(int argc, char *argv[]) {
+  GCoord x(1,0,0), y(0,1,0), z(0,0,1);
+  GCoord d1(1, 2, 3), d2(-2, 0.5, 1), d3(0.3, -1, 0.2);
+
+  int failures = 0;
+
+  failures += check("linear/linear (same line)", linear(x, 1.0), linear(x, 1.3));
+  failures += check("linear/linear", linear(d1, 1.0), linear(d2, 1.0));
+  failures += check("linear/linear (opposite)", linear(d1, 1.0), linear(-d1, 1.2));
+  failures += check("linear/3d", linear(d2, 1.0), random3d(7));
+  failures += check("3d/linear", random3d(11), linear(d3, 0.8));
+
+  failures += check("planar/planar (same plane)", planar(x, y, 1.0), planar(x, y, 1.4));
+  failures += check("planar/planar", planar(x, y, 1.0), planar(d1, d2, 1.0));
+  failures += check("planar/planar (mirrored)", planar(x, y, 1.0), planar(y, x, 1.0));
+  failures += check("planar/3d", planar(d2, d3, 1.0), random3d(13));
+  failures += check("3d/planar", random3d(17), planar(z, d1, 0.7));
+  failures += check("linear/planar", linear(d1, 1.0), planar(d2, d3, 1.0));
+  failures += check("planar/linear", planar(x, z, 1.0), linear(d2, 1.0));
+
+  if (failures) {
+    cerr << "qcp-degenerate: FAILED (" << failures << " cases)" << endl;
+    return(-1);
+  }
+
+  cout << "qcp-degenerate: passed" << endl;
+  return(0);
+}
@@ -0,0 +1,97 @@
+/*
+  verlet-drift
+
+  Checks that a VerletList is rebuilt when the periodic box drifts
+  slowly (as in a constant pressure simulation) by more than the skin
+  in total, even though no single frame changes it by that much.
+*/
+
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <loos.hpp>
+
+using namespace std;
+using namespace loos;
+
+
+// Contacts found by checking every pair
+uint bruteForce(const AtomicGroup& group, const double cutoff, const GCoord& box) {
+  double cut2 = cutoff * cutoff;
+  uint n = 0;
+  for (uint i=0; i<group.size(); ++i)
+    for (uint j=i+1; j<group.size(); ++j)
+      if (group[i]->coords().distance2(group[j]->coords(), box) <= cut2)
+        ++n;
+  return(n);
+}
+
+
+int main(int argc, char *argv[]) {
+  const double cutoff = 4.0;
+  const double skin = 1.0;
+
+  // A pair of atoms on either side of the box boundary, just beyond
+  // cutoff + skin of each other through the periodic image, plus a
+  // few bystanders in the middle of the box
+  AtomicGroup group;
+  group.append(pAtom(new Atom(1, "A", GCoord(0.5, 10.0, 10.0))));
+  group.append(pAtom(new Atom(2, "B", GCoord(24.4, 10.0, 10.0))));
+  group.append(pAtom(new Atom(3, "C", GCoord(10.0, 10.0, 10.0))));
+  group.append(pAtom(new Atom(4, "D", GCoord(12.0, 11.0, 10.0))));
+  group.append(pAtom(new Atom(5, "E", GCoord(14.0, 13.0, 11.0))));
+  for (uint i=0; i<group.size(); ++i)
+    group[i]->index(i);
+
+  GCoord box(30.0, 30.0, 30.0);
+  VerletList vlist(group, cutoff, skin);
+  vlist.rebuild(box);
+
+  // Shrink the box by 0.1 per frame, 2.5 in total.  The A-B distance
+  // through the boundary drops from 6.1 to 3.6
+  int failures = 0;
+  for (uint frame = 0; frame < 25; ++frame) {
+    box -= GCoord(0.1, 0.0, 0.0);
+    vlist.update(box);
+
+    uint expected = bruteForce(group, cutoff, box);
+    uint found = vlist.count();
+    if (found != expected) {
+      cerr << "Frame " << frame << ": box " << box << " has " << expected
+           << " contacts but the VerletList found " << found << endl;
+      ++failures;
+    }
+  }
+
+  if (vlist.builds() < 2) {
+    cerr << "VerletList was never rebuilt as the box drifted" << endl;
+    ++failures;
+  }
+
+  if (failures) {
+    cerr << "verlet-drift: FAILED" << endl;
+    return(-1);
+  }
+
+  cout << "verlet-drift: passed" << endl;
+  return(0);
+}
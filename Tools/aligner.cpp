@@ -44,10 +44,6 @@ const uint min_align_selection_warning = 7;   // Warn user when selecting fewer
                                               // This number has not been rigorously determined...
 
 
-const long memory_threshold = 75;             // Using more than this percentage of main memory to store
-                                              // the coordinates for aligning generates a warning
-
-typedef loos::alignment::vecMatrix   vMatrix;
 
 
 uint verbosity = 0;
@@ -168,11 +164,13 @@ public:
 
 
 
-void zapZ(vMatrix& M) {
-  uint n = M[0].size();
-  for (uint i=0; i<M.size(); ++i)
+void zapZ(FrameBuffer& frames) {
+  uint n = frames.natoms() * 3;
+  for (uint i=0; i<frames.nframes(); ++i) {
+    float* p = frames.frame(i);
     for (uint j=2; j<n; j += 3)
-      M[i][j] = 0.0;
+      p[j] = 0.0;
+  }
 }
 
 
@@ -204,10 +202,11 @@ int main(int argc, char *argv[]) {
   opts::OutputPrefix* prefopts = new opts::OutputPrefix;
   opts::TrajectoryWithFrameIndices* tropts = new opts::TrajectoryWithFrameIndices;
   opts::OutputTrajectoryTypeOptions *otopts = new opts::OutputTrajectoryTypeOptions;
+  opts::ThreadOptions* thopts = new opts::ThreadOptions(0);
   ToolOptions* topts = new ToolOptions;
 
   opts::AggregateOptions options;
-  options.add(bopts).add(prefopts).add(tropts).add(otopts).add(topts);
+  options.add(bopts).add(prefopts).add(tropts).add(otopts).add(thopts).add(topts);
   if (!options.parse(argc, argv))
     exit(-1);
 
@@ -233,20 +232,17 @@ int main(int argc, char *argv[]) {
 
   if (topts->reference_name.empty()) {
 
-    // estimate memory requirements...
-    long used_memory = 3 * align_sub.size() * indices.size() * sizeof(double);
-    if (used_memory * 100l / availableMemory() > memory_threshold) {
-      cerr << boost::format("Warning- estimating that memory used for aligning is greater than %d%% of system memory.\n") % memory_threshold;
-      cerr << "         Consider subsampling the trajectory or using a smaller alignment selection.\n";
-    }
-
+    // The coordinates are read once and kept in a FrameBuffer, which
+    // spills to a temporary file if the trajectory is too large...
     if (verbosity)
       cerr << "Reading coordinates...\n";
-    vMatrix coords = readCoords(align_sub, traj, indices, verbosity);
+    FrameBuffer frames(align_sub, traj, indices);
+    if (verbosity && frames.spilled())
+      cerr << "Coordinates are too large for memory, so will be cached on disk.\n";
     if (topts->xy_only)
-      zapZ(coords);
+      zapZ(frames);
     
-    boost::tuple<vector<XForm>,greal, int> res = iterativeAlignment(coords, topts->alignment_tol, topts->maxiter);
+    boost::tuple<vector<XForm>,greal, int> res = iterativeAlignment(frames, topts->alignment_tol, topts->maxiter);
     greal final_rmsd = boost::get<1>(res);
     cerr << "Final RMSD between average structures is " << final_rmsd << endl;
     cerr << "Total iters = " << boost::get<2>(res) << endl;
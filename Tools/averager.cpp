@@ -149,7 +149,7 @@ int main(int argc, char *argv[]) {
     AtomicGroup align_subset = selectAtoms(model, sopts->selection);
     cerr << "Aligning with " << align_subset.size() << " atoms.\n";
 
-    boost::tuple<vector<XForm>, greal, int> result = iterativeAlignment(align_subset, traj, indices);
+    boost::tuple<vector<XForm>, greal, int> result = bufferedIterativeAlignment(align_subset, traj, indices);
     xforms = boost::get<0>(result);
     double rmsd = boost::get<1>(result);
     int niters = boost::get<2>(result);
@@ -103,11 +103,12 @@ string fullHelpMessage() {
     "\tTo get a correct fractional contact value, you will need to ensure that\n"
     "anything that can make a contact is included in the target list.  Alternatively,\n"
     "use the fcontacts tool.\n"
-    "\tBy default, contact-time uses a distance filter to eliminate\n"
-    "target atoms that are too far to be considered when looking\n"
-    "at each probe atom.  The padding for the radius used to\n"
-    "exclude target atoms can be adjusted with the '--fastpad' option.\n"
-    "In the unlikely event the filter causes problems, it can\n"
+    "\tBy default, contact-time uses a neighbor (Verlet) list for each\n"
+    "target, holding the probe/target pairs within the outer cutoff plus\n"
+    "a padding distance.  The list is only rebuilt when atoms have moved\n"
+    "far enough that a new contact could have been missed, so most frames\n"
+    "only need to check the pairs already in the list.  The padding can be\n"
+    "adjusted with the '--fastpad' option.  The neighbor lists can\n"
     "be disabled with '--fast=0'.\n";
   
   return(s);
@@ -139,8 +140,8 @@ public:
       ("outer", po::value<double>(&outer_cutoff)->default_value(outer_cutoff), "Outer cutoff (ignore atoms further away than this)")
       ("reimage", po::value<bool>(&symmetry)->default_value(symmetry), "Consider symmetry when computing distances")
       ("autoself", po::value<bool>(&auto_self)->default_value(auto_self), "Automatically include self-to-self")
-      ("fast", po::value<bool>(&fast_filter)->default_value(fast_filter), "Use the fast-filter method")
-      ("fastpad", po::value<double>(&fast_pad)->default_value(fast_pad), "Padding for the fast-filter method");
+      ("fast", po::value<bool>(&fast_filter)->default_value(fast_filter), "Use neighbor lists to find contacts")
+      ("fastpad", po::value<double>(&fast_pad)->default_value(fast_pad), "Padding (skin) for the neighbor lists");
   }
 
   void addHidden(po::options_description& o) {
@@ -222,40 +223,6 @@ uint contacts(const AtomicGroup& target, const AtomicGroup& probe, const double
 }
 
 
-AtomicGroup pickNearbyAtoms(const AtomicGroup& target, const AtomicGroup& probe, const double radius, const bool symmetry) {
-
-  GCoord c = probe.centroid();
-  GCoord box = probe.periodicBox();
-  double maxrad = probe.radius() + radius;
-  maxrad *= maxrad;
-
-  
-  AtomicGroup nearby;
-  nearby.periodicBox(probe.periodicBox());
-  for (AtomicGroup::const_iterator i = target.begin(); i != target.end(); ++i) {
-    double d = symmetry ? c.distance2((*i)->coords(), box) : c.distance2((*i)->coords());
-    if (d <= maxrad)
-      nearby.append(*i);
-  }
-
-  return(nearby);
-}
-
-
-uint fastContacts(const AtomicGroup& target, const vGroup& probes, const double inner, const double outer, const double fast_pad, const bool symmetry) {
-  uint total_contacts = 0;
-
-  
-  for (vGroup::const_iterator i = probes.begin(); i != probes.end(); ++i) {
-    AtomicGroup new_target = pickNearbyAtoms(target, *i, outer+fast_pad, symmetry);
-    uint c = contacts(new_target, *i, inner, outer, symmetry);
-    total_contacts += c;
-  }
-
-  return(total_contacts);
-}
-
-
 // Given a vector of groups, compute the number of contacts between
 // unique pairs of groups, excluding the self-to-self
 //
@@ -359,12 +326,17 @@ int main(int argc, char *argv[]) {
 
   // If comparing self, split apart molecules by unique segids
   vGroup myselves;
-  if (topts->auto_self || topts->fast_filter) {
-    if (topts->auto_self)
-      ++cols;
+  if (topts->auto_self) {
+    ++cols;
     myselves = probe.splitByUniqueSegid();
   }
 
+  // Neighbor lists between the probe and each target, reused across frames
+  vector<VerletList> neighbors;
+  if (topts->fast_filter)
+    for (uint i=0; i<targets.size(); ++i)
+      neighbors.push_back(VerletList(probe, targets[i], topts->outer_cutoff, topts->fast_pad));
+
   uint t = 0;
   DoubleMatrix M(rows, cols);
 
@@ -388,9 +360,13 @@ int main(int argc, char *argv[]) {
     M(t, 0) = t;
     for (uint i=0; i<targets.size(); ++i) {
       double d;
-      if (topts->fast_filter)
-        d = fastContacts(targets[i], myselves, topts->inner_cutoff, topts->outer_cutoff, topts->fast_pad, topts->symmetry);
-      else
+      if (topts->fast_filter) {
+        if (topts->symmetry)
+          neighbors[i].update(model.periodicBox());
+        else
+          neighbors[i].update();
+        d = neighbors[i].count(topts->inner_cutoff, topts->outer_cutoff);
+      } else
         d = contacts(targets[i], probe, topts->inner_cutoff, topts->outer_cutoff, topts->symmetry);
 
       M(t, i+1) = d;
@@ -49,6 +49,7 @@ int downsample_rate;
 bool skip_first_frame=false;
 bool reimage_by_molecule=false;
 bool selection_split=false;
+uint xtc_threads=0;
 
 
 // @cond TOOLS_INTERNAL
@@ -75,6 +76,7 @@ public:
       ("postcenter", po::value<string>(&postcenter_selection)->default_value(""), "Perform a final recentering using this selection")
       ("postcenter-xy", po::value<string>(&postcenter_xy_selection)->default_value(""), "Perform a final xy recentering")
       ("postcenter-z", po::value<string>(&postcenter_z_selection)->default_value(""), "Perform a final z recentering")
+      ("xtc-threads", po::value<uint>(&xtc_threads)->default_value(0), "Threads used to compress XTC output (0 = serial)")
 
       ;
   }
@@ -452,6 +454,9 @@ int main(int argc, char *argv[])
       z_post_recenter = true;
       }
 
+    if (xtc_threads > 0)
+        XTCWriter::defaultCompressionThreads(xtc_threads);
+
     pTrajectoryWriter output = createOutputTrajectory(output_traj, true);
 
     pTrajectoryWriter output_downsample;
@@ -197,15 +197,31 @@ uint doSplit(const AtomicGroup &system, const string selection,
     // make sure the "result" vector<AG> is empty to start
     grouping.clear();
 
+    Parser parser(selection);
+    KernelSelector parsed_sel(parser.kernel());
+
+    // Residues are split as views, so only the selected atoms get
+    // copied into new groups
+    if (split == BY_RESIDUE)
+        {
+        vector<AtomicGroupView> residues = system.splitByResidueView();
+        vector<AtomicGroupView>::const_iterator r;
+        for (r=residues.begin(); r!=residues.end(); ++r)
+            {
+            AtomicGroupView newgroup = r->select(parsed_sel);
+            if (!newgroup.empty())
+                {
+                grouping.push_back(newgroup.materialize());
+                }
+            }
+        return grouping.size();
+        }
+
     vector<AtomicGroup> tmp;
     if (split == BY_MOLECULE)
         {
         tmp = system.splitByMolecule();
         }
-    if (split == BY_RESIDUE)
-        {
-        tmp = system.splitByResidue();
-        }
     else if (split == BY_SEGMENT)
         {
         tmp = system.splitByUniqueSegid();
@@ -215,9 +231,6 @@ uint doSplit(const AtomicGroup &system, const string selection,
         tmp.push_back(system);
         }
 
-    Parser parser(selection);
-    KernelSelector parsed_sel(parser.kernel());
-
     vector<AtomicGroup>::iterator t;
     for (t=tmp.begin(); t!=tmp.end(); ++t)
         {
@@ -167,6 +167,7 @@ int main(int argc, char *argv[]) {
   pTraj ptraj = tropts->trajectory;
   AtomicGroup subset = selectAtoms(molecule, topts->selection);
   vector<uint> indices = tropts->frameList();
+  ptraj->setAtomSubset(subset);
 
   AtomicGroup target;
   AtomicGroup target_subset;
@@ -194,6 +195,7 @@ int main(int argc, char *argv[]) {
     // First, parse the alignment selection and extract the
     // appropriate bits from the trajectory model...
     AtomicGroup align_subset = selectAtoms(molecule, topts->alignment);
+    ptraj->setAtomSubset(subset + align_subset);
 
     // Iteratively align the trajectory...
     if (topts->target_name.empty()) {
@@ -209,7 +211,7 @@ int main(int argc, char *argv[]) {
 
       for (uint i=0; i<indices.size(); i++) {
         ptraj->readFrame(indices[i]);
-        ptraj->updateGroupCoords(molecule);
+        ptraj->updateGroupCoords(align_subset);
         GMatrix M = align_subset.superposition(target_align);
         XForm W(M);
         transforms.push_back(W);
@@ -31,14 +31,12 @@
 
 #include <loos.hpp>
 #include <unistd.h>
-#include <boost/thread/thread.hpp>
 
 
 using namespace std;
 using namespace loos;
 
 
-typedef boost::thread*   Thread;
 
 namespace opts = loos::OptionsFramework;
 namespace po = loos::OptionsFramework::po;
@@ -80,11 +78,22 @@ string fullHelpMessage(void) {
     "is diagnostic of the sampling quality of a simulation.\n"
     "\n"
     "\tThe requested subset for each frame is cached in memory for better performance.\n"
-    "If the memory used by the cache gets too large, your machine may swap and dramatically slow\n"
-    "down.  The tool will try to warn you if this is a possibility.  To use less memory, subsample\n"
+    "If the cache would be too large, it is instead kept in a temporary file on disk.  The matrix\n"
+    "itself is always kept in memory, and if it gets too large your machine may swap and dramatically\n"
+    "slow down.  The tool will try to warn you if this is a possibility.  To use less memory, subsample\n"
     "the trajectory either by using the --range1 and --range2 options, or use subsetter to pre-process\n"
     "the trajectory.\n"
     "\n"
+    "\tFor very large matrices, use the --out option to write the matrix to a binary file\n"
+    "instead.  The matrix is then never held in memory: it is computed in tiles and each finished\n"
+    "tile is written directly to the file (with --mmap, through a memory-mapping of the file).  The\n"
+    "completed tiles are checkpointed in the file as the calculation proceeds, so if it is interrupted,\n"
+    "running the same command again with --resume will only compute the tiles that are missing.\n"
+    "The --cache option sets how much memory (in MB) may be used for the cached frames before they\n"
+    "are moved to a temporary file.  The binary file starts with a header and per-tile flags, and the\n"
+    "matrix is stored as single-precision floats in row-major order (see RMSDMatrixFile in LOOS).\n"
+    "Statistics are not available in this mode.\n"
+    "\n"
     "\tThis tool can be run in parallel with multiple threads for performance.  The --threads option\n"
     "controls how many threads are used.  The default is 1 (non-parallel).  Setting it to 0 will use\n"
     "as many threads as possible.  Note that if LOOS was built using a multi-threaded math library,\n"
@@ -113,6 +122,11 @@ string fullHelpMessage(void) {
     "This example compares two trajectories, active and inactive, and uses different selections\n"
     "for both: the first 50 residues from the inactive and residues 20-69 from the active.\n"
     "\n"
+    "\trmsds --threads=0 --out=rmsd.bin --resume=1 model.pdb simulation.dcd\n"
+    "This example writes the matrix to the binary file rmsd.bin, using all available cores.\n"
+    "If rmsd.bin is left over from an interrupted run, the calculation continues from its\n"
+    "last checkpoint.\n"
+    "\n"
     "NOTES\n"
     "\tWhen using two trajectories, the selections must match both in number of atoms selected\n"
     "and in the sequence of atoms (i.e. the first atom in the --sel2 selection is\n" 
@@ -134,7 +148,6 @@ public:
   void addGeneric(po::options_description& o) {
     o.add_options()
       ("noout,N", po::value<bool>(&noop)->default_value(false), "Do not output the matrix (i.e. only calc pair-wise RMSD stats)")
-      ("threads", po::value<uint>(&nthreads)->default_value(1), "Number of threads to use (0=all available)")
       ("sel1", po::value<string>(&sel1)->default_value("name == 'CA'"), "Atom selection for first system")
       ("skip1", po::value<uint>(&skip1)->default_value(0), "Skip n-frames of first trajectory")
       ("range1", po::value<string>(&range1), "Matlab-style range of frames to use from first trajectory")
@@ -142,7 +155,11 @@ public:
       ("skip2", po::value<uint>(&skip2)->default_value(0), "Skip n-frames of second trajectory")
       ("range2", po::value<string>(&range2), "Matlab-style range of frames to use from second trajectory")
       ("stats", po::value<bool>(&stats)->default_value(false), "Show some statistics for matrix")
-      ("precision,p", po::value<uint>(&matrix_precision)->default_value(2), "Write out matrix coefficients with this many digits.");
+      ("precision,p", po::value<uint>(&matrix_precision)->default_value(2), "Write out matrix coefficients with this many digits.")
+      ("out,o", po::value<string>(&outfile), "Write the matrix to this binary file out-of-core instead of to stdout")
+      ("resume", po::value<bool>(&resume)->default_value(false), "Resume an interrupted --out calculation from its checkpoint")
+      ("mmap", po::value<bool>(&mapped)->default_value(false), "Write the --out file through a memory-mapping")
+      ("cache", po::value<ulong>(&cache)->default_value(FrameBuffer::default_memory_budget >> 20), "Memory (MB) for cached frames before using a temporary file");
   }
 
   void addHidden(po::options_description& o) {
@@ -173,11 +190,14 @@ public:
 
   string print() const {
     ostringstream oss;
-    oss << boost::format("stats=%d,noout=%d,nthreads=%d,sel1='%s',skip1=%d,range1='%s',sel2='%s',skip2=%d,range2='%s',model1='%s',traj1='%s',model2='%s',traj2='%s'")
+    oss << boost::format("stats=%d,noout=%d,precision=%d,out='%s',resume=%d,mmap=%d,cache=%d,sel1='%s',skip1=%d,range1='%s',sel2='%s',skip2=%d,range2='%s',model1='%s',traj1='%s',model2='%s',traj2='%s'")
       % stats
       % noop
-      % nthreads
       % matrix_precision
+      % outfile
+      % resume
+      % mapped
+      % cache
       % sel1
       % skip1
       % range1
@@ -195,229 +215,19 @@ public:
 
   bool stats;
   bool noop;
+  bool resume, mapped;
+  ulong cache;
+  string outfile;
   uint skip1, skip2;
-  uint nthreads;
   uint matrix_precision;
   string range1, range2;
   string model1, traj1, model2, traj2;
   string sel1, sel2;
 };
 
-typedef vector<double>    vecDouble;
-typedef vector<vecDouble>   vMatrix;
-
-
 // @endcond TOOLS_INTERNAL
 
 
-// --------------------------------------------------------------------------------------
-
-// Parcels out work to the compute threads...  Work is given to the threads
-// one row at a time.
-
-class Master {
-public:
-
-  Master(const uint nr, const bool tr, const bool b) : _toprow(0), _maxrow(nr), _updatefreq(500), _triangle(tr),
-                                                       _verbose(b), _start_time(time(0))
-  {
-    if (_triangle)
-      _total = _maxrow*(_maxrow-1) / 2;
-    else
-      _total = _maxrow;
-  }
-
-  // Checks whether there are any columns left to work on
-  // and places the column index into the passed pointer.
-
-  bool workAvailable(uint* ip) 
-  {
-
-    _mtx.lock();
-    if (_toprow >= _maxrow) {
-      _mtx.unlock();
-      return(false);
-    }
-    *ip = _toprow++;
-
-    if (_verbose)
-      if (_toprow % _updatefreq == 0)
-        updateStatus();
-    
-    _mtx.unlock();
-    return(true);
-  }
-
-
-  void updateStatus() {
-    time_t dt = elapsedTime();
-    uint work_done = _triangle ? (_toprow * (_toprow-1) / 2) : (_toprow);
-    uint work_left = _total - work_done;
-    uint d = work_left * dt / work_done;    // rate = work_done / dt;  d = work_left / rate;
-    
-    uint hrs = d / 3600;
-    uint remain = d % 3600;
-    uint mins = remain / 60;
-    uint secs = remain % 60;
-    
-    cerr << boost::format("Row %5d /%5d, Elapsed = %5d s, Remaining = %02d:%02d:%02d\n")
-      % _toprow % _maxrow % dt % hrs % mins % secs;
-  }
-
-
-  
-  time_t elapsedTime() const 
-  {
-    return (time(0) - _start_time);
-  }
-
-
-private:
-  uint _toprow, _maxrow;
-  uint _updatefreq;
-  bool _triangle;
-  bool _verbose;
-  time_t _start_time;
-  uint _total;
-  boost::mutex _mtx;
-
-};
-
-
-
-
-
-
-/*
-  Worker thread processes a column of the all-to-all matrix.  Gets which
-  column to work on from the associated Master object.
-*/
-
-
-// Worker for two different trajectories
-
-class DualWorker 
-{
-public:
-  DualWorker(RealMatrix* R, vMatrix* T1, vMatrix* T2, Master* M) : _R(R), _T1(T1), _T2(T2), _M(M), _maxcol(T2->size()) { }
-
-
-  DualWorker(const DualWorker& w) 
-  {
-    _R = w._R;
-    _T1 = w._T1;
-    _T2 = w._T2;
-    _M = w._M;
-    _maxcol = w._maxcol;
-  }
-  
-
-  void calc(const uint i) 
-  {
-    for (uint j=0; j<_maxcol; ++j) {
-      double d = loos::alignment::centeredRMSD((*_T1)[i], (*_T2)[j]);
-      (*_R)(i, j) = d;
-    }
-  }
-
-  void operator()() 
-  {
-    uint i;
-    
-    while (_M->workAvailable(&i))
-      calc(i);
-  }
-  
-
-private:
-  RealMatrix* _R;
-  vMatrix* _T1;
-  vMatrix* _T2;
-  Master* _M;
-  uint _maxcol;
-};
-
-
-
-// Worker for self all-to-all
-
-class SingleWorker 
-{
-public:
-  SingleWorker(RealMatrix* R, vMatrix* T, Master* M) : _R(R), _T(T), _M(M) { }
-
-
-  SingleWorker(const SingleWorker& w) 
-  {
-    _R = w._R;
-    _T = w._T;
-    _M = w._M;
-  }
-  
-
-  void calc(const uint i) 
-  {
-    for (uint j=0; j<i; ++j) {
-      double d = loos::alignment::centeredRMSD((*_T)[i], (*_T)[j]);
-      (*_R)(j, i) = (*_R)(i, j) = d;
-    }
-  }
-
-  void operator()() 
-  {
-    uint i;
-    
-    while (_M->workAvailable(&i))
-      calc(i);
-  }
-  
-
-private:
-  RealMatrix* _R;
-  vMatrix* _T;
-  Master* _M;
-};
-
-
-
-// Top level object/interface.  Will create np Worker threads, cloned from the
-// one passed into the constructor.
-
-template<class W>
-class Threader 
-{
-public:
-  Threader(W* wrkr, const uint np) :
-    worker(wrkr),
-    threads(vector<Thread>(np))
-  {
-
-    for (uint i=0; i<np; ++i) {
-      W w(*worker);
-      threads[i] = new boost::thread(w);
-    }
-    
-  }
-
-
-  void join() 
-  {
-    for (uint i=0; i<threads.size(); ++i)
-      threads[i]->join();
-  }
-  
-
-  ~Threader() 
-  {
-    for (uint i=0; i<threads.size(); ++i)
-      delete threads[i];
-  }
-
-  W* worker;
-  vector<Thread> threads;
-};
-
-
 // --------------------------------------------------------------------------------------
 
 
@@ -456,13 +266,6 @@ void showStatsWhole(const RealMatrix& R) {
 
 
 
-void centerTrajectory(alignment::vecMatrix& U) {
-  for (uint i=0; i<U.size(); ++i)
-    alignment::centerAtOrigin(U[i]);
-}
-
-
-
 void checkMemoryUsage(long mem) {
   if (!mem)
     return;
@@ -486,49 +289,72 @@ void checkMemoryUsage(long mem) {
 
 
 
+void writeMatrixFile(const RMSDFrames& A, const RMSDFrames* B, const ToolOptions* topts, const RMSDMatrixOptions& engine) {
+  bool symmetric = (B == 0);
+  const RMSDFrames& other = symmetric ? A : *B;
+
+  RMSDMatrixFile out(topts->outfile, A.nframes(), other.nframes(), symmetric,
+                     engine.tile ? engine.tile : rmsdTileSize(A), topts->resume, topts->mapped);
+  if (verbosity > 1)
+    cerr << boost::format("Writing %d x %d matrix to %s (%d of %d tiles done)\n")
+      % out.rows() % out.cols() % topts->outfile % out.tilesDone() % out.numberOfTiles();
+
+  if (symmetric)
+    allToAllRMSD(A, out, engine);
+  else
+    allToAllRMSD(A, *B, out, engine);
+}
+
+
+
 int main(int argc, char *argv[]) {
   string header = invocationHeader(argc, argv);
   
   opts::BasicOptions* bopts = new opts::BasicOptions(fullHelpMessage());
+  opts::ThreadOptions* thopts = new opts::ThreadOptions;
   ToolOptions* topts = new ToolOptions;
 
   opts::AggregateOptions options;
-  options.add(bopts).add(topts);
+  options.add(bopts).add(thopts).add(topts);
   if (!options.parse(argc, argv))
     exit(-1);
 
   verbosity = bopts->verbosity;
   report_stats = (verbosity || topts->noop);
+  bool out_of_core = !topts->outfile.empty();
+  ulong budget = topts->cache << 20;
+
   AtomicGroup model = createSystem(topts->model1);
   pTraj traj = createTrajectory(topts->traj1, model);
   AtomicGroup subset = selectAtoms(model, topts->sel1);
   vector<uint> indices = assignTrajectoryFrames(traj, topts->range1, topts->skip1);
 
   long mem = availableMemory();
-  uint nthreads = topts->nthreads ? topts->nthreads : boost::thread::hardware_concurrency();
-  
+
+  RMSDMatrixOptions engine;
+  engine.verbose = verbosity;
+
   if (verbosity > 1) {
-    cerr << "Using " << nthreads << " threads\n";
+    cerr << "Using " << ThreadPool::globalThreads() << " threads\n";
     cerr << "Reading trajectory - " << topts->traj1 << endl;
   }
-  vMatrix T = readCoords(subset, traj, indices, verbosity > 1);
-  used_memory += T.size() * T[0].size() * sizeof(vMatrix::value_type::value_type);   // Coords matrix
-  used_memory += T.size() * T.size() * sizeof(RealMatrix::element_type);             // RMSDS matrix
+  RMSDFrames T(subset, traj, indices, budget);
+  if (!T.spilled())
+    used_memory += static_cast<long>(T.nframes()) * T.stride() * 3 * sizeof(float);   // Coords
+  if (!out_of_core)
+    used_memory += static_cast<long>(T.nframes()) * T.nframes() * sizeof(RealMatrix::element_type);  // RMSDS matrix
   checkMemoryUsage(mem);
-  centerTrajectory(T);
 
   RealMatrix M;
   if (topts->model2.empty()) {
 
     if (verbosity > 1)
       cerr << "Calculating RMSD...\n";
-    M = RealMatrix(T.size(), T.size());
-    Master master(T.size(), true, verbosity);
-    SingleWorker worker(&M, &T, &master);
-    Threader<SingleWorker> threads(&worker, nthreads);
-    threads.join();
-    if (verbosity) 
-      master.updateStatus();
+    if (out_of_core) {
+      writeMatrixFile(T, 0, topts, engine);
+      return(0);
+    }
+    M = allToAllRMSD(T, engine);
     
     if (verbosity || topts->noop || topts->stats)
       showStatsHalf(M);
@@ -541,21 +367,21 @@ int main(int argc, char *argv[]) {
 
     if (verbosity > 1)
       cerr << "Reading trajectory - " << topts->traj2 << endl;
-    vMatrix T2 = readCoords(subset2, traj2, indices2, verbosity > 1);
-    used_memory += T2.size() * T2[0].size() * sizeof(double);
+    RMSDFrames T2(subset2, traj2, indices2, budget);
+    if (!T2.spilled())
+      used_memory += static_cast<long>(T2.nframes()) * T2.stride() * 3 * sizeof(float);
+    if (!out_of_core)
+      used_memory += static_cast<long>(T.nframes()) * T2.nframes() * sizeof(RealMatrix::element_type)
+        - static_cast<long>(T.nframes()) * T.nframes() * sizeof(RealMatrix::element_type);
     checkMemoryUsage(mem);
-    centerTrajectory(T2);
 
     if (verbosity > 1)
       cerr << "Calculating RMSD...\n";
-    M = RealMatrix(T.size(), T2.size());
-    Master master(T.size(), false, verbosity);
-    DualWorker worker(&M, &T, &T2, &master);
-    Threader<DualWorker> threads(&worker, nthreads);
-    threads.join();
-
-    if (verbosity)
-      master.updateStatus();
+    if (out_of_core) {
+      writeMatrixFile(T, &T2, topts, engine);
+      return(0);
+    }
+    M = allToAllRMSD(T, T2, engine);
 
     if (verbosity || topts->noop || topts->stats)
       showStatsWhole(M);
@@ -567,7 +393,3 @@ int main(int argc, char *argv[]) {
   }
 
 }
-
-
-  
-
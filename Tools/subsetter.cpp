@@ -458,8 +458,8 @@ void showTrajectoryTable(MultiTrajectory& traj) {
         % "N/A"
         % "N/A"
         % n
-        % traj[i]->nframes()
-        % traj[i]->filename();
+        % traj.trajectoryFrames(i)
+        % traj.trajectoryFilename(i);
     else
     {
       cout << boost::format("%5d %8d %8d %8d %8d %s\n")
@@ -467,8 +467,8 @@ void showTrajectoryTable(MultiTrajectory& traj) {
         % start_cnt
         % (start_cnt + n - 1)
         % n
-        % traj[i]->nframes()
-        % traj[i]->filename();
+        % traj.trajectoryFrames(i)
+        % traj.trajectoryFilename(i);
       ++j;
     }
     start_cnt += n;
@@ -316,7 +316,7 @@ void writeMatrixChunk(opts::OutputPrefix* popts, opts::MultiTrajOptions* tropts,
   string filename;
 
   if (topts->autoname) {
-    boost::filesystem::path p(tropts->mtraj[index]->filename());
+    boost::filesystem::path p(tropts->mtraj.trajectoryFilename(index));
 #if BOOST_FILESYSTEM_VERSION >= 3
     filename = p.stem().string() + "_V.asc";
 #else
@@ -355,6 +355,7 @@ int main(int argc, char *argv[]) {
   vector<uint> indices = tropts->frameList();
 
   AtomicGroup svdsub = selectAtoms(model, topts->svd_string);
+  ptraj->setAtomSubset(svdsub);
 
   write_map(prefix + ".map", svdsub);
 
@@ -366,6 +367,7 @@ int main(int argc, char *argv[]) {
       xforms.push_back(XForm());
   } else {
     AtomicGroup alignsub = selectAtoms(model, topts->alignment_string);
+    ptraj->setAtomSubset(svdsub + alignsub);
     cerr << argv[0] << ": Aligning...\n";
     xforms = doAlign(alignsub, ptraj, indices, topts->alignment_tol);   // Honors indices
   }
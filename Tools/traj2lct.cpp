@@ -0,0 +1,183 @@
+/*
+  traj2lct
+
+  Converts one or more LOOS-supported trajectories into a LOOS chunked
+  trajectory (LCT) for fast analysis
+*/
+
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <loos.hpp>
+
+using namespace std;
+using namespace loos;
+
+namespace opts = loos::OptionsFramework;
+namespace po = loos::OptionsFramework::po;
+
+
+
+string fullHelpMessage(void) {
+  string msg =
+    "\n"
+    "SYNOPSIS\n"
+    "\tConvert trajectories into the LOOS chunked trajectory (LCT) format\n"
+    "\n"
+    "DESCRIPTION\n"
+    "\n"
+    "\tConverts one or more trajectories in any LOOS-supported format into a\n"
+    "single LCT trajectory.  LCT is a LOOS-native format designed to be read\n"
+    "quickly, so if a trajectory will be used for many analyses, it is worth\n"
+    "converting it once.  Any frame in an LCT can be read directly, and tools\n"
+    "that only use a subset of atoms will only read the parts of each frame\n"
+    "they need.  LCT files are read by any LOOS tool when given a .lct suffix.\n"
+    "\n"
+    "\tFrames are grouped into chunks (--chunk frames each), and each chunk\n"
+    "is split into blocks of atoms (--block atoms each).  Blocks are compressed\n"
+    "losslessly unless --compress=0 is given.  Larger chunks and blocks\n"
+    "compress better but use more memory when reading.  Smaller blocks make\n"
+    "reading small selections faster.\n"
+    "\n"
+    "\tAs with subsetter, a selection can be used to only write some atoms, and\n"
+    "the usual skip, stride, and range options apply.  When a selection is\n"
+    "used, a PDB with the same name as the output (but with a .pdb suffix)\n"
+    "is written to use as the model for the new trajectory.\n"
+    "\n"
+    "EXAMPLES\n"
+    "\n"
+    "\ttraj2lct sim.lct model.gro run1.xtc run2.xtc run3.xtc\n"
+    "Combine three XTC trajectories into one LCT trajectory.\n"
+    "\n"
+    "\ttraj2lct --selection '!hydrogen' sim.lct model.psf sim.dcd\n"
+    "Convert the DCD to an LCT, keeping only heavy atoms.  A model\n"
+    "for the new trajectory is written to sim.pdb.\n"
+    "\n"
+    "\ttraj2lct --chunk 64 --block 1024 sim.lct model.psf sim.dcd\n"
+    "Use larger chunks and smaller blocks.\n"
+    "\n"
+    "SEE ALSO\n"
+    "\tsubsetter, merge-traj, traj2dcd\n";
+
+  return(msg);
+}
+
+
+
+// @cond TOOLS_INTERNAL
+class ToolOptions : public opts::OptionsPackage {
+public:
+  ToolOptions() : frames_per_chunk(LCTWriter::default_frames_per_chunk),
+                  atoms_per_block(LCTWriter::default_atoms_per_block),
+                  compress(true)
+  { }
+
+  void addGeneric(po::options_description& o) {
+    o.add_options()
+      ("chunk", po::value<uint>(&frames_per_chunk)->default_value(frames_per_chunk), "Frames per chunk")
+      ("block", po::value<uint>(&atoms_per_block)->default_value(atoms_per_block), "Atoms per block")
+      ("compress", po::value<bool>(&compress)->default_value(compress), "Compress blocks (lossless)");
+  }
+
+  bool postConditions(po::variables_map& map) {
+    if (frames_per_chunk == 0 || atoms_per_block == 0) {
+      cerr << "Error- chunk and block sizes must be greater than zero\n";
+      return(false);
+    }
+    return(true);
+  }
+
+  string print() const {
+    ostringstream oss;
+    oss << boost::format("chunk=%d, block=%d, compress=%d")
+      % frames_per_chunk
+      % atoms_per_block
+      % compress;
+    return(oss.str());
+  }
+
+  uint frames_per_chunk;
+  uint atoms_per_block;
+  bool compress;
+};
+// @endcond
+
+
+
+int main(int argc, char *argv[]) {
+  string hdr = invocationHeader(argc, argv);
+
+  opts::BasicOptions* bopts = new opts::BasicOptions(fullHelpMessage());
+  opts::BasicSelection* sopts = new opts::BasicSelection("all");
+  ToolOptions* topts = new ToolOptions;
+  opts::RequiredArguments* ropts = new opts::RequiredArguments("output", "Output LCT trajectory");
+  opts::MultiTrajOptions* mtopts = new opts::MultiTrajOptions;
+
+  opts::AggregateOptions options;
+  options.add(bopts).add(sopts).add(topts).add(ropts).add(mtopts);
+  if (!options.parse(argc, argv))
+    exit(-1);
+
+  AtomicGroup model = mtopts->model;
+  pTraj traj = mtopts->trajectory;
+  AtomicGroup subset = selectAtoms(model, sopts->selection);
+  traj->setAtomSubset(subset);
+
+  string out_name = ropts->value("output");
+  vector<uint> indices = mtopts->frameList();
+
+  if (bopts->verbosity > 0)
+    cerr << mtopts->trajectoryTable();
+
+  // Only write a new model if the atoms are changing...
+  if (subset.size() != model.size()) {
+    boost::tuple<string, string> names = splitFilename(out_name);
+    string pdb_name = boost::get<0>(names) + ".pdb";
+    PDB pdb = PDB::fromAtomicGroup(subset.copy());
+    pdb.remarks().add(hdr);
+    ofstream ofs(pdb_name.c_str());
+    ofs << pdb;
+  }
+
+  LCTWriter writer(out_name, topts->frames_per_chunk, topts->atoms_per_block, topts->compress);
+  writer.timestep(traj->timestep());
+
+  PercentProgressWithTime watcher;
+  ProgressCounter<PercentTrigger, EstimatingCounter> slayer(PercentTrigger(0.1), EstimatingCounter(indices.size()));
+  slayer.attach(&watcher);
+  if (bopts->verbosity > 0)
+    slayer.start();
+
+  for (vector<uint>::const_iterator i = indices.begin(); i != indices.end(); ++i) {
+    traj->readFrame(*i);
+    traj->updateGroupCoords(subset);
+    writer.writeFrame(subset);
+    if (bopts->verbosity > 0)
+      slayer.update();
+  }
+
+  writer.close();
+
+  if (bopts->verbosity > 0) {
+    slayer.finish();
+    cerr << boost::format("Wrote %d frames of %d atoms to %s\n") % writer.framesWritten() % subset.size() % out_name;
+  }
+}
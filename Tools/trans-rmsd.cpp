@@ -32,7 +32,8 @@
 #include <loos.hpp>
 #include <unistd.h>
 #include <boost/tuple/tuple.hpp>
-#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
 #include <boost/algorithm/string.hpp>
 
 
@@ -40,8 +41,6 @@ using namespace std;
 using namespace loos;
 
 
-typedef boost::thread*   Thread;
-
 namespace opts = loos::OptionsFramework;
 namespace po = loos::OptionsFramework::po;
 
@@ -88,7 +87,6 @@ public:
       ("stride,i", po::value<uint>(&stride)->default_value(1), "Step through sub-trajectories by this amount")
       ("range,r", po::value<std::string>(&frame_index_spec), "Which frames to use in composite trajectory")
       ("noout,N", po::value<bool>(&noop)->default_value(false), "Do not output the matrix (i.e. only calc pair-wise RMSD stats)")
-      ("threads", po::value<uint>(&nthreads)->default_value(1), "Number of threads to use (0=all available)")
       ("cutoff,c", po::value<float>(&cutoff)->default_value(-1.0), "Outputs fraction of frame-pairs below cutoff.")
       ("stats", po::value<bool>(&stats)->default_value(false), "Show some statistics for matrix")
       ("precision,p", po::value<uint>(&matrix_precision)->default_value(2), "Write out matrix coefficients with this many digits.");
@@ -144,13 +142,13 @@ public:
     for (uint i=0; i<mtraj.size(); ++i) {
       uint n = mtraj.nframes(i);
       if (n == 0)
-        oss << boost::format("# Warning- '%s' was skipped due to insufficient frames\n") % mtraj[i]->filename();
+        oss << boost::format("# Warning- '%s' was skipped due to insufficient frames\n") % mtraj.trajectoryFilename(i);
       else {
         oss << boost::format("# %d\t%d\t%d\t%s\n")
           % j
           % start_cnt
           % (start_cnt + n - 1)
-          % mtraj[i]->filename();
+          % mtraj.trajectoryFilename(i);
         ++j;
       }
       start_cnt += n;
@@ -169,10 +167,9 @@ public:
     for (uint i=0; i<trajlist_B.size(); ++i)
       oss << "'" << trajlist_B[i] << "'" << (i < trajlist_B.size() -1 ? "," : "");
     oss << ")";
-    oss << boost::format("stats=%d,noout=%d,nthreads=%d,matrix_precision=%d")
+    oss << boost::format("stats=%d,noout=%d,matrix_precision=%d")
       % stats
       % noop
-      % nthreads
       % matrix_precision; 
     return(oss.str());
   }
@@ -180,7 +177,6 @@ public:
   bool stats;
   bool noop;
   float cutoff;
-  uint nthreads;
   std::string set_A;
   std::string set_B;
   std::vector<string> trajlist_A, trajlist_B;
@@ -203,48 +199,42 @@ typedef vector<vecDouble>   vMatrix;
 
 // --------------------------------------------------------------------------------------
 
-// Parcels out work to the compute threads...  Work is given to the threads
-// one row at a time.
+// Reports progress as rows of the matrix are finished.  Rows may
+// finish out of order, so the work done is tallied as they complete.
 
-class Master {
+class Progress {
 public:
 
-  Master(const uint nr, const bool tr, const bool b) : _toprow(0), _maxrow(nr), _updatefreq(500), _triangle(tr),
-                                                       _verbose(b), _start_time(time(0))
+  Progress(const uint nr, const bool tr, const bool b) : _rows(0), _maxrow(nr), _updatefreq(500), _triangle(tr),
+                                                         _verbose(b), _start_time(time(0)), _work_done(0)
   {
     if (_triangle)
-      _total = _maxrow*(_maxrow-1) / 2;
+      _total = static_cast<ulong>(_maxrow)*(_maxrow-1) / 2;
     else
       _total = _maxrow;
   }
 
-  // Checks whether there are any columns left to work on
-  // and places the column index into the passed pointer.
 
-  bool workAvailable(uint* ip) 
+  void rowDone(const uint i)
   {
-
-    _mtx.lock();
-    if (_toprow >= _maxrow) {
-      _mtx.unlock();
-      return(false);
-    }
-    *ip = _toprow++;
-
-    if (_verbose)
-      if (_toprow % _updatefreq == 0)
-        updateStatus();
-    
-    _mtx.unlock();
-    return(true);
+    if (!_verbose)
+      return;
+
+    boost::lock_guard<boost::mutex> lock(_mtx);
+    ++_rows;
+    _work_done += _triangle ? i : 1;
+    if (_rows % _updatefreq == 0)
+      updateStatus();
   }
 
 
   void updateStatus() {
+    if (_work_done == 0)
+      return;
+
     time_t dt = elapsedTime();
-    uint work_done = _triangle ? (_toprow * (_toprow-1) / 2) : (_toprow);
-    uint work_left = _total - work_done;
-    uint d = work_left * dt / work_done;    // rate = work_done / dt;  d = work_left / rate;
+    ulong work_left = _total - _work_done;
+    ulong d = work_left * dt / _work_done;    // rate = work_done / dt;  d = work_left / rate;
     
     uint hrs = d / 3600;
     uint remain = d % 3600;
@@ -252,7 +242,7 @@ public:
     uint secs = remain % 60;
     
     cerr << boost::format("Row %5d /%5d, Elapsed = %5d s, Remaining = %02d:%02d:%02d\n")
-      % _toprow % _maxrow % dt % hrs % mins % secs;
+      % _rows % _maxrow % dt % hrs % mins % secs;
   }
 
 
@@ -264,12 +254,12 @@ public:
 
 
 private:
-  uint _toprow, _maxrow;
+  uint _rows, _maxrow;
   uint _updatefreq;
   bool _triangle;
   bool _verbose;
   time_t _start_time;
-  uint _total;
+  ulong _total, _work_done;
   boost::mutex _mtx;
 
 };
@@ -280,8 +270,8 @@ private:
 
 
 /*
-  Worker thread processes a column of the all-to-all matrix.  Gets which
-  column to work on from the associated Master object.
+  Worker processes a block of rows of the all-to-all matrix, as handed
+  out by the shared ThreadPool.
 */
 
 
@@ -290,30 +280,21 @@ private:
 class SingleWorker 
 {
 public:
-  SingleWorker(RealMatrix* R, vMatrix* TA, vMatrix* TB, Master* M) : _R(R), _TA(TA), _TB(TB), _M(M) { }
+  SingleWorker(RealMatrix* R, vMatrix* TA, vMatrix* TB, Progress* P) : _R(R), _TA(TA), _TB(TB), _P(P) { }
 
 
-  SingleWorker(const SingleWorker& w) 
-  {
-    _R = w._R;
-    _TA = w._TA;
-    _TB = w._TB;
-    _M = w._M;
-  }
-  
-
-  void calc(const uint i) 
+  void calc(const uint i) const
   {
     for (uint j=0; j<_R->cols(); ++j) 
       (*_R)(i, j) = loos::alignment::centeredRMSD((*_TA)[i], (*_TB)[j]);
   }
 
-  void operator()() 
+  void operator()(const ulong begin, const ulong end) const
   {
-    uint i;
-    
-    while (_M->workAvailable(&i))
+    for (ulong i=begin; i<end; ++i) {
       calc(i);
+      _P->rowDone(i);
+    }
   }
   
 
@@ -321,46 +302,7 @@ private:
   RealMatrix* _R;
   vMatrix* _TA;
   vMatrix* _TB;
-  Master* _M;
-};
-
-
-
-// Top level object/interface.  Will create np Worker threads, cloned from the
-// one passed into the constructor.
-
-template<class W>
-class Threader 
-{
-public:
-  Threader(W* wrkr, const uint np) :
-    worker(wrkr),
-    threads(vector<Thread>(np))
-  {
-
-    for (uint i=0; i<np; ++i) {
-      W w(*worker);
-      threads[i] = new boost::thread(w);
-    }
-    
-  }
-
-
-  void join() 
-  {
-    for (uint i=0; i<threads.size(); ++i)
-      threads[i]->join();
-  }
-  
-
-  ~Threader() 
-  {
-    for (uint i=0; i<threads.size(); ++i)
-      delete threads[i];
-  }
-
-  W* worker;
-  vector<Thread> threads;
+  Progress* _P;
 };
 
 
@@ -456,10 +398,11 @@ int main(int argc, char *argv[]) {
   
   opts::BasicOptions* bopts = new opts::BasicOptions(fullHelpMessage());
   opts::BasicSelection* sopts = new opts::BasicSelection("name == 'backbone' && ! hydrogen");
+  opts::ThreadOptions* thopts = new opts::ThreadOptions;
   ToolOptions* topts = new ToolOptions;
 
   opts::AggregateOptions options;
-  options.add(bopts).add(sopts).add(topts);
+  options.add(bopts).add(sopts).add(thopts).add(topts);
   if (!options.parse(argc, argv))
     exit(-1);
 
@@ -471,10 +414,9 @@ int main(int argc, char *argv[]) {
   vector<uint> indices_B = topts->frameList(topts->trajectory_B);
 
   long mem = availableMemory();
-  uint nthreads = topts->nthreads ? topts->nthreads : boost::thread::hardware_concurrency();
   
   if (verbosity > 1)
-    cerr << "Using " << nthreads << " threads\n";
+    cerr << "Using " << ThreadPool::globalThreads() << " threads\n";
   
   // read in system A
   vMatrix TA = readCoords(subset, topts->trajectory_A, indices_A, verbosity > 1);
@@ -493,13 +435,11 @@ int main(int argc, char *argv[]) {
   if (verbosity > 1)
     cerr << "Calculating RMSD...\n";
   M = RealMatrix(TA.size(), TB.size());
-  // note the 'false' here causes master to do full matrix, not just triangle.
-  Master master(TA.size(), false, verbosity); 
-  SingleWorker worker(&M, &TA, &TB, &master);
-  Threader<SingleWorker> threads(&worker, nthreads);
-  threads.join();
+  // note the 'false' here reports progress for the full matrix, not just triangle.
+  Progress progress(TA.size(), false, verbosity);
+  ThreadPool::global()->parallelFor(0, TA.size(), SingleWorker(&M, &TA, &TB, &progress), 1);
   if (verbosity)
-    master.updateStatus();
+    progress.updateStatus();
 
   if (verbosity || topts->noop || topts->stats || topts->cutoff > 0){
     if (topts->cutoff > 0)
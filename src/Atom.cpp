@@ -50,26 +50,26 @@ namespace loos {
     setPropertyBit(anumbit);
   }
 
-  std::string Atom::name(void) const { return(_name); }
-  void Atom::name(const std::string s) { _name = s; }
+  std::string Atom::name(void) const { return(StringTable::lookup(_name)); }
+  void Atom::name(const std::string s) { _name = StringTable::intern(s); }
 
-  std::string Atom::altLoc(void) const { return(_altloc); }
-  void Atom::altLoc(const std::string s) { _altloc = s; }
+  std::string Atom::altLoc(void) const { return(StringTable::lookup(_altloc)); }
+  void Atom::altLoc(const std::string s) { _altloc = StringTable::intern(s); }
 
-  std::string Atom::chainId(void) const { return(_chainid); }
-  void Atom::chainId(const std::string s) { _chainid = s; }
+  std::string Atom::chainId(void) const { return(StringTable::lookup(_chainid)); }
+  void Atom::chainId(const std::string s) { _chainid = StringTable::intern(s); }
 
-  std::string Atom::resname(void) const { return(_resname); }
-  void Atom::resname(const std::string s) { _resname = s; }
+  std::string Atom::resname(void) const { return(StringTable::lookup(_resname)); }
+  void Atom::resname(const std::string s) { _resname = StringTable::intern(s); }
 
-  std::string Atom::segid(void) const { return(_segid); }
-  void Atom::segid(const std::string s) { _segid = s; }
+  std::string Atom::segid(void) const { return(StringTable::lookup(_segid)); }
+  void Atom::segid(const std::string s) { _segid = StringTable::intern(s); }
 
-  std::string Atom::iCode(void) const { return(_icode); }
-  void Atom::iCode(const std::string s) { _icode = s; }
+  std::string Atom::iCode(void) const { return(StringTable::lookup(_icode)); }
+  void Atom::iCode(const std::string s) { _icode = StringTable::intern(s); }
 
-  std::string Atom::PDBelement(void) const { return(_pdbelement); }
-  void Atom::PDBelement(const std::string s) { _pdbelement = s; }
+  std::string Atom::PDBelement(void) const { return(StringTable::lookup(_pdbelement)); }
+  void Atom::PDBelement(const std::string s) { _pdbelement = StringTable::intern(s); }
 
   const GCoord& Atom::coords(void) const { return(_coords); }
   GCoord& Atom::coords(void) { setPropertyBit(coordsbit); return(_coords); }
@@ -102,8 +102,8 @@ namespace loos {
     //! Recordname imported from the PDB for this Atom
     //! This is mainly for atoms that come from a PDB, i.e. whether or
     //! not they were an ATOM or a HETATM
-  std::string Atom::recordName(void) const { return(_record); }
-  void Atom::recordName(const std::string s) { _record = s; }
+  std::string Atom::recordName(void) const { return(StringTable::lookup(_record)); }
+  void Atom::recordName(const std::string s) { _record = StringTable::intern(s); }
 
     //! Clear all stored bonds
   void Atom::clearBonds(void) { bonds.clear(); clearPropertyBit(bondsbit); }
@@ -195,13 +195,22 @@ namespace loos {
     _q = 1.0;
     _charge = 0.0;
     _mass = 1.0;
-    _name = "    ";
-    _altloc = " ";
-    _resname = "   ";
-    _chainid = " ";
-    _segid = "    ";
-    _pdbelement = "";
-    _record = "ATOM";
+
+    // Interning takes a lock, so only look up the defaults once
+    static const StringTable::Handle empty = StringTable::intern(std::string());
+    static const StringTable::Handle blank1 = StringTable::intern(" ");
+    static const StringTable::Handle blank3 = StringTable::intern("   ");
+    static const StringTable::Handle blank4 = StringTable::intern("    ");
+    static const StringTable::Handle atom = StringTable::intern("ATOM");
+
+    _name = blank4;
+    _altloc = blank1;
+    _resname = blank3;
+    _chainid = blank1;
+    _segid = blank4;
+    _icode = empty;
+    _pdbelement = empty;
+    _record = atom;
     _atom_type = -1;
     mask = nullbit;   // Nullbit means nothing was set...
   }
@@ -212,11 +221,11 @@ namespace loos {
 
 
   std::ostream& operator<<(std::ostream& os, const loos::Atom& a) {
-    os << "<ATOM INDEX='" << a._index << "' ID='" << a._id << "' NAME='" << a._name << "' ";
-    os << "RESID='" << a._resid << "' RESNAME='" << a._resname << "' ";
+    os << "<ATOM INDEX='" << a._index << "' ID='" << a._id << "' NAME='" << a.name() << "' ";
+    os << "RESID='" << a._resid << "' RESNAME='" << a.resname() << "' ";
     os << "COORDS='" << a._coords << "' ";
     os << "VELOCITIES='" << a._velocities << "' ";
-    os << "ALTLOC='" << a._altloc << "' CHAINID='" << a._chainid << "' ICODE='" << a._icode << "' SEGID='" << a._segid << "' ";
+    os << "ALTLOC='" << a.altLoc() << "' CHAINID='" << a.chainId() << "' ICODE='" << a.iCode() << "' SEGID='" << a.segid() << "' ";
     os << "B='" << a._b << "' Q='" << a._q << "' CHARGE='" << a._charge << "' MASS='" << a._mass << "'";
     os << " ATOMICNUMBER='" << a._atomic_number <<"'";
     os << " MASK='" << boost::format("%x") % a.mask << "'";
@@ -233,19 +242,19 @@ namespace loos {
 
 
   bool AtomEquals::operator()(const pAtom& a, const pAtom& b) const {
-    return(a->name() == b->name()
+    return(a->nameHandle() == b->nameHandle()
            && a->id() == b->id()
-           && a->resname() == b->resname()
+           && a->resnameHandle() == b->resnameHandle()
            && a->resid() == b->resid()
-           && a->segid() == b->segid());
+           && a->segidHandle() == b->segidHandle());
   }
 
   bool AtomCoordsEquals::operator()(const pAtom& a, const pAtom& b) const {
-    bool bb = (a->name() == b->name()
+    bool bb = (a->nameHandle() == b->nameHandle()
                && a->id() == b->id()
-               && a->resname() == b->resname()
+               && a->resnameHandle() == b->resnameHandle()
                && a->resid() == b->resid()
-               && a->segid() == b->segid());
+               && a->segidHandle() == b->segidHandle());
     if (!bb)
       return(false);
 
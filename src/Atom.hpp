@@ -32,6 +32,7 @@
 #include <loos_defs.hpp>
 #include <exceptions.hpp>
 #include <Coord.hpp>
+#include <StringTable.hpp>
 
 namespace loos {
 
@@ -44,6 +45,11 @@ namespace loos {
    * Most properties are derived from the PDB file specification.
    * Exceptions are noted below.  Accessors for each property are
    * provided and should be self-explanatory...
+   *
+   * String properties (name, resname, segid, etc) are stored as
+   * handles into the global StringTable, so the strings themselves are
+   * shared by all atoms.  The handles are also available, and comparing
+   * them is equivalent to (but much faster than) comparing the strings.
    */
 
   
@@ -91,7 +97,7 @@ namespace loos {
       init();
       _index = 0;
       _id = i;
-      _name = s;
+      _name = StringTable::intern(s);
       _coords = c;
     }
 
@@ -132,6 +138,12 @@ namespace loos {
     std::string PDBelement(void) const;
     void PDBelement(const std::string);
 
+    //! StringTable handles for the corresponding string properties
+    uint nameHandle(void) const { return(_name); }
+    uint resnameHandle(void) const { return(_resname); }
+    uint segidHandle(void) const { return(_segid); }
+    uint chainIdHandle(void) const { return(_chainid); }
+
 
 #if !defined(SWIG)
     //! Returns a const ref to internally stored coordinates.
@@ -207,6 +219,11 @@ namespace loos {
     //! Returns a copy of the bond list.
     std::vector<int> getBonds(void) const;
 
+#if !defined(SWIG)
+    //! Returns a const ref to the bond list, avoiding the copy
+    const std::vector<int>& bondList(void) const { return(bonds); }
+#endif
+
     //! Sets the bonds list
     void setBonds(const std::vector<int>& list);
 
@@ -265,12 +282,13 @@ namespace loos {
   private:
     int _id;
     uint _index;
-    std::string _record, _name, _altloc, _resname, _chainid;
+    // StringTable handles
+    StringTable::Handle _record, _name, _altloc, _resname, _chainid;
     int _resid;
     int _atomic_number;
-    std::string _icode;
+    StringTable::Handle _icode;
     double _b, _q, _charge, _mass;
-    std::string _segid, _pdbelement;
+    StringTable::Handle _segid, _pdbelement;
     int _atom_type;
     GCoord _coords;
     GCoord _velocities;
@@ -0,0 +1,108 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <AtomFactory.hpp>
+
+#include <algorithm>
+#include <new>
+
+#include <boost/make_shared.hpp>
+
+
+namespace loos {
+
+  const uint AtomFactory::min_block_size;
+  const uint AtomFactory::max_block_size;
+
+
+  namespace internal {
+
+    // Raw storage for a fixed number of atoms.  Atoms are constructed
+    // in place one at a time and destroyed when the block goes away.
+    class AtomBlock {
+    public:
+      explicit AtomBlock(const uint n) :
+        _atoms(static_cast<Atom*>(::operator new(n * sizeof(Atom)))),
+        _capacity(n), _used(0)
+      { }
+
+      ~AtomBlock() {
+        for (uint i=0; i<_used; ++i)
+          _atoms[i].~Atom();
+        ::operator delete(_atoms);
+      }
+
+      bool full() const { return(_used == _capacity); }
+      uint available() const { return(_capacity - _used); }
+
+      Atom* construct() {
+        Atom* p = new (_atoms + _used) Atom;
+        ++_used;
+        return(p);
+      }
+
+      Atom* construct(const Atom& a) {
+        Atom* p = new (_atoms + _used) Atom(a);
+        ++_used;
+        return(p);
+      }
+
+    private:
+      AtomBlock(const AtomBlock&);
+      AtomBlock& operator=(const AtomBlock&);
+
+      Atom* _atoms;
+      uint _capacity, _used;
+    };
+
+  }
+
+
+
+  void AtomFactory::reserve(const uint n) {
+    if (n == 0 || (_block && _block->available() >= n))
+      return;
+    _block = boost::make_shared<internal::AtomBlock>(n);
+  }
+
+
+  pAtom AtomFactory::create() {
+    if (!_block || _block->full()) {
+      _block = boost::make_shared<internal::AtomBlock>(_next_size);
+      _next_size = std::min(2 * _next_size, max_block_size);
+    }
+
+    // Aliasing constructor: the pAtom shares the block's count
+    return(pAtom(_block, _block->construct()));
+  }
+
+
+  pAtom AtomFactory::create(const Atom& a) {
+    if (!_block || _block->full()) {
+      _block = boost::make_shared<internal::AtomBlock>(_next_size);
+      _next_size = std::min(2 * _next_size, max_block_size);
+    }
+
+    return(pAtom(_block, _block->construct(a)));
+  }
+
+}
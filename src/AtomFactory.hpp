@@ -0,0 +1,95 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(LOOS_ATOM_FACTORY_HPP)
+#define LOOS_ATOM_FACTORY_HPP
+
+#include <boost/shared_ptr.hpp>
+
+#include <loos_defs.hpp>
+#include <Atom.hpp>
+
+
+namespace loos {
+
+  namespace internal {
+    class AtomBlock;
+  }
+
+  //! Creates Atoms in bulk
+  /**
+   * Creating each atom with "new Atom" means two heap allocations per
+   * atom (the Atom and the shared_ptr bookkeeping), which dominates
+   * reading in large systems.  An AtomFactory instead constructs atoms
+   * in place in large blocks of memory, and all atoms from a block
+   * share a single shared_ptr count.  The pAtoms that are returned
+   * behave exactly like any other pAtom.
+   *
+   * The catch is that the memory for a block is only released when
+   * every atom from that block has been released.  Keeping a handful
+   * of atoms from a large system (e.g. via a selection) keeps the
+   * whole system's atoms in memory.  Use AtomicGroup::copy() if you
+   * need to keep only a few atoms around.
+   *
+   * Blocks start small and double in size, so small structures do not
+   * waste much memory.  If the number of atoms is known in advance,
+   * use reserve() (or the sized constructor) so they all come from
+   * one block.
+   *
+   * Copying a factory gives a new factory that does not share any
+   * blocks with the original.
+   */
+  class AtomFactory {
+  public:
+    static const uint min_block_size = 64;
+    static const uint max_block_size = 65536;
+
+    AtomFactory() : _next_size(min_block_size) { }
+
+    //! Prepares for creating \a n atoms
+    explicit AtomFactory(const uint n) : _next_size(min_block_size) { reserve(n); }
+
+    AtomFactory(const AtomFactory&) : _next_size(min_block_size) { }
+    AtomFactory& operator=(const AtomFactory&) {
+      _block.reset();
+      _next_size = min_block_size;
+      return(*this);
+    }
+
+    //! Returns a new, default-constructed atom
+    pAtom create();
+
+    //! Returns a new atom that is a copy of \a a
+    pAtom create(const Atom& a);
+
+    //! Ensures the next \a n atoms created will come from the same block
+    void reserve(const uint n);
+
+  private:
+    boost::shared_ptr<internal::AtomBlock> _block;
+    uint _next_size;
+  };
+
+}
+
+
+#endif
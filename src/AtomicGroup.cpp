@@ -33,6 +33,7 @@
 #include <boost/random.hpp>
 
 #include <AtomicGroup.hpp>
+#include <BondTable.hpp>
 #include <AtomicNumberDeducer.hpp>
 #include <Selectors.hpp>
 
@@ -56,9 +57,11 @@ namespace loos {
   AtomicGroup AtomicGroup::copy(void) const {
     const_iterator i;
     AtomicGroup res;
+    AtomFactory factory(atoms.size());
 
+    res.atoms.reserve(atoms.size());
     for (i = atoms.begin(); i != atoms.end(); i++) {
-      pAtom pa(new Atom(**i));
+      pAtom pa = factory.create(**i);
       res.append(pa);
     }
     res._sorted = _sorted;
@@ -249,10 +252,10 @@ namespace loos {
 
 
 
-  // Internal: calculates the start and stop iterators given offset and len args
+  // Internal: calculates the start and stop indices given offset and len args
   // as in PERL's substr()...
 
-  boost::tuple<AtomicGroup::iterator, AtomicGroup::iterator> AtomicGroup::calcSubsetIterators(const int offset, const int len) {
+  std::pair<uint, uint> AtomicGroup::calcSubsetRange(const int offset, const int len) const {
     unsigned int a, b;
 
     if (offset < 0) {
@@ -266,7 +269,13 @@ namespace loos {
     if (b-a >= atoms.size())
       throw(std::range_error("Indices out of bounds for subsetting"));
 
-    boost::tuple<iterator, iterator> res(atoms.begin() + a, atoms.begin() + b);
+    return(std::pair<uint, uint>(a, b));
+  }
+
+
+  boost::tuple<AtomicGroup::iterator, AtomicGroup::iterator> AtomicGroup::calcSubsetIterators(const int offset, const int len) {
+    std::pair<uint, uint> range = calcSubsetRange(offset, len);
+    boost::tuple<iterator, iterator> res(atoms.begin() + range.first, atoms.begin() + range.second);
 
     return(res);
   }
@@ -304,10 +313,11 @@ namespace loos {
   AtomicGroup AtomicGroup::select(const AtomSelector& sel) const {
     AtomicGroup res;
 
-    std::vector<pAtom>::const_iterator i;
-    for (i=atoms.begin(); i != atoms.end(); i++)
-      if (sel(*i))
-        res.addAtom(*i);
+    boost::dynamic_bitset<> picked = sel.mask(atoms);
+    res.atoms.reserve(picked.count());
+    for (uint i=0; i<atoms.size(); ++i)
+      if (picked[i])
+        res.addAtom(atoms[i]);
 
     res.box = box;
     return(res);
@@ -343,18 +353,18 @@ namespace loos {
 
   std::map<std::string, AtomicGroup> AtomicGroup::splitByName(void) const {
     const_iterator i;
-    std::map<std::string, AtomicGroup> groups;
 
-    // Loop over atoms, adding them to groups based on their name, creating the
-    // map entry for each new name as we find it
-    std::map<std::string, AtomicGroup>::iterator g;
+    // Group atoms by their StringTable handles, which is much cheaper
+    // than comparing the names themselves, then convert to names at the end
+    boost::unordered_map<uint, AtomicGroup> by_handle;
+    boost::unordered_map<uint, AtomicGroup>::iterator g;
     for (i = atoms.begin(); i != atoms.end(); ++i) {
-        g = groups.find((*i)->name());
-        if (g == groups.end()) { // not found, need to create a new AG
+        g = by_handle.find((*i)->nameHandle());
+        if (g == by_handle.end()) { // not found, need to create a new AG
             AtomicGroup ag;
             ag.append(*i);
             ag.box = box; // copy the current groups periodic box
-            groups[(*i)->name()] = ag;
+            by_handle[(*i)->nameHandle()] = ag;
         }  else {              // found group for that atom name,
                                // so add the atom to it
             g->second.append(*i);
@@ -362,27 +372,28 @@ namespace loos {
 
     }
 
+    std::map<std::string, AtomicGroup> groups;
+    for (g = by_handle.begin(); g != by_handle.end(); ++g)
+      groups[StringTable::lookup(g->first)] = g->second;
+
     return(groups);
   }
 
-  /** The idea is that we iterate over the list of contained atoms.  For
-   * each atom, we recurse through the list of bonded atoms.  Each time
-   * we visit an atom, we mark it as having been seen via the hash_set.
-   * In the recursive function, every time we find a new unseen atom, we
-   * append it to the current group and mark it as seen, then recurse
-   * through all of its bonded atoms.
-   *
-   * Since splitByMolecule() recurses through the connectivity list,
-   * the ordering of the atoms returned will not necessarily be the
-   * same as the input group.  We therefore sort each group returned
-   * to hopefully maintain correct relative ordering.
+  /** The group's connectivity is first converted into a BondTable,
+   * then a union-find pass over the bonds labels each atom with the
+   * molecule it belongs to.  This is linear in the number of atoms
+   * plus bonds and, unlike walking the bonds recursively, cannot
+   * overflow the stack for very large molecules.
    *
-   * If we find a bond that goes to an atom that does not exist in the
-   * current group, a std::runtime_error is thrown.
+   * Molecules are returned in the order of their lowest atom-id, and
+   * the atoms in each molecule are sorted by atom-id.  Bonds to atoms
+   * that are not in the group are ignored.  If more than one atom has
+   * the same atom-id, only the first is kept.  No empty molecules are
+   * returned.
    *
-   * Note that for efficiency of atom lookup, the group gets sorted.
-   * This is why the public function splitByMolecule() makes a copy of
-   * itself and calls sortingSplitByMolecule() on that...
+   * Note that the group gets sorted.  This is why the public function
+   * splitByMolecule() makes a copy of itself and calls
+   * sortingSplitByMolecule() on that...
    */
 
   std::vector<AtomicGroup> AtomicGroup::sortingSplitByMolecule(void) {
@@ -393,25 +404,31 @@ namespace loos {
       sort();
       molecules.push_back(*this);
     } else {
-      HashInt seen;                      // Track what atoms we've already processed
-      AtomicGroup current;               // The molecule we're currently building...
       AtomicGroup working(*this);        // Copy, so we can sort without mucking up original order
       working.sort();
 
+      std::vector<uint> labels;
+      uint ncomponents = BondTable(working).components(labels);
+
+      // Duplicate atom-ids are skipped, which can leave a component
+      // with no atoms, so molecules are numbered as they are first
+      // seen.  Atoms are visited in sorted order, so each molecule
+      // ends up sorted and the molecules are ordered by lowest atom-id.
+      std::vector<int> molecule_of(ncomponents, -1);
       int n = size();
       for (int i=0; i<n; i++) {
-        HashInt::iterator it = seen.find(working.atoms[i]->id());
-        if (it != seen.end())
+        if (i > 0 && working.atoms[i]->id() == working.atoms[i-1]->id())
           continue;
-
-        walkBonds(current, seen, working, working.atoms[i]);
-        if (current.size() != 0) {       // Just in case...
-          current.sort();
-          molecules.push_back(current);
-          current = AtomicGroup();
+        int& k = molecule_of[labels[i]];
+        if (k < 0) {
+          k = molecules.size();
+          molecules.push_back(AtomicGroup());
         }
-
+        molecules[k].addAtom(working.atoms[i]);
       }
+
+      for (uint i=0; i<molecules.size(); ++i)
+        molecules[i]._sorted = true;
     }
 
     // copy the box over
@@ -423,36 +440,6 @@ namespace loos {
   }
 
 
-  void AtomicGroup::walkBonds(AtomicGroup& current, HashInt& seen, AtomicGroup& working, pAtom& moi) {
-    int myid = moi->id();
-    HashInt::iterator it = seen.find(myid);
-
-    // If we've touched this atom before, stop recursing and return.
-    if (it != seen.end())
-      return;
-
-    // This is a novel atom, so append it into the group we're currently building.
-    seen.insert(myid);
-    current.addAtom(moi);
-
-    // Just in case it's a solo-atom...  This probably should indicate
-    // some kind of error...?
-    if (!(moi->hasBonds()))
-      return;
-
-    // Now find atoms that are bound to the current atom and recurse
-    // through them...
-
-    std::vector<int> bonds = moi->getBonds();
-    std::vector<int>::const_iterator citer;
-    for (citer = bonds.begin(); citer != bonds.end(); citer++) {
-      pAtom toi = working.findById(*citer);
-      if (toi != 0)
-        walkBonds(current, seen, working, toi);
-    }
-  }
-
-
   /**
    * Splits an AtomicGroup into individual residues.  The residue
    * boundary is marked by either a change in the resid or in the
@@ -1047,9 +1034,10 @@ namespace loos {
   AtomicGroup AtomicGroup::centrifyByMolecule() const {
     std::vector<AtomicGroup> mols = splitByMolecule();
     AtomicGroup centers;
+    AtomFactory factory(mols.size());
     for (std::vector<AtomicGroup>::const_iterator i = mols.begin(); i != mols.end(); ++i) {
       pAtom orig = (*i)[0];
-      pAtom atom(new Atom(*orig));
+      pAtom atom = factory.create(*orig);
       atom->name("CEN");
       atom->coords((*i).centerOfMass());
       centers.append(atom);
@@ -1061,9 +1049,10 @@ namespace loos {
   AtomicGroup AtomicGroup::centrifyByResidue() const {
     std::vector<AtomicGroup> residues = splitByResidue();
     AtomicGroup centers;
+    AtomFactory factory(residues.size());
     for (std::vector<AtomicGroup>::const_iterator i = residues.begin(); i != residues.end(); ++i) {
       pAtom orig = (*i)[0];
-      pAtom atom(new Atom(*orig));
+      pAtom atom = factory.create(*orig);
       atom->name("CEN");
       atom->coords((*i).centerOfMass());
       centers.append(atom);
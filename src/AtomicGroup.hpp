@@ -34,12 +34,15 @@
 #include <algorithm>
 
 #include <boost/unordered_set.hpp>
+#include <boost/dynamic_bitset.hpp>
 
 
 #include <loos_defs.hpp>
 
 
 #include <Atom.hpp>
+#include <AtomFactory.hpp>
+#include <CellList.hpp>
 #include <XForm.hpp>
 #include <PeriodicBox.hpp>
 #include <utils.hpp>
@@ -58,6 +61,23 @@ namespace loos {
     //! Atom is selected for an operation (or addition to a new group).
     //! If false, then the passed Atom is skipped.
     virtual bool operator()(const pAtom& atom) const =0;
+
+#if !defined(SWIG)
+    //! Applies the selector to a list of atoms at once
+    /** Bit i of the returned mask is set if atoms[i] is selected.  The
+     *  default just calls operator() for each atom, but selectors that
+     *  can work on the whole list more efficiently (such as
+     *  KernelSelector) override this.
+     */
+    virtual boost::dynamic_bitset<> mask(const std::vector<pAtom>& atoms) const {
+      boost::dynamic_bitset<> picked(atoms.size());
+      for (uint i=0; i<atoms.size(); ++i)
+        if ((*this)(atoms[i]))
+          picked.set(i);
+      return(picked);
+    }
+#endif
+
     virtual ~AtomSelector() { }
   };
 
@@ -65,6 +85,8 @@ namespace loos {
   class AtomicGroup;
   typedef boost::shared_ptr<AtomicGroup> pAtomicGroup;
 
+  class AtomicGroupView;
+
 
   //! Class for handling groups of Atoms (pAtoms, actually)
   /** This class contains a collection of shared pointers to Atoms
@@ -103,8 +125,9 @@ namespace loos {
      */
     AtomicGroup(const int n) : _sorted(true) {
       assert(n >= 1 && "Invalid size in AtomicGroup(n)");
+      AtomFactory factory(n);
       for (int i=1; i<=n; i++) {
-        pAtom pa(new Atom);
+        pAtom pa = factory.create();
         pa->id(i);
         atoms.push_back(pa);
       }
@@ -330,6 +353,19 @@ namespace loos {
     std::map<std::string, AtomicGroup> splitByName(void) const;
 
 
+    //! View of the whole group (see AtomicGroupView)
+    AtomicGroupView view(void) const;
+
+    //! View of a subset of the group, using the same arguments as subset()
+    AtomicGroupView subsetView(const int offset, const int len = 0) const;
+
+    //! View of the atoms for which sel predicate returns true
+    AtomicGroupView selectView(const AtomSelector& sel) const;
+
+    //! Same as splitByResidue(), but returns views into this group
+    std::vector<AtomicGroupView> splitByResidueView(void) const;
+
+
     //! Replace a group with the center of masses of contained molecules
     /**
      * The AtomicGroup is split into molecules.  A new group is constructed
@@ -363,6 +399,8 @@ namespace loos {
 #if !defined(SWIG)
     //! Output the group in pseudo-XML format...
     friend std::ostream& operator<<(std::ostream& os, const AtomicGroup& grp);
+
+    friend class AtomicGroupView;
 #endif
 
     // Some misc support routines...
@@ -792,10 +830,17 @@ namespace loos {
     // without and with periodicity.  These can be passed to functions
     // that need to support both ways of calculating distances, such
     // was within_private() below...
+    //
+    // They also know how to bin a group into a CellList using the
+    // same periodicity, so large searches can avoid testing every
+    // pair of atoms.
     struct Distance2WithoutPeriodicity {
       double operator()(const GCoord& a, const GCoord& b) const {
         return(a.distance2(b));
       }
+
+      bool canUseCells() const { return(true); }
+      void bin(CellList& cells, const AtomicGroup& g) const { cells.update(g); }
     };
 
     struct Distance2WithPeriodicity {
@@ -805,9 +850,19 @@ namespace loos {
         return(a.distance2(b, _box));
       }
 
+      bool canUseCells() const { return(_box.x() > 0.0 && _box.y() > 0.0 && _box.z() > 0.0); }
+      void bin(CellList& cells, const AtomicGroup& g) const { cells.update(g, _box); }
+
       GCoord _box;
     };
 
+    // Whether or not a search testing n pairs of atoms out to dist
+    // should use a CellList
+    template<typename DistanceCalc>
+    static bool useCellList(const double n, const double dist, const DistanceCalc& distance_function) {
+      return(n > CellList::pair_threshold && dist > 0.0 && distance_function.canUseCells());
+    }
+
 
 
     // Find all atoms in the current group that are within dist
@@ -825,12 +880,32 @@ namespace loos {
       double dist2 = dist * dist;
       std::vector<uint> indices;
 
-      for (uint j=0; j<size(); j++) {
-        GCoord c = atoms[j]->coords();
-        for (uint i=0; i<grp.size(); i++) {
-          if (distance_functor(c, grp.atoms[i]->coords()) <= dist2) {
-            indices.push_back(j);
-            break;
+      if (useCellList(static_cast<double>(size()) * grp.size(), dist, distance_functor)) {
+        CellList cells(dist);
+        distance_functor.bin(cells, grp);
+        std::vector<uint> near;
+
+        for (uint j=0; j<size(); j++) {
+          GCoord c = atoms[j]->coords();
+          near.clear();
+          cells.candidates(c, near);
+          for (std::vector<uint>::const_iterator i = near.begin(); i != near.end(); ++i) {
+            if (distance_functor(c, grp.atoms[*i]->coords()) <= dist2) {
+              indices.push_back(j);
+              break;
+            }
+          }
+        }
+
+      } else {
+
+        for (uint j=0; j<size(); j++) {
+          GCoord c = atoms[j]->coords();
+          for (uint i=0; i<grp.size(); i++) {
+            if (distance_functor(c, grp.atoms[i]->coords()) <= dist2) {
+              indices.push_back(j);
+              break;
+            }
           }
         }
       }
@@ -850,6 +925,23 @@ namespace loos {
       double dist2 = dist * dist;
       uint ncontacts = 0;
 
+      if (useCellList(static_cast<double>(size()) * grp.size(), dist, distance_function)) {
+        CellList cells(dist);
+        distance_function.bin(cells, grp);
+        std::vector<uint> near;
+
+        for (uint j = 0; j<size(); ++j) {
+          GCoord c = atoms[j]->coords();
+          near.clear();
+          cells.candidates(c, near);
+          for (std::vector<uint>::const_iterator i = near.begin(); i != near.end(); ++i)
+            if (distance_function(c, grp.atoms[*i]->coords()) <= dist2)
+              if (++ncontacts >= min_contacts)
+                return(true);
+        }
+        return(false);
+      }
+
       for (uint j = 0; j<size(); ++j) {
         GCoord c = atoms[j]->coords();
 	    for (uint i = 0; i<grp.size(); ++i)
@@ -871,6 +963,29 @@ namespace loos {
 		  double dist2 = dist * dist;
 		  double current_dist2;
 
+		  // Bonds are added in the same order as the all-pairs search
+		  // below, so the resulting bond lists are identical
+		  if (useCellList(0.5 * size() * size(), dist, distance_function)) {
+			  CellList cells(dist);
+			  distance_function.bin(cells, *this);
+			  std::vector<uint> near;
+
+			  for (uint j = 0; j < size(); ++j) {
+				  GCoord u = atoms[j]->coords();
+				  near.clear();
+				  cells.candidates(u, near);
+				  std::sort(near.begin(), near.end());
+				  for (std::vector<uint>::const_iterator i = std::upper_bound(near.begin(), near.end(), j); i != near.end(); ++i) {
+					  current_dist2 = distance_function(u, atoms[*i]->coords());
+					  if (current_dist2 < dist2) {
+						  atoms[j]->addBond(atoms[*i]);
+						  atoms[*i]->addBond(atoms[j]);
+					  }
+				  }
+			  }
+			  return;
+		  }
+
 		  for (ij = begin(); ij != end() - 1; ++ij) {
 			  iterator ii;
 			  GCoord u = (*ij)->coords();
@@ -901,6 +1016,7 @@ namespace loos {
     void addAtom(pAtom pa) { atoms.push_back(pa); _sorted = false; }
     void deleteAtom(pAtom pa);
 
+    std::pair<uint, uint> calcSubsetRange(const int offset, const int len = 0) const;
     boost::tuple<iterator, iterator> calcSubsetIterators(const int offset, const int len = 0);
 
     void copyCoordinatesById(AtomicGroup& g);
@@ -918,10 +1034,6 @@ namespace loos {
       int id;
     };
 
-    typedef boost::unordered_set<int> HashInt;
-
-    void walkBonds(AtomicGroup& mygroup, HashInt& seen, AtomicGroup& working, pAtom& moi);
-
 
     double *coordsAsArray(void) const;
     double *transformedCoordsAsArray(const XForm&) const;
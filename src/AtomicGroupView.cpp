@@ -0,0 +1,231 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include <AtomicGroupView.hpp>
+#include <exceptions.hpp>
+
+#include <cmath>
+
+
+namespace loos {
+
+  AtomicGroupView::AtomicGroupView(const AtomicGroup& parent) : _parent(&parent), _indices(parent.size()) {
+    for (uint i=0; i<_indices.size(); ++i)
+      _indices[i] = i;
+  }
+
+
+  AtomicGroupView::AtomicGroupView(const AtomicGroup& parent, const Indices& indices) : _parent(&parent), _indices(indices) {
+    for (Indices::const_iterator i = _indices.begin(); i != _indices.end(); ++i)
+      if (*i >= parent.size())
+        throw(LOOSError("Index is out of range for the AtomicGroupView parent"));
+  }
+
+
+  AtomicGroupView AtomicGroupView::select(const AtomSelector& sel) const {
+    Indices idx;
+    for (Indices::const_iterator i = _indices.begin(); i != _indices.end(); ++i)
+      if (sel(_parent->atoms[*i]))
+        idx.push_back(*i);
+
+    return(AtomicGroupView(*_parent, idx));
+  }
+
+
+  AtomicGroup AtomicGroupView::materialize(void) const {
+    AtomicGroup res;
+    res.atoms.reserve(_indices.size());
+    for (Indices::const_iterator i = _indices.begin(); i != _indices.end(); ++i)
+      res.atoms.push_back(_parent->atoms[*i]);
+
+    res.box = _parent->box;
+    return(res);
+  }
+
+
+  std::vector<GCoord> AtomicGroupView::boundingBox(void) const {
+    std::vector<GCoord> res(2);
+    if (_indices.empty())
+      return(res);
+
+    GCoord lo = coords(0);
+    GCoord hi = lo;
+    for (uint i=1; i<_indices.size(); ++i) {
+      const GCoord& c = coords(i);
+      for (int j=0; j<3; ++j) {
+        if (hi[j] < c[j])
+          hi[j] = c[j];
+        if (lo[j] > c[j])
+          lo[j] = c[j];
+      }
+    }
+
+    res[0] = lo;
+    res[1] = hi;
+    return(res);
+  }
+
+
+  GCoord AtomicGroupView::centroid(void) const {
+    if (_indices.size() == 1)
+      return(coords(0));
+
+    GCoord c(0,0,0);
+    for (uint i=0; i<_indices.size(); ++i)
+      c += coords(i);
+
+    c /= _indices.size();
+    return(c);
+  }
+
+
+  GCoord AtomicGroupView::centerOfMass(void) const {
+    if (_indices.size() == 1)
+      return(coords(0));
+
+    GCoord c(0,0,0);
+    for (uint i=0; i<_indices.size(); ++i) {
+      const Atom& a = *(_parent->atoms[_indices[i]]);
+      c += a.mass() * a.coords();
+    }
+    c /= totalMass();
+    return(c);
+  }
+
+
+  greal AtomicGroupView::totalMass(void) const {
+    greal mass = 0.0;
+    for (Indices::const_iterator i = _indices.begin(); i != _indices.end(); ++i)
+      mass += _parent->atoms[*i]->mass();
+
+    return(mass);
+  }
+
+
+  greal AtomicGroupView::radius(void) const {
+    GCoord c = centroid();
+    greal radius = 0.0;
+    for (uint i=0; i<_indices.size(); ++i) {
+      greal d = c.distance2(coords(i));
+      if (d > radius)
+        radius = d;
+    }
+
+    return(sqrt(radius));
+  }
+
+
+  greal AtomicGroupView::radiusOfGyration(void) const {
+    GCoord c = centerOfMass();
+    greal radius = 0.0;
+    for (uint i=0; i<_indices.size(); ++i)
+      radius += c.distance2(coords(i));
+
+    return(sqrt(radius / _indices.size()));
+  }
+
+
+  greal AtomicGroupView::rmsd(const AtomicGroupView& other) const {
+    if (size() != other.size())
+      throw(LOOSError("Cannot compute RMSD between groups with different sizes"));
+
+    double d = 0.0;
+    for (uint i=0; i<_indices.size(); ++i)
+      d += coords(i).distance2(other.coords(i));
+
+    return(sqrt(d / _indices.size()));
+  }
+
+
+  greal AtomicGroupView::rmsd(const AtomicGroup& other) const {
+    if (size() != other.size())
+      throw(LOOSError("Cannot compute RMSD between groups with different sizes"));
+
+    double d = 0.0;
+    AtomicGroup::const_iterator j = other.begin();
+    for (uint i=0; i<_indices.size(); ++i, ++j)
+      d += coords(i).distance2((*j)->coords());
+
+    return(sqrt(d / _indices.size()));
+  }
+
+
+
+  // These are AtomicGroup members, but live here since they need the
+  // full definition of AtomicGroupView
+
+  AtomicGroupView AtomicGroup::view(void) const {
+    return(AtomicGroupView(*this));
+  }
+
+
+  AtomicGroupView AtomicGroup::subsetView(const int offset, const int len) const {
+    std::pair<uint, uint> range = calcSubsetRange(offset, len);
+    AtomicGroupView::Indices idx;
+    idx.reserve(range.second - range.first);
+    for (uint i = range.first; i < range.second; ++i)
+      idx.push_back(i);
+
+    return(AtomicGroupView(*this, idx));
+  }
+
+
+  AtomicGroupView AtomicGroup::selectView(const AtomSelector& sel) const {
+    boost::dynamic_bitset<> picked = sel.mask(atoms);
+    AtomicGroupView::Indices idx;
+    idx.reserve(picked.count());
+    for (uint i=0; i<atoms.size(); ++i)
+      if (picked[i])
+        idx.push_back(i);
+
+    return(AtomicGroupView(*this, idx));
+  }
+
+
+  // Residue boundaries are the same as in splitByResidue()
+  std::vector<AtomicGroupView> AtomicGroup::splitByResidueView(void) const {
+    std::vector<AtomicGroupView> residues;
+    if (atoms.empty())
+      return(residues);
+
+    int curr_resid = atoms[0]->resid();
+    std::string curr_segid = atoms[0]->segid();
+
+    AtomicGroupView::Indices residue;
+    for (uint i=0; i<atoms.size(); ++i) {
+      if (curr_resid != atoms[i]->resid() || atoms[i]->segid() != curr_segid) {
+        residues.push_back(AtomicGroupView(*this, residue));
+        residue.clear();
+        curr_resid = atoms[i]->resid();
+        curr_segid = atoms[i]->segid();
+      }
+      residue.push_back(i);
+    }
+
+    if (!residue.empty())
+      residues.push_back(AtomicGroupView(*this, residue));
+
+    return(residues);
+  }
+
+}
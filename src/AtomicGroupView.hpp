@@ -0,0 +1,130 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#if !defined(LOOS_ATOMICGROUP_VIEW_HPP)
+#define LOOS_ATOMICGROUP_VIEW_HPP
+
+#include <vector>
+
+#include <boost/iterator/permutation_iterator.hpp>
+
+#include <loos_defs.hpp>
+#include <Coord.hpp>
+#include <AtomicGroup.hpp>
+
+
+namespace loos {
+
+  //! A lightweight, read-only view of some of the atoms in an AtomicGroup
+  /**
+   * Creating an AtomicGroup with select(), subset(), splitByResidue(),
+   * etc copies a shared pointer for every atom, which can add up when
+   * splitting systems with hundreds of thousands of atoms.  An
+   * AtomicGroupView instead holds a pointer to the parent group and a
+   * list of indices into it, so no atoms are copied.  It supports the
+   * read-only numerical functions of AtomicGroup, and can be turned
+   * into a real AtomicGroup with materialize() when one is needed:
+   \code
+   std::vector<AtomicGroupView> residues = model.splitByResidueView();
+   while (traj->readFrame()) {
+     traj->updateGroupCoords(model);
+     for (uint i=0; i<residues.size(); ++i)
+       std::cout << residues[i].centroid() << std::endl;
+   }
+   \endcode
+   *
+   * The view does not own the parent group, so the parent must
+   * outlive the view (and must not have atoms added or removed while
+   * the view is in use).  Since the atoms are shared with the parent,
+   * changing their coordinates is reflected in the view.
+   */
+  class AtomicGroupView {
+  public:
+    typedef std::vector<uint>                                     Indices;
+    typedef boost::permutation_iterator<AtomicGroup::const_iterator, Indices::const_iterator> const_iterator;
+    typedef const_iterator                                        iterator;
+    typedef pAtom                                                 value_type;
+
+    //! View of all atoms in \a parent
+    explicit AtomicGroupView(const AtomicGroup& parent);
+
+    //! View of the atoms in \a parent at \a indices (in that order)
+    AtomicGroupView(const AtomicGroup& parent, const Indices& indices);
+
+    uint size(void) const { return(_indices.size()); }
+    bool empty(void) const { return(_indices.empty()); }
+
+    //! The group this view refers to
+    const AtomicGroup& parent(void) const { return(*_parent); }
+
+    //! Indices of the atoms in the parent group
+    const Indices& indices(void) const { return(_indices); }
+
+#if !defined(SWIG)
+    //! The ith atom in the view (not range-checked)
+    const pAtom& operator[](const uint i) const { return(_parent->atoms[_indices[i]]); }
+#endif
+
+    //! Coordinates of the ith atom in the view (not range-checked)
+    const GCoord& coords(const uint i) const { return(_parent->atoms[_indices[i]]->coords()); }
+
+    const_iterator begin(void) const { return(const_iterator(_parent->atoms.begin(), _indices.begin())); }
+    const_iterator end(void) const { return(const_iterator(_parent->atoms.begin(), _indices.end())); }
+
+    //! A view of the atoms in this view for which sel predicate returns true
+    AtomicGroupView select(const AtomSelector& sel) const;
+
+    //! Creates an AtomicGroup containing the atoms in this view
+    /**
+     * The atoms (and periodic box) are shared with the parent, as
+     * with AtomicGroup::select()
+     */
+    AtomicGroup materialize(void) const;
+
+    bool isPeriodic(void) const { return(_parent->isPeriodic()); }
+    GCoord periodicBox(void) const { return(_parent->periodicBox()); }
+
+    //! Bounding box (see AtomicGroup::boundingBox())
+    std::vector<GCoord> boundingBox(void) const;
+
+    GCoord centroid(void) const;
+    GCoord centerOfMass(void) const;
+    greal totalMass(void) const;
+
+    //! Maximum radius from centroid of all atoms (not gyration)
+    greal radius(void) const;
+    greal radiusOfGyration(void) const;
+
+    //! RMSD between corresponding atoms (no superposition)
+    greal rmsd(const AtomicGroupView& other) const;
+    greal rmsd(const AtomicGroup& other) const;
+
+  private:
+    const AtomicGroup* _parent;
+    Indices _indices;
+  };
+
+}
+
+
+#endif
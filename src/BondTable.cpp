@@ -0,0 +1,112 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <BondTable.hpp>
+#include <AtomicGroup.hpp>
+
+#include <boost/unordered_map.hpp>
+
+
+namespace loos {
+
+  BondTable::BondTable(const AtomicGroup& g) {
+    uint n = g.size();
+
+    boost::unordered_map<int, uint> index_of;
+    for (uint i=0; i<n; ++i)
+      index_of.insert(std::make_pair(g[i]->id(), i));
+
+    // Counts go in _offsets[i+1] so the prefix sum leaves each atom's
+    // starting offset in _offsets[i]
+    _offsets.assign(n+1, 0);
+    std::vector<uint> targets;
+    for (uint i=0; i<n; ++i) {
+      if (!g[i]->hasBonds())
+        continue;
+      const std::vector<int>& bonds = g[i]->bondList();
+      for (std::vector<int>::const_iterator b = bonds.begin(); b != bonds.end(); ++b) {
+        boost::unordered_map<int, uint>::const_iterator j = index_of.find(*b);
+        if (j != index_of.end()) {
+          targets.push_back(j->second);
+          ++_offsets[i+1];
+        }
+      }
+    }
+
+    for (uint i=0; i<n; ++i)
+      _offsets[i+1] += _offsets[i];
+
+    // Bonds were collected in atom order, so they're already in place
+    _neighbors.swap(targets);
+  }
+
+
+  namespace {
+
+    // Path halving keeps the trees shallow without recursion
+    uint findRoot(std::vector<uint>& parent, uint i) {
+      while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+      }
+      return(i);
+    }
+
+  }
+
+
+  uint BondTable::components(std::vector<uint>& labels) const {
+    uint n = size();
+    std::vector<uint> parent(n);
+    std::vector<uint> rank(n, 0);
+    for (uint i=0; i<n; ++i)
+      parent[i] = i;
+
+    for (uint i=0; i<n; ++i)
+      for (uint k=_offsets[i]; k<_offsets[i+1]; ++k) {
+        uint a = findRoot(parent, i);
+        uint b = findRoot(parent, _neighbors[k]);
+        if (a == b)
+          continue;
+        if (rank[a] < rank[b])
+          std::swap(a, b);
+        parent[b] = a;
+        if (rank[a] == rank[b])
+          ++rank[a];
+      }
+
+    // Renumber roots in order of first appearance
+    const uint unlabeled = static_cast<uint>(-1);
+    std::vector<uint> root_label(n, unlabeled);
+    labels.resize(n);
+    uint count = 0;
+    for (uint i=0; i<n; ++i) {
+      uint r = findRoot(parent, i);
+      if (root_label[r] == unlabeled)
+        root_label[r] = count++;
+      labels[i] = root_label[r];
+    }
+
+    return(count);
+  }
+
+}
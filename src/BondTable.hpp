@@ -0,0 +1,86 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(LOOS_BOND_TABLE_HPP)
+#define LOOS_BOND_TABLE_HPP
+
+#include <vector>
+
+#include <loos_defs.hpp>
+
+
+namespace loos {
+
+  class AtomicGroup;
+
+  //! Compact connectivity table for an AtomicGroup
+  /**
+   * Each Atom stores its bonds as a list of atom-ids, so following a
+   * bond means looking up the bonded atom in the group.  A BondTable
+   * converts this once into a compressed (CSR) adjacency list of
+   * indices into the group, i.e. the atoms bonded to atom \a i are
+   * neighbors(i)[0] ... neighbors(i)[degree(i)-1].
+   *
+   * Bonds to atoms that are not in the group are dropped.  If more
+   * than one atom in the group has the same atom-id, bonds to that id
+   * go to the first such atom.  The table is not updated if the group
+   * or its connectivity changes.
+   */
+  class BondTable {
+  public:
+    BondTable() { }
+
+    //! Builds the table from the bonds of the atoms in \a g
+    explicit BondTable(const AtomicGroup& g);
+
+    //! Number of atoms in the table
+    uint size() const { return(_offsets.empty() ? 0 : _offsets.size() - 1); }
+
+    //! Total number of bonds (each bond is counted from both ends)
+    uint numberOfBonds() const { return(_neighbors.size()); }
+
+    //! Number of atoms bonded to atom \a i
+    uint degree(const uint i) const { return(_offsets[i+1] - _offsets[i]); }
+
+#if !defined(SWIG)
+    //! Indices of the atoms bonded to atom \a i
+    const uint* neighbors(const uint i) const { return(&_neighbors[0] + _offsets[i]); }
+#endif
+
+    //! Labels each atom with the connected component it belongs to
+    /**
+     * Components are found with a union-find pass over the bonds, so
+     * this is linear in the number of atoms plus bonds and never
+     * recurses.  Components are numbered in the order their first atom
+     * appears in the group.  Returns the number of components found.
+     */
+    uint components(std::vector<uint>& labels) const;
+
+  private:
+    std::vector<uint> _offsets;
+    std::vector<uint> _neighbors;
+  };
+
+}
+
+
+#endif
@@ -0,0 +1,276 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <CellList.hpp>
+#include <AtomicGroup.hpp>
+#include <exceptions.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace loos {
+
+  const ulong CellList::pair_threshold;
+
+
+  // Cells are made slightly wider than the cutoff so that round-off
+  // when binning can never push a neighbor out of the surrounding
+  // cells
+  namespace {
+    const double cell_slack = 1.0 + 1e-6;
+
+    // Cap on the number of cells (relative to the number of points),
+    // so a sparse set of points spread over a large volume doesn't
+    // create an enormous grid
+    const double cells_per_point = 8.0;
+    const double min_cells = 64.0;
+  }
+
+
+  CellList::CellList(const double cutoff) : _cutoff(cutoff), _periodic(false) {
+    if (!(cutoff > 0.0))
+      throw(LOOSError("CellList cutoff must be greater than zero"));
+    for (int k=0; k<3; ++k) {
+      _ncells[k] = 1;
+      _width[k] = cutoff;
+    }
+  }
+
+
+  CellList::CellList(const std::vector<GCoord>& crds, const double cutoff) : _cutoff(cutoff), _periodic(false) {
+    if (!(cutoff > 0.0))
+      throw(LOOSError("CellList cutoff must be greater than zero"));
+    update(crds);
+  }
+
+
+  CellList::CellList(const std::vector<GCoord>& crds, const double cutoff, const GCoord& box) : _cutoff(cutoff), _periodic(false) {
+    if (!(cutoff > 0.0))
+      throw(LOOSError("CellList cutoff must be greater than zero"));
+    update(crds, box);
+  }
+
+
+  void CellList::update(const std::vector<GCoord>& crds) {
+    _crds = crds;
+    _periodic = false;
+    build();
+  }
+
+
+  void CellList::update(const std::vector<GCoord>& crds, const GCoord& box) {
+    if (!(box.x() > 0.0 && box.y() > 0.0 && box.z() > 0.0))
+      throw(LOOSError("CellList requires a periodic box with positive dimensions"));
+    _crds = crds;
+    _box = box;
+    _periodic = true;
+    build();
+  }
+
+
+  void CellList::update(const AtomicGroup& g) {
+    std::vector<GCoord> crds(g.size());
+    for (uint i=0; i<g.size(); ++i)
+      crds[i] = g[i]->coords();
+    update(crds);
+  }
+
+
+  void CellList::update(const AtomicGroup& g, const GCoord& box) {
+    std::vector<GCoord> crds(g.size());
+    for (uint i=0; i<g.size(); ++i)
+      crds[i] = g[i]->coords();
+    update(crds, box);
+  }
+
+
+
+  void CellList::build() {
+    double min_width = _cutoff * cell_slack;
+    double extent[3];
+
+    if (_periodic) {
+      _origin = GCoord(0,0,0);
+      for (int k=0; k<3; ++k)
+        extent[k] = _box[k];
+
+    } else {
+      GCoord lo(0,0,0), hi(0,0,0);
+      if (!_crds.empty()) {
+        lo = hi = _crds[0];
+        for (std::vector<GCoord>::const_iterator i = _crds.begin(); i != _crds.end(); ++i)
+          for (int k=0; k<3; ++k) {
+            lo[k] = std::min(lo[k], (*i)[k]);
+            hi[k] = std::max(hi[k], (*i)[k]);
+          }
+      }
+      _origin = lo;
+      for (int k=0; k<3; ++k)
+        extent[k] = hi[k] - lo[k];
+    }
+
+    double n[3];
+    for (int k=0; k<3; ++k)
+      n[k] = std::max(1.0, floor(extent[k] / min_width));
+
+    double max_cells = std::max(min_cells, cells_per_point * _crds.size());
+    double total = n[0] * n[1] * n[2];
+    if (total > max_cells) {
+      double scale = pow(total / max_cells, 1.0/3.0);
+      for (int k=0; k<3; ++k)
+        n[k] = std::max(1.0, floor(n[k] / scale));
+    }
+
+    for (int k=0; k<3; ++k) {
+      _ncells[k] = static_cast<int>(n[k]);
+      // With fewer than 3 periodic cells, the neighboring cells would
+      // overlap (wrapping around), so just use one
+      if (_periodic && _ncells[k] < 3)
+        _ncells[k] = 1;
+      _width[k] = std::max(extent[k] / _ncells[k], min_width);
+    }
+
+    // Counting sort of the points into cells...
+    uint ncells = _ncells[0] * _ncells[1] * _ncells[2];
+    std::vector<uint> cell_of(_crds.size());
+    _cell_start.assign(ncells + 1, 0);
+    for (uint i=0; i<_crds.size(); ++i) {
+      uint c = (cellIndex(_crds[i][0], 0) * _ncells[1] + cellIndex(_crds[i][1], 1)) * _ncells[2] + cellIndex(_crds[i][2], 2);
+      cell_of[i] = c;
+      ++_cell_start[c+1];
+    }
+    for (uint c=0; c<ncells; ++c)
+      _cell_start[c+1] += _cell_start[c];
+
+    std::vector<uint> fill(_cell_start.begin(), _cell_start.end() - 1);
+    _cell_points.resize(_crds.size());
+    for (uint i=0; i<_crds.size(); ++i)
+      _cell_points[fill[cell_of[i]]++] = i;
+  }
+
+
+  // Cell containing x along axis k.  For periodic systems this wraps
+  // into the box.  Otherwise, points are clamped into the grid.
+  long CellList::cellIndex(const double x, const int k) const {
+    long i = static_cast<long>(floor((x - _origin[k]) / _width[k]));
+    if (_periodic) {
+      i %= _ncells[k];
+      if (i < 0)
+        i += _ncells[k];
+    } else if (i < 0)
+      i = 0;
+    else if (i >= _ncells[k])
+      i = _ncells[k] - 1;
+
+    return(i);
+  }
+
+
+  void CellList::candidates(const GCoord& c, std::vector<uint>& result) const {
+    if (_crds.empty())
+      return;
+
+    long lo[3], hi[3], center[3];
+    for (int k=0; k<3; ++k) {
+      if (_periodic) {
+        center[k] = cellIndex(c[k], k);
+        lo[k] = (_ncells[k] == 1) ? 0 : -1;
+        hi[k] = (_ncells[k] == 1) ? 0 : 1;
+      } else {
+        // Points outside the grid can only see the cells along the
+        // edge (if they're close enough to be within the cutoff)
+        double x = floor((c[k] - _origin[k]) / _width[k]);
+        if (x < -1.0 || x > _ncells[k])
+          return;
+        center[k] = static_cast<long>(x);
+        lo[k] = std::max(-1L, -center[k]);
+        hi[k] = std::min(1L, _ncells[k] - 1 - center[k]);
+      }
+    }
+
+    for (long i = lo[0]; i <= hi[0]; ++i) {
+      long ci = (center[0] + i + _ncells[0]) % _ncells[0];
+      for (long j = lo[1]; j <= hi[1]; ++j) {
+        long cj = (center[1] + j + _ncells[1]) % _ncells[1];
+        for (long l = lo[2]; l <= hi[2]; ++l) {
+          long cl = (center[2] + l + _ncells[2]) % _ncells[2];
+          long cell = (ci * _ncells[1] + cj) * _ncells[2] + cl;
+          result.insert(result.end(), _cell_points.begin() + _cell_start[cell], _cell_points.begin() + _cell_start[cell+1]);
+        }
+      }
+    }
+  }
+
+
+  void CellList::checkDistance(const double dist) const {
+    if (dist > _cutoff)
+      throw(LOOSError("Search distance is larger than the CellList cutoff"));
+  }
+
+
+  std::vector<uint> CellList::within(const GCoord& c, const double dist) const {
+    checkDistance(dist);
+    double dist2 = dist * dist;
+
+    std::vector<uint> cands;
+    candidates(c, cands);
+
+    std::vector<uint> result;
+    for (std::vector<uint>::const_iterator i = cands.begin(); i != cands.end(); ++i)
+      if (distance2(c, *i) <= dist2)
+        result.push_back(*i);
+
+    std::sort(result.begin(), result.end());
+    return(result);
+  }
+
+
+  bool CellList::anyWithin(const GCoord& c, const double dist) const {
+    checkDistance(dist);
+    double dist2 = dist * dist;
+
+    std::vector<uint> cands;
+    candidates(c, cands);
+    for (std::vector<uint>::const_iterator i = cands.begin(); i != cands.end(); ++i)
+      if (distance2(c, *i) <= dist2)
+        return(true);
+
+    return(false);
+  }
+
+
+  uint CellList::countWithin(const GCoord& c, const double dist) const {
+    checkDistance(dist);
+    double dist2 = dist * dist;
+
+    std::vector<uint> cands;
+    candidates(c, cands);
+    uint n = 0;
+    for (std::vector<uint>::const_iterator i = cands.begin(); i != cands.end(); ++i)
+      if (distance2(c, *i) <= dist2)
+        ++n;
+
+    return(n);
+  }
+
+}
@@ -0,0 +1,156 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(LOOS_CELL_LIST_HPP)
+#define LOOS_CELL_LIST_HPP
+
+#include <vector>
+
+#include <loos_defs.hpp>
+#include <Coord.hpp>
+
+
+namespace loos {
+
+  class AtomicGroup;
+
+  //! Spatial hashing (cell list) for fast distance searches
+  /**
+   * Space is divided into a grid of cells that are at least as wide
+   * as the cutoff, and each coordinate is binned into a cell.  All
+   * points within the cutoff of a given point must then lie in the
+   * same cell or in one of the 26 surrounding cells, so a search only
+   * has to look at a handful of points rather than all of them.
+   *
+   * If a periodic box is given, the grid covers the box and wraps
+   * around, and distances use the minimum image convention (as in
+   * GCoord::distance2(const GCoord&, const GCoord&)).  Only
+   * orthorhombic boxes are supported.  Without a box, the grid covers
+   * the bounding box of the coordinates.
+   *
+   * A CellList is built once and can be updated with new coordinates
+   * every frame:
+   \code
+   AtomicGroup solvent = selectAtoms(model, "name == 'OH2'");
+   AtomicGroup protein = selectAtoms(model, "segid == 'PROT'");
+   CellList cells(5.0);
+   while (traj->readFrame()) {
+     traj->updateGroupCoords(model);
+     cells.update(solvent, model.periodicBox());
+     for (AtomicGroup::const_iterator i = protein.begin(); i != protein.end(); ++i) {
+       std::vector<uint> near = cells.within((*i)->coords(), 3.5);
+       // near holds indices into solvent...
+     }
+   }
+   \endcode
+   *
+   * The distance tests are identical to the ones used by the
+   * brute-force searches in AtomicGroup, so the results are the same.
+   */
+  class CellList {
+  public:
+
+    //! Number of distance tests above which AtomicGroup searches switch to a CellList
+    static const ulong pair_threshold = 100000;
+
+    //! Creates an empty CellList for searches out to \a cutoff
+    explicit CellList(const double cutoff);
+
+    //! Bins \a crds (non-periodic)
+    CellList(const std::vector<GCoord>& crds, const double cutoff);
+
+    //! Bins \a crds using the periodic box \a box
+    CellList(const std::vector<GCoord>& crds, const double cutoff, const GCoord& box);
+
+    //! Rebins using new coordinates (non-periodic)
+    void update(const std::vector<GCoord>& crds);
+
+    //! Rebins using new coordinates and periodic box
+    void update(const std::vector<GCoord>& crds, const GCoord& box);
+
+    //! Rebins using the coordinates of the atoms in \a g (non-periodic)
+    void update(const AtomicGroup& g);
+
+    //! Rebins using the coordinates of the atoms in \a g and the periodic box
+    void update(const AtomicGroup& g, const GCoord& box);
+
+    double cutoff() const { return(_cutoff); }
+    bool isPeriodic() const { return(_periodic); }
+    GCoord periodicBox() const { return(_box); }
+
+    //! Number of points binned
+    uint size() const { return(_crds.size()); }
+
+    //! Coordinates of point \a i (in the order they were passed in)
+    const GCoord& coords(const uint i) const { return(_crds[i]); }
+
+    //! Squared distance between \a c and point \a i (periodic if a box was given)
+    double distance2(const GCoord& c, const uint i) const {
+      return(_periodic ? c.distance2(_crds[i], _box) : c.distance2(_crds[i]));
+    }
+
+    //! Indices of all points that might be within the cutoff of \a c
+    /**
+     * The indices are appended to \a result in no particular order.
+     * Every point within the cutoff is included, but so are some
+     * points that are farther away.
+     */
+    void candidates(const GCoord& c, std::vector<uint>& result) const;
+
+    //! Indices of all points within \a dist of \a c (sorted)
+    /**
+     * \a dist must be no larger than the cutoff.  Points exactly
+     * \a dist away are included.
+     */
+    std::vector<uint> within(const GCoord& c, const double dist) const;
+
+    //! Returns true if any point is within \a dist of \a c
+    bool anyWithin(const GCoord& c, const double dist) const;
+
+    //! Number of points within \a dist of \a c
+    uint countWithin(const GCoord& c, const double dist) const;
+
+  private:
+    void build();
+    void checkDistance(const double dist) const;
+    long cellIndex(const double x, const int k) const;
+
+  private:
+    double _cutoff;
+    bool _periodic;
+    GCoord _box;
+
+    std::vector<GCoord> _crds;
+    GCoord _origin;
+    int _ncells[3];
+    double _width[3];
+
+    // Points sorted by cell: the points in cell c are
+    // _cell_points[_cell_start[c]] to _cell_points[_cell_start[c+1]-1]
+    std::vector<uint> _cell_start;
+    std::vector<uint> _cell_points;
+  };
+
+}
+
+
+#endif
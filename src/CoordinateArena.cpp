@@ -0,0 +1,298 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <CoordinateArena.hpp>
+
+#include <cmath>
+
+
+namespace loos {
+
+
+  CoordinateArena::CoordinateArena(const AtomicGroup& system) : _system(system), _periodic(false) {
+    uint n = 0;
+    for (AtomicGroup::const_iterator i = system.begin(); i != system.end(); ++i) {
+      if (!(*i)->checkProperty(Atom::indexbit))
+        throw(LOOSError(**i, "Atoms used to create a CoordinateArena must have their index property set"));
+      n = std::max(n, (*i)->index() + 1);
+    }
+
+    _x.resize(n);
+    _y.resize(n);
+    _z.resize(n);
+    _mass.resize(n);
+    for (AtomicGroup::const_iterator i = system.begin(); i != system.end(); ++i)
+      _mass[(*i)->index()] = (*i)->mass();
+
+    gather();
+  }
+
+
+  CoordinateArena::CoordinateArena(const uint n) : _x(n), _y(n), _z(n), _mass(n, 1.0), _periodic(false) { }
+
+
+  void CoordinateArena::coords(const std::vector<GCoord>& crds) {
+    if (crds.size() < _x.size())
+      throw(LOOSError("Too few coordinates to fill the CoordinateArena"));
+
+    for (uint i=0; i<_x.size(); ++i) {
+      _x[i] = crds[i].x();
+      _y[i] = crds[i].y();
+      _z[i] = crds[i].z();
+    }
+  }
+
+
+  std::vector<GCoord> CoordinateArena::coords(const Indices& idx) const {
+    std::vector<GCoord> crds(idx.size());
+    for (uint i=0; i<idx.size(); ++i)
+      crds[i] = GCoord(_x[idx[i]], _y[idx[i]], _z[idx[i]]);
+    return(crds);
+  }
+
+
+  CoordinateArena::Indices CoordinateArena::indices(const AtomicGroup& g) const {
+    Indices idx;
+    idx.reserve(g.size());
+    for (AtomicGroup::const_iterator i = g.begin(); i != g.end(); ++i) {
+      uint k = (*i)->index();
+      if (k >= _x.size())
+        throw(LOOSError(**i, "Atom index is out of range for the CoordinateArena"));
+      idx.push_back(k);
+    }
+    return(idx);
+  }
+
+
+  CoordinateArena::Indices CoordinateArena::allIndices() const {
+    Indices idx(_x.size());
+    for (uint i=0; i<idx.size(); ++i)
+      idx[i] = i;
+    return(idx);
+  }
+
+
+
+  void CoordinateArena::gather() {
+    gather(_system);
+    if (_system.isPeriodic())
+      periodicBox(_system.periodicBox());
+  }
+
+
+  void CoordinateArena::gather(const AtomicGroup& g) {
+    for (AtomicGroup::const_iterator i = g.begin(); i != g.end(); ++i) {
+      uint k = (*i)->index();
+      if (k >= _x.size())
+        throw(LOOSError(**i, "Atom index is out of range for the CoordinateArena"));
+      const GCoord& c = (*i)->coords();
+      _x[k] = c.x();
+      _y[k] = c.y();
+      _z[k] = c.z();
+    }
+  }
+
+
+  void CoordinateArena::scatter() const {
+    // _system shares its atoms with the group it was created from,
+    // so writing through a copy updates the original
+    AtomicGroup g(_system);
+    scatter(g);
+    if (_periodic)
+      g.periodicBox(_box);
+  }
+
+
+  void CoordinateArena::scatter(AtomicGroup& g) const {
+    for (AtomicGroup::iterator i = g.begin(); i != g.end(); ++i) {
+      uint k = (*i)->index();
+      if (k >= _x.size())
+        throw(LOOSError(**i, "Atom index is out of range for the CoordinateArena"));
+      (*i)->coords(GCoord(_x[k], _y[k], _z[k]));
+    }
+  }
+
+
+
+  std::vector<GCoord> CoordinateArena::boundingBox(const Indices& idx) const {
+    std::vector<GCoord> res(2);
+    if (idx.empty())
+      return(res);
+
+    greal minx = _x[idx[0]], miny = _y[idx[0]], minz = _z[idx[0]];
+    greal maxx = minx, maxy = miny, maxz = minz;
+    for (Indices::const_iterator i = idx.begin() + 1; i != idx.end(); ++i) {
+      greal x = _x[*i], y = _y[*i], z = _z[*i];
+      minx = std::min(minx, x);
+      maxx = std::max(maxx, x);
+      miny = std::min(miny, y);
+      maxy = std::max(maxy, y);
+      minz = std::min(minz, z);
+      maxz = std::max(maxz, z);
+    }
+
+    res[0].set(minx, miny, minz);
+    res[1].set(maxx, maxy, maxz);
+    return(res);
+  }
+
+
+  GCoord CoordinateArena::centroid(const Indices& idx) const {
+    greal cx = 0.0, cy = 0.0, cz = 0.0;
+    for (Indices::const_iterator i = idx.begin(); i != idx.end(); ++i) {
+      cx += _x[*i];
+      cy += _y[*i];
+      cz += _z[*i];
+    }
+
+    GCoord c(cx, cy, cz);
+    c /= idx.size();
+    return(c);
+  }
+
+
+  GCoord CoordinateArena::centerOfMass(const Indices& idx) const {
+    greal cx = 0.0, cy = 0.0, cz = 0.0, m = 0.0;
+    for (Indices::const_iterator i = idx.begin(); i != idx.end(); ++i) {
+      greal w = _mass[*i];
+      cx += w * _x[*i];
+      cy += w * _y[*i];
+      cz += w * _z[*i];
+      m += w;
+    }
+
+    GCoord c(cx, cy, cz);
+    c /= m;
+    return(c);
+  }
+
+
+  greal CoordinateArena::totalMass(const Indices& idx) const {
+    greal m = 0.0;
+    for (Indices::const_iterator i = idx.begin(); i != idx.end(); ++i)
+      m += _mass[*i];
+    return(m);
+  }
+
+
+  greal CoordinateArena::radius(const Indices& idx) const {
+    GCoord c = centroid(idx);
+    greal r = 0.0;
+    for (Indices::const_iterator i = idx.begin(); i != idx.end(); ++i) {
+      greal dx = _x[*i] - c.x();
+      greal dy = _y[*i] - c.y();
+      greal dz = _z[*i] - c.z();
+      greal d = dx*dx + dy*dy + dz*dz;
+      if (d > r)
+        r = d;
+    }
+    return(sqrt(r));
+  }
+
+
+  greal CoordinateArena::radiusOfGyration(const Indices& idx) const {
+    GCoord c = centerOfMass(idx);
+    greal r = 0.0;
+    for (Indices::const_iterator i = idx.begin(); i != idx.end(); ++i) {
+      greal dx = _x[*i] - c.x();
+      greal dy = _y[*i] - c.y();
+      greal dz = _z[*i] - c.z();
+      r += dx*dx + dy*dy + dz*dz;
+    }
+    return(sqrt(r / idx.size()));
+  }
+
+
+  greal CoordinateArena::rmsd(const Indices& idx, const CoordinateArena& other, const Indices& other_idx) const {
+    if (idx.size() != other_idx.size())
+      throw(LOOSError("Cannot compute RMSD between groups with different sizes"));
+
+    const greal* ox = other.x();
+    const greal* oy = other.y();
+    const greal* oz = other.z();
+    greal d = 0.0;
+    for (uint i=0; i<idx.size(); ++i) {
+      uint j = idx[i];
+      uint k = other_idx[i];
+      greal dx = _x[j] - ox[k];
+      greal dy = _y[j] - oy[k];
+      greal dz = _z[j] - oz[k];
+      d += dx*dx + dy*dy + dz*dz;
+    }
+    return(sqrt(d / idx.size()));
+  }
+
+
+  void CoordinateArena::translate(const Indices& idx, const GCoord& v) {
+    greal vx = v.x(), vy = v.y(), vz = v.z();
+    for (Indices::const_iterator i = idx.begin(); i != idx.end(); ++i) {
+      _x[*i] += vx;
+      _y[*i] += vy;
+      _z[*i] += vz;
+    }
+  }
+
+
+  void CoordinateArena::translate(const GCoord& v) {
+    greal vx = v.x(), vy = v.y(), vz = v.z();
+    for (uint i=0; i<_x.size(); ++i) {
+      _x[i] += vx;
+      _y[i] += vy;
+      _z[i] += vz;
+    }
+  }
+
+
+  // Applies the top 3x4 of the matrix, as in Matrix44 * Coord
+  // (coordinates are homogeneous with w=1)
+  void CoordinateArena::applyTransform(const Indices& idx, const XForm& M) {
+    GMatrix W = M.current();
+    const greal* m = W.data();
+    for (Indices::const_iterator i = idx.begin(); i != idx.end(); ++i) {
+      greal x = _x[*i], y = _y[*i], z = _z[*i];
+      _x[*i] = m[0]*x + m[1]*y + m[2]*z + m[3];
+      _y[*i] = m[4]*x + m[5]*y + m[6]*z + m[7];
+      _z[*i] = m[8]*x + m[9]*y + m[10]*z + m[11];
+    }
+  }
+
+
+  void CoordinateArena::applyTransform(const XForm& M) {
+    GMatrix W = M.current();
+    const greal* m = W.data();
+    for (uint i=0; i<_x.size(); ++i) {
+      greal x = _x[i], y = _y[i], z = _z[i];
+      _x[i] = m[0]*x + m[1]*y + m[2]*z + m[3];
+      _y[i] = m[4]*x + m[5]*y + m[6]*z + m[7];
+      _z[i] = m[8]*x + m[9]*y + m[10]*z + m[11];
+    }
+  }
+
+
+  GCoord CoordinateArena::centerAtOrigin(const Indices& idx) {
+    GCoord c = centroid(idx);
+    translate(idx, -c);
+    return(c);
+  }
+
+
+}
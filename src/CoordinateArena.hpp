@@ -0,0 +1,189 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(LOOS_COORDINATE_ARENA_HPP)
+#define LOOS_COORDINATE_ARENA_HPP
+
+#include <vector>
+
+#include <loos_defs.hpp>
+#include <Coord.hpp>
+#include <XForm.hpp>
+#include <AtomicGroup.hpp>
+
+
+namespace loos {
+
+  //! Contiguous (structure-of-arrays) coordinate store for a system
+  /**
+   * Each Atom in an AtomicGroup holds its own coordinates, so numeric
+   * code that loops over a large group has to chase a pointer per
+   * atom and drag most of the Atom into cache just to read its
+   * coordinates.  A CoordinateArena instead keeps the coordinates of
+   * a whole system in three flat arrays (x, y, and z), which can be
+   * filled directly by a Trajectory (see
+   * Trajectory::updateArenaCoords()) and iterated over linearly.
+   *
+   * Atoms map into the arena by their Atom::index(), i.e. the same
+   * way they map into a trajectory frame.  A group of atoms is
+   * represented by the list of its indices (see indices()), and all
+   * of the numeric kernels take such a list.  The list for a group
+   * only needs to be built once and can then be reused for every
+   * frame.
+   *
+   * The arena does not replace the coordinates stored in the atoms.
+   * Use gather() to copy coordinates from the atoms into the arena and
+   * scatter() to copy them back out, for example to write a frame or
+   * to use a function that expects an AtomicGroup:
+   \code
+   AtomicGroup model = createSystem("foo.pdb");
+   pTraj traj = createTrajectory("foo.dcd", model);
+   AtomicGroup ca = selectAtoms(model, "name == 'CA'");
+
+   CoordinateArena arena(model);
+   std::vector<uint> ca_idx = arena.indices(ca);
+   while (traj->readFrame()) {
+     traj->updateArenaCoords(arena);
+     std::cout << arena.radiusOfGyration(ca_idx) << std::endl;
+   }
+   \endcode
+   */
+  class CoordinateArena {
+  public:
+    typedef std::vector<uint>   Indices;
+
+    //! Creates an arena for the atoms in \a system, copying their current coordinates
+    /**
+     * The arena is sized to hold every index used by \a system, so
+     * all atoms must have their index property set (as they will if
+     * they were read in by a LOOS model class).  \a system is shallow
+     * copied and shares its atoms (and periodic box) with the
+     * original group.
+     */
+    explicit CoordinateArena(const AtomicGroup& system);
+
+    //! Creates an empty arena holding \a n atoms (not attached to any atoms)
+    explicit CoordinateArena(const uint n);
+
+    uint size() const { return(_x.size()); }
+    bool empty() const { return(_x.empty()); }
+
+    //! Group of atoms the arena was created from (may be empty)
+    const AtomicGroup& system() const { return(_system); }
+
+    // Direct access to the arrays
+    greal* x() { return(&_x[0]); }
+    greal* y() { return(&_y[0]); }
+    greal* z() { return(&_z[0]); }
+    const greal* x() const { return(&_x[0]); }
+    const greal* y() const { return(&_y[0]); }
+    const greal* z() const { return(&_z[0]); }
+
+    //! Coordinates of the atom in slot \a i
+    GCoord coords(const uint i) const { return(GCoord(_x[i], _y[i], _z[i])); }
+
+    //! Sets the coordinates of the atom in slot \a i
+    void coords(const uint i, const GCoord& c) {
+      _x[i] = c.x();
+      _y[i] = c.y();
+      _z[i] = c.z();
+    }
+
+    //! Sets all coordinates from a vector (as returned by Trajectory::coords())
+    void coords(const std::vector<GCoord>& crds);
+
+    //! Returns the coordinates of the atoms in \a idx as a vector of GCoords
+    std::vector<GCoord> coords(const Indices& idx) const;
+
+    bool isPeriodic() const { return(_periodic); }
+    GCoord periodicBox() const { return(_box); }
+    void periodicBox(const GCoord& c) { _box = c; _periodic = true; }
+    void removePeriodicBox() { _periodic = false; }
+
+    //! Masses of each atom (zero for slots with no atom)
+    const std::vector<greal>& masses() const { return(_mass); }
+
+
+    //! The arena indices for the atoms in \a g
+    /**
+     * These are just the Atom::index() values, checked against the
+     * size of the arena.
+     */
+    Indices indices(const AtomicGroup& g) const;
+
+    //! Indices covering the entire arena
+    Indices allIndices() const;
+
+
+    //! Copies coordinates (and periodic box) from the system atoms into the arena
+    void gather();
+
+    //! Copies coordinates from the atoms in \a g into the arena
+    void gather(const AtomicGroup& g);
+
+    //! Copies coordinates (and periodic box) from the arena into the system atoms
+    void scatter() const;
+
+    //! Copies coordinates from the arena into the atoms in \a g
+    void scatter(AtomicGroup& g) const;
+
+
+    // Numeric kernels.  These mirror the AtomicGroup functions of the
+    // same name, operating on the atoms in the index list
+
+    //! Bounding box (min and max corners) for the atoms in \a idx
+    std::vector<GCoord> boundingBox(const Indices& idx) const;
+
+    GCoord centroid(const Indices& idx) const;
+    GCoord centerOfMass(const Indices& idx) const;
+    greal totalMass(const Indices& idx) const;
+    greal radius(const Indices& idx) const;
+    greal radiusOfGyration(const Indices& idx) const;
+
+    //! RMSD between the atoms in \a idx and \a other_idx in \a other (no superposition)
+    greal rmsd(const Indices& idx, const CoordinateArena& other, const Indices& other_idx) const;
+
+    //! RMSD between two sets of atoms in this arena
+    greal rmsd(const Indices& idx, const Indices& other_idx) const { return(rmsd(idx, *this, other_idx)); }
+
+    void translate(const Indices& idx, const GCoord& v);
+    void applyTransform(const Indices& idx, const XForm& M);
+
+    //! Translates the atoms so their centroid is at the origin, returning the old centroid
+    GCoord centerAtOrigin(const Indices& idx);
+
+    // Whole-arena versions
+    void translate(const GCoord& v);
+    void applyTransform(const XForm& M);
+
+  private:
+    AtomicGroup _system;
+    std::vector<greal> _x, _y, _z;
+    std::vector<greal> _mass;
+    GCoord _box;
+    bool _periodic;
+  };
+
+}
+
+
+#endif
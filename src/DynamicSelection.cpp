@@ -0,0 +1,506 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include <DynamicSelection.hpp>
+#include <AtomicGroupView.hpp>
+#include <CellList.hpp>
+#include <Parser.hpp>
+#include <Selectors.hpp>
+#include <exceptions.hpp>
+
+#include <cctype>
+#include <cstdlib>
+
+
+namespace loos {
+
+  namespace internal {
+
+    typedef DynamicSelection::Mask   Mask;
+
+
+    //! A node in the expression tree of a DynamicSelection
+    /**
+     * evaluate() only has to compute the bits that are set in \a need
+     * (all others must be clear).  This lets an "and" skip testing
+     * atoms that have already been ruled out.
+     */
+    class SelectionNode {
+    public:
+      virtual ~SelectionNode() { }
+      virtual Mask evaluate(const AtomicGroup& source, const Mask& need) const =0;
+      virtual bool isStatic(void) const =0;
+    };
+
+    typedef boost::shared_ptr<SelectionNode>   pSelectionNode;
+
+
+    namespace {
+
+      // A term that does not depend on coordinates, evaluated once
+      class StaticNode : public SelectionNode {
+      public:
+        explicit StaticNode(const Mask& m) : _mask(m) { }
+        Mask evaluate(const AtomicGroup&, const Mask& need) const { return(_mask & need); }
+        bool isStatic(void) const { return(true); }
+
+      private:
+        Mask _mask;
+      };
+
+
+      class AndNode : public SelectionNode {
+      public:
+        AndNode(const pSelectionNode& a, const pSelectionNode& b) : _a(a), _b(b) { }
+        Mask evaluate(const AtomicGroup& source, const Mask& need) const {
+          Mask m = _a->evaluate(source, need);
+          return(_b->evaluate(source, m));
+        }
+        bool isStatic(void) const { return(false); }
+
+      private:
+        pSelectionNode _a, _b;
+      };
+
+
+      class OrNode : public SelectionNode {
+      public:
+        OrNode(const pSelectionNode& a, const pSelectionNode& b) : _a(a), _b(b) { }
+        Mask evaluate(const AtomicGroup& source, const Mask& need) const {
+          Mask m = _a->evaluate(source, need);
+          return(m | _b->evaluate(source, need - m));
+        }
+        bool isStatic(void) const { return(false); }
+
+      private:
+        pSelectionNode _a, _b;
+      };
+
+
+      class NotNode : public SelectionNode {
+      public:
+        explicit NotNode(const pSelectionNode& a) : _a(a) { }
+        Mask evaluate(const AtomicGroup& source, const Mask& need) const {
+          return(need - _a->evaluate(source, need));
+        }
+        bool isStatic(void) const { return(false); }
+
+      private:
+        pSelectionNode _a;
+      };
+
+
+      // within/around
+      class WithinNode : public SelectionNode {
+      public:
+        WithinNode(const double radius, const pSelectionNode& ref, const bool exclude_ref)
+          : _radius(radius), _ref(ref), _exclude_ref(exclude_ref) { }
+
+        Mask evaluate(const AtomicGroup& source, const Mask& need) const {
+          Mask result(need.size());
+          if (need.none())
+            return(result);
+
+          Mask all(need.size());
+          all.set();
+          Mask ref = _ref->evaluate(source, all);
+          if (ref.none())
+            return(result);
+
+          AtomicGroup::const_iterator atoms = source.begin();
+          std::vector<GCoord> crds;
+          crds.reserve(ref.count());
+          for (Mask::size_type i = ref.find_first(); i != Mask::npos; i = ref.find_next(i))
+            crds.push_back(atoms[i]->coords());
+
+          CellList cells(_radius);
+          if (source.isPeriodic())
+            cells.update(crds, source.periodicBox());
+          else
+            cells.update(crds);
+
+          for (Mask::size_type i = need.find_first(); i != Mask::npos; i = need.find_next(i)) {
+            if (_exclude_ref && ref[i])
+              continue;
+            if (cells.anyWithin(atoms[i]->coords(), _radius))
+              result.set(i);
+          }
+
+          return(result);
+        }
+
+        bool isStatic(void) const { return(false); }
+
+      private:
+        double _radius;
+        pSelectionNode _ref;
+        bool _exclude_ref;
+      };
+
+
+      class ByResidueNode : public SelectionNode {
+      public:
+        ByResidueNode(const AtomicGroup& source, const pSelectionNode& a) : _a(a), _residue(source.size()), _nresidues(0) {
+          if (source.empty())
+            return;
+
+          // Residue boundaries are the same as in AtomicGroup::splitByResidue()
+          AtomicGroup::const_iterator atoms = source.begin();
+          int curr_resid = atoms[0]->resid();
+          std::string curr_segid = atoms[0]->segid();
+          for (uint i=0; i<source.size(); ++i) {
+            if (curr_resid != atoms[i]->resid() || atoms[i]->segid() != curr_segid) {
+              ++_nresidues;
+              curr_resid = atoms[i]->resid();
+              curr_segid = atoms[i]->segid();
+            }
+            _residue[i] = _nresidues;
+          }
+          ++_nresidues;
+        }
+
+        Mask evaluate(const AtomicGroup& source, const Mask& need) const {
+          Mask all(need.size());
+          all.set();
+          Mask m = _a->evaluate(source, all);
+
+          std::vector<char> hit(_nresidues, 0);
+          for (Mask::size_type i = m.find_first(); i != Mask::npos; i = m.find_next(i))
+            hit[_residue[i]] = 1;
+
+          Mask result(need.size());
+          for (Mask::size_type i = need.find_first(); i != Mask::npos; i = need.find_next(i))
+            if (hit[_residue[i]])
+              result.set(i);
+
+          return(result);
+        }
+
+        bool isStatic(void) const { return(false); }
+
+      private:
+        pSelectionNode _a;
+        std::vector<uint> _residue;
+        uint _nresidues;
+      };
+
+
+
+
+      struct Token {
+        enum Type { LPAREN, RPAREN, AND, OR, NOT, WORD, OTHER, END };
+
+        Token(const Type t, const std::string& s, const uint b, const uint e) : type(t), text(s), begin(b), end(e) { }
+
+        Type type;
+        std::string text;
+        uint begin, end;     // Location in the selection string
+      };
+
+
+      // Splits up a selection string just enough to find the logical
+      // structure and spatial terms.  Everything else (strings,
+      // relational operators, etc) is passed through as OTHER so it
+      // can be handed to the regular Parser.
+      std::vector<Token> tokenize(const std::string& s) {
+        std::vector<Token> tokens;
+        uint n = s.size();
+        uint i = 0;
+
+        while (i < n) {
+          char c = s[i];
+          uint b = i;
+
+          if (isspace(c)) {
+            ++i;
+            continue;
+          }
+
+          if (c == '#') {                // Comments run to the end of the line
+            while (i < n && s[i] != '\n')
+              ++i;
+            continue;
+          }
+
+          if (c == '"' || c == '\'') {
+            ++i;
+            while (i < n && s[i] != c && s[i] != '\n')
+              ++i;
+            if (i < n)
+              ++i;
+            tokens.push_back(Token(Token::OTHER, s.substr(b, i-b), b, i));
+
+          } else if (c == '(') {
+            tokens.push_back(Token(Token::LPAREN, "(", b, ++i));
+          } else if (c == ')') {
+            tokens.push_back(Token(Token::RPAREN, ")", b, ++i));
+          } else if (c == '&' && i+1 < n && s[i+1] == '&') {
+            i += 2;
+            tokens.push_back(Token(Token::AND, "&&", b, i));
+          } else if (c == '|' && i+1 < n && s[i+1] == '|') {
+            i += 2;
+            tokens.push_back(Token(Token::OR, "||", b, i));
+          } else if (c == '!' && !(i+1 < n && s[i+1] == '=')) {
+            tokens.push_back(Token(Token::NOT, "!", b, ++i));
+
+          } else if (isalpha(c)) {
+            while (i < n && (isalnum(s[i]) || s[i] == '_'))
+              ++i;
+            std::string word = s.substr(b, i-b);
+            tokens.push_back(Token(word == "not" ? Token::NOT : Token::WORD, word, b, i));
+
+          } else if (isdigit(c) || c == '.') {
+            while (i < n && (isdigit(s[i]) || s[i] == '.'))
+              ++i;
+            tokens.push_back(Token(Token::OTHER, s.substr(b, i-b), b, i));
+
+          } else {
+            tokens.push_back(Token(Token::OTHER, std::string(1, c), b, ++i));
+          }
+        }
+
+        tokens.push_back(Token(Token::END, "", n, n));
+        return(tokens);
+      }
+
+
+      bool isSpatialKeyword(const Token& t) {
+        return(t.type == Token::WORD && (t.text == "within" || t.text == "around" || t.text == "byres"));
+      }
+
+
+
+      // Recursive-descent parser for the logical structure of the
+      // selection.  As in the regular grammar, && and || have the same
+      // precedence and are left-associative, and ! binds to the term
+      // immediately following it.
+      class SpatialParser {
+      public:
+        SpatialParser(const AtomicGroup& source, const std::string& selection)
+          : _source(source), _selection(selection), _tokens(tokenize(selection)), _pos(0),
+            _atoms(source.begin(), source.end())
+        { }
+
+        pSelectionNode parse(void) {
+          pSelectionNode node = expr();
+          if (current().type != Token::END)
+            error("unexpected '" + current().text + "'");
+          return(node);
+        }
+
+      private:
+        const Token& current(void) const { return(_tokens[_pos]); }
+
+        void error(const std::string& msg) const {
+          throw(ParseError("Bad selection syntax - " + msg));
+        }
+
+
+        pSelectionNode expr(void) {
+          pSelectionNode node = term();
+          while (current().type == Token::AND || current().type == Token::OR) {
+            bool is_and = (current().type == Token::AND);
+            ++_pos;
+            pSelectionNode rhs = term();
+            if (is_and)
+              node = combine(pSelectionNode(new AndNode(node, rhs)), node, rhs);
+            else
+              node = combine(pSelectionNode(new OrNode(node, rhs)), node, rhs);
+          }
+          return(node);
+        }
+
+
+        pSelectionNode term(void) {
+          // Terms without any spatial keywords go to the regular parser
+          // as-is
+          uint end = termEnd();
+          bool spatial = false;
+          for (uint i=_pos; i<end; ++i)
+            if (isSpatialKeyword(_tokens[i]))
+              spatial = true;
+
+          if (!spatial)
+            return(leaf(end));
+
+          const Token& t = current();
+          if (t.type == Token::NOT) {
+            ++_pos;
+            pSelectionNode a = term();
+            return(combine(pSelectionNode(new NotNode(a)), a, a));
+          }
+
+          if (t.type == Token::LPAREN) {
+            ++_pos;
+            pSelectionNode node = expr();
+            if (current().type != Token::RPAREN)
+              error("missing ')'");
+            ++_pos;
+            return(node);
+          }
+
+          if (t.text == "within" || t.text == "around") {
+            bool exclude = (t.text == "around");
+            ++_pos;
+            double radius = distance();
+            if (!(current().type == Token::WORD && current().text == "of"))
+              error("expected 'of' after distance in '" + t.text + "'");
+            ++_pos;
+            pSelectionNode ref = term();
+            return(pSelectionNode(new WithinNode(radius, ref, exclude)));
+          }
+
+          if (t.text == "byres") {
+            ++_pos;
+            pSelectionNode a = term();
+            return(combine(pSelectionNode(new ByResidueNode(_source, a)), a, a));
+          }
+
+          error("unexpected '" + t.text + "'");
+          return(pSelectionNode());
+        }
+
+
+        // Index of the token that ends the term starting at the
+        // current position, i.e. the next && or || or unmatched ')'
+        // that is not nested in parentheses
+        uint termEnd(void) const {
+          int depth = 0;
+          uint i;
+          for (i=_pos; _tokens[i].type != Token::END; ++i) {
+            Token::Type t = _tokens[i].type;
+            if (t == Token::LPAREN)
+              ++depth;
+            else if (t == Token::RPAREN) {
+              if (depth == 0)
+                break;
+              --depth;
+            } else if ((t == Token::AND || t == Token::OR) && depth == 0)
+              break;
+          }
+          return(i);
+        }
+
+
+        double distance(void) {
+          const Token& t = current();
+          char *p;
+          double d = strtod(t.text.c_str(), &p);
+          if (t.type != Token::OTHER || t.text.empty() || *p != '\0')
+            error("expected a distance but found '" + t.text + "'");
+          if (!(d > 0.0))
+            error("distance must be greater than zero");
+          ++_pos;
+          return(d);
+        }
+
+
+        pSelectionNode leaf(const uint end) {
+          if (end == _pos)
+            error("missing expression");
+
+          uint b = _tokens[_pos].begin;
+          uint e = _tokens[end-1].end;
+          std::string text = _selection.substr(b, e-b);
+          _pos = end;
+
+          Parser parser;
+          try {
+            parser.parse(text);
+          }
+          catch(ParseError& err) {
+            throw(ParseError("Error in parsing '" + text + "' ... " + err.what()));
+          }
+
+          KernelSelector selector(parser.kernel());
+          return(pSelectionNode(new StaticNode(selector.mask(_atoms))));
+        }
+
+
+        // Operations on static terms are done now, so they don't have
+        // to be repeated every frame
+        pSelectionNode combine(const pSelectionNode& node, const pSelectionNode& a, const pSelectionNode& b) const {
+          if (!(a->isStatic() && b->isStatic()))
+            return(node);
+
+          Mask all(_atoms.size());
+          all.set();
+          return(pSelectionNode(new StaticNode(node->evaluate(_source, all))));
+        }
+
+
+      private:
+        const AtomicGroup& _source;
+        std::string _selection;
+        std::vector<Token> _tokens;
+        uint _pos;
+        std::vector<pAtom> _atoms;
+      };
+
+    }
+
+  }
+
+
+
+  DynamicSelection::DynamicSelection(const AtomicGroup& source, const std::string& selection)
+    : _source(source), _selection(selection)
+  {
+    internal::SpatialParser parser(_source, _selection);
+    _root = parser.parse();
+  }
+
+
+  DynamicSelection::Mask DynamicSelection::mask(void) const {
+    Mask all(_source.size());
+    all.set();
+    return(_root->evaluate(_source, all));
+  }
+
+
+  AtomicGroup DynamicSelection::select(void) const {
+    Mask m = mask();
+    AtomicGroupView::Indices idx;
+    idx.reserve(m.count());
+    for (Mask::size_type i = m.find_first(); i != Mask::npos; i = m.find_next(i))
+      idx.push_back(i);
+
+    return(AtomicGroupView(_source, idx).materialize());
+  }
+
+
+  bool DynamicSelection::isDynamic(void) const {
+    return(!_root->isStatic());
+  }
+
+
+  bool DynamicSelection::hasSpatialTerms(const std::string& selection) {
+    std::vector<internal::Token> tokens = internal::tokenize(selection);
+    for (std::vector<internal::Token>::const_iterator i = tokens.begin(); i != tokens.end(); ++i)
+      if (internal::isSpatialKeyword(*i))
+        return(true);
+
+    return(false);
+  }
+
+}
@@ -0,0 +1,116 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#if !defined(LOOS_DYNAMIC_SELECTION_HPP)
+#define LOOS_DYNAMIC_SELECTION_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/dynamic_bitset.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <loos_defs.hpp>
+#include <AtomicGroup.hpp>
+
+
+namespace loos {
+
+  namespace internal {
+    class SelectionNode;
+  }
+
+
+  //! A selection that may depend on coordinates, evaluated each frame
+  /**
+   * In addition to the regular selection language (see Parser), a
+   * DynamicSelection understands a few spatial terms:
+   \verbatim
+   within R of (sel)   Atoms within R angstroms of any atom in sel (including sel)
+   around R of (sel)   Atoms within R angstroms of sel, but not in sel
+   byres (sel)         All atoms in any residue that has an atom in sel
+   \endverbatim
+   * These can be combined with the usual logical operators, e.g.
+   \code
+   resname == 'TIP3' && name == 'OH2' && within 5 of (segid == 'PROT')
+   byres (around 3.5 of (resname == 'LIG'))
+   \endcode
+   *
+   * Parts of the selection that do not involve spatial terms are
+   * compiled by the regular Parser and evaluated once, when the
+   * DynamicSelection is created.  Only the spatial terms are
+   * re-evaluated when select() is called, using a CellList.  The
+   * periodic box of the source group is used if it has one.
+   * Residues for byres are split the same way as
+   * AtomicGroup::splitByResidue().
+   *
+   * The source group shares its atoms with the group it was created
+   * from, so updating the coordinates of the original (e.g. with
+   * Trajectory::updateGroupCoords()) is all that's needed between
+   * frames:
+   \code
+   DynamicSelection shell(model, "name == 'OH2' && within 5 of (segid == 'PROT')");
+   while (traj->readFrame()) {
+     traj->updateGroupCoords(model);
+     AtomicGroup waters = shell.select();
+     ...
+   }
+   \endcode
+   */
+  class DynamicSelection {
+  public:
+    typedef boost::dynamic_bitset<>    Mask;
+
+    //! Compiles \a selection for selecting atoms from \a source
+    /**
+     * Throws a ParseError if the selection is invalid
+     */
+    DynamicSelection(const AtomicGroup& source, const std::string& selection);
+
+    //! Atoms in the source group that are selected, given their current coordinates
+    AtomicGroup select(void) const;
+
+#if !defined(SWIG)
+    //! Bit i is set if atom i of the source group is selected
+    Mask mask(void) const;
+#endif
+
+    //! True if the selection contains spatial terms (so may change between frames)
+    bool isDynamic(void) const;
+
+    const AtomicGroup& source(void) const { return(_source); }
+    std::string selection(void) const { return(_selection); }
+
+    //! True if \a selection uses any of the spatial keywords
+    static bool hasSpatialTerms(const std::string& selection);
+
+  private:
+    AtomicGroup _source;
+    std::string _selection;
+    boost::shared_ptr<internal::SelectionNode> _root;
+  };
+
+}
+
+
+#endif
@@ -0,0 +1,161 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <FrameBuffer.hpp>
+#include <AtomicGroup.hpp>
+#include <Trajectory.hpp>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+namespace loos {
+
+  const ulong FrameBuffer::default_memory_budget;
+
+
+  FrameBuffer::FrameBuffer(const uint nframes, const uint natoms, const ulong budget)
+    : _nframes(nframes), _natoms(natoms), _bytes(0), _data(0), _mapped(false)
+  {
+    allocate(budget);
+  }
+
+
+  FrameBuffer::FrameBuffer(const AtomicGroup& subset, pTraj& traj, const std::vector<uint>& indices,
+                           const ulong budget)
+    : _nframes(indices.size()), _natoms(subset.size()), _bytes(0), _data(0), _mapped(false)
+  {
+    allocate(budget);
+
+    // The destructor won't run if reading fails, so release the
+    // storage here
+    try {
+      CoordinateArena arena(subset);
+      CoordinateArena::Indices idx = arena.indices(subset);
+      for (uint i=0; i<_nframes; ++i) {
+        traj->readFrame(indices[i]);
+        traj->updateArenaCoords(arena);
+        store(i, arena, idx);
+      }
+    }
+    catch (...) {
+      release();
+      throw;
+    }
+  }
+
+
+  FrameBuffer::~FrameBuffer() {
+    release();
+  }
+
+
+  void FrameBuffer::release() {
+    if (_mapped)
+      munmap(_data, _bytes);
+    else
+      delete[] _data;
+    _data = 0;
+    _mapped = false;
+  }
+
+
+  void FrameBuffer::allocate(const ulong budget) {
+    ulong n = static_cast<ulong>(_nframes) * _natoms * 3;
+    _bytes = n * sizeof(float);
+    if (_bytes <= budget) {
+      _data = new float[n];
+      return;
+    }
+
+    const char* tmpdir = getenv("TMPDIR");
+    std::string name = std::string(tmpdir == 0 ? "/tmp" : tmpdir) + "/loos_frames_XXXXXX";
+    std::vector<char> buf(name.begin(), name.end());
+    buf.push_back('\0');
+
+    int fd = mkstemp(&buf[0]);
+    if (fd < 0)
+      throw(FileOpenError(name, strerror(errno), errno));
+    unlink(&buf[0]);
+
+    if (ftruncate(fd, _bytes) != 0) {
+      int err = errno;
+      ::close(fd);
+      throw(FileOpenError(&buf[0], std::string("Cannot size temporary frame file: ") + strerror(err), err));
+    }
+
+    void* p = mmap(0, _bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if (p == MAP_FAILED)
+      throw(FileOpenError(&buf[0], std::string("Cannot memory-map temporary frame file: ") + strerror(err), err));
+
+    _data = static_cast<float*>(p);
+    _mapped = true;
+  }
+
+
+  void FrameBuffer::store(const uint i, const AtomicGroup& g) {
+    if (g.size() != _natoms)
+      throw(LOOSError("Group size does not match FrameBuffer"));
+
+    float* p = frame(i);
+    for (uint j=0; j<_natoms; ++j) {
+      const GCoord& c = g[j]->coords();
+      *p++ = c.x();
+      *p++ = c.y();
+      *p++ = c.z();
+    }
+  }
+
+
+  void FrameBuffer::store(const uint i, const CoordinateArena& arena, const CoordinateArena::Indices& idx) {
+    if (idx.size() != _natoms)
+      throw(LOOSError("Index list size does not match FrameBuffer"));
+
+    const greal* x = arena.x();
+    const greal* y = arena.y();
+    const greal* z = arena.z();
+    float* p = frame(i);
+    for (uint j=0; j<_natoms; ++j) {
+      uint k = idx[j];
+      *p++ = x[k];
+      *p++ = y[k];
+      *p++ = z[k];
+    }
+  }
+
+
+  void FrameBuffer::load(const uint i, AtomicGroup& g) const {
+    if (g.size() != _natoms)
+      throw(LOOSError("Group size does not match FrameBuffer"));
+
+    const float* p = frame(i);
+    for (uint j=0; j<_natoms; ++j, p += 3)
+      g[j]->coords() = GCoord(p[0], p[1], p[2]);
+  }
+
+}
@@ -0,0 +1,99 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(LOOS_FRAME_BUFFER_HPP)
+#define LOOS_FRAME_BUFFER_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/utility.hpp>
+
+#include <loos_defs.hpp>
+#include <exceptions.hpp>
+#include <CoordinateArena.hpp>
+
+
+namespace loos {
+
+  //! Contiguous single-precision store for the coordinates of many frames
+  /**
+   * Holds the coordinates of a subset of atoms for a list of
+   * trajectory frames as one packed array of floats (x, y, z for each
+   * atom, frame after frame).  This lets algorithms that need several
+   * passes over a trajectory read it only once.  Most trajectory
+   * formats store single-precision coordinates, so nothing is lost by
+   * using floats.
+   *
+   * If the buffer would be larger than the memory budget, it is
+   * instead backed by a memory-mapped temporary file (in $TMPDIR, or
+   * /tmp), so the kernel can page frames in and out as needed.  The
+   * file is removed as soon as it is created, so it will not be left
+   * behind.
+   */
+  class FrameBuffer : public boost::noncopyable {
+  public:
+    //! Default memory budget (bytes) before spilling to disk
+    static const ulong default_memory_budget = 2ul << 30;
+
+    //! Creates an uninitialized buffer for \a nframes frames of \a natoms atoms
+    FrameBuffer(const uint nframes, const uint natoms, const ulong budget = default_memory_budget);
+
+    //! Reads the coordinates of \a subset for each frame in \a indices from \a traj
+    FrameBuffer(const AtomicGroup& subset, pTraj& traj, const std::vector<uint>& indices,
+                const ulong budget = default_memory_budget);
+
+    ~FrameBuffer();
+
+    uint nframes() const { return(_nframes); }
+    uint natoms() const { return(_natoms); }
+
+    //! True if the buffer is backed by a temporary file
+    bool spilled() const { return(_mapped); }
+
+    //! Coordinates of frame \a i, packed as xyz
+    float* frame(const uint i) { return(_data + static_cast<ulong>(i) * _natoms * 3); }
+    const float* frame(const uint i) const { return(_data + static_cast<ulong>(i) * _natoms * 3); }
+
+    //! Copies the coordinates of \a g into frame \a i
+    void store(const uint i, const AtomicGroup& g);
+
+    //! Copies the coordinates of the atoms \a idx in \a arena into frame \a i
+    void store(const uint i, const CoordinateArena& arena, const CoordinateArena::Indices& idx);
+
+    //! Copies frame \a i into the coordinates of \a g
+    void load(const uint i, AtomicGroup& g) const;
+
+  private:
+    void allocate(const ulong budget);
+    void release();
+
+    uint _nframes, _natoms;
+    ulong _bytes;
+    float* _data;
+    bool _mapped;
+  };
+
+}
+
+
+#endif
@@ -69,6 +69,9 @@ namespace loos {
 
     internal::ValueStack& stack(void);
 
+    //! The stored commands, in the order they are executed
+    const std::vector<internal::Action*>& commands(void) const { return(actions); }
+
     friend std::ostream& operator<<(std::ostream&, const Kernel&);
   };
 };
@@ -131,13 +131,30 @@ namespace loos {
       stack->push(v);
     }
 
+    // Memoized results are dropped once there are this many, so a
+    // selection over a huge number of unique strings (e.g. residue
+    // numbers converted to strings) can't grow without bound
+    namespace {
+      const uint max_memo_size = 65536;
+    }
+
+
     void matchRegex::execute(void) { 
       Value v = stack->pop();
-      Value r(0);
-      if (boost::regex_search(v.getString(), regexp))
-        r.setInt(1);
-      
-      stack->push(r);
+      std::string s = v.getString();
+
+      boost::unordered_map<std::string, int>::const_iterator i = memo.find(s);
+      int matched;
+      if (i != memo.end())
+        matched = i->second;
+      else {
+        matched = boost::regex_search(s, regexp);
+        if (memo.size() >= max_memo_size)
+          memo.clear();
+        memo[s] = matched;
+      }
+
+      stack->push(Value(matched));
     }
 
     std::string matchRegex::name(void) const {
@@ -148,33 +165,60 @@ namespace loos {
 
     void matchStringAsRegex::execute(void) {
       Value v = stack->pop();
-      boost::regex re(v.getString(), boost::regex::perl|boost::regex::icase);
       Value u = stack->pop();
-      Value r(0);
-      
-      if (boost::regex_search(u.getString(), re))
-        r.setInt(1);
-      
-      stack->push(r);
+      PatternSubject key(v.getString(), u.getString());
+
+      boost::unordered_map<PatternSubject, int>::const_iterator i = memo.find(key);
+      int matched;
+      if (i != memo.end())
+        matched = i->second;
+      else {
+        boost::unordered_map<std::string, boost::regex>::iterator j = compiled.find(key.first);
+        if (j == compiled.end()) {
+          if (compiled.size() >= max_memo_size)
+            compiled.clear();
+          j = compiled.insert(std::make_pair(key.first, boost::regex(key.first, boost::regex::perl|boost::regex::icase))).first;
+        }
+
+        matched = boost::regex_search(key.second, j->second);
+        if (memo.size() >= max_memo_size)
+          memo.clear();
+        memo[key] = matched;
+      }
+
+      stack->push(Value(matched));
     }
   
     void extractNumber::execute(void) {
       Value v = stack->pop();
-      Value r(-1);
+      std::string s = v.getString();
+
+      boost::unordered_map<std::string, int>::const_iterator m = memo.find(s);
+      if (m != memo.end()) {
+        stack->push(Value(m->second));
+        return;
+      }
+
+      int result = -1;
       boost::smatch what;
-      
-      if (boost::regex_search(v.getString(), what, regexp)) {
+
+      // The matches refer back into the searched string, so it must
+      // outlive them (i.e. can't be a temporary)
+      if (boost::regex_search(s, what, regexp)) {
         unsigned i;
         int val;
         for (i=0; i<what.size(); i++) {
           if ((std::stringstream(what[i]) >> val)) {
-            r.setInt(val);
+            result = val;
             break;
           }
         }
       }
-      
-      stack->push(r);
+
+      if (memo.size() >= max_memo_size)
+        memo.clear();
+      memo[s] = result;
+      stack->push(Value(result));
     }
 
     std::string extractNumber::name(void) const {
@@ -35,6 +35,7 @@
 
 #include <loos_defs.hpp>
 #include <boost/regex.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <exceptions.hpp>
 
@@ -107,6 +108,7 @@ namespace loos {
       explicit pushString(const std::string str) : Action("pushString"), val(str) { }
       void execute(void);
       std::string name(void) const;
+      const Value& value(void) const { return(val); }
     };
 
     //! Push an integer onto the data stack
@@ -116,6 +118,7 @@ namespace loos {
       explicit pushInt(const long i) : Action("pushInt"), val(i) { }
       void execute(void);
       std::string name(void) const;
+      const Value& value(void) const { return(val); }
     };
 
     //! Push a float onto the data stack
@@ -125,6 +128,7 @@ namespace loos {
       explicit pushFloat(const float f) : Action("pushFloat"), val(f) { }
       void execute(void);
       std::string name(void) const;
+      const Value& value(void) const { return(val); }
     };
 
 
@@ -181,7 +185,9 @@ namespace loos {
     //! Regular expression matching: ARG1 regexp(S)
     /** Compiles the passed string into a regex pattern at instantiation,
      * then at execution matches the top stack entry against the
-     * pattern...
+     * pattern...  Results are remembered for each distinct string
+     * matched, since there are usually only a few hundred unique atom
+     * names, residue names, etc.
      */
 
     class matchRegex : public Action {
@@ -190,22 +196,30 @@ namespace loos {
       explicit matchRegex(const std::string s) : Action("matchRegex"), regexp(s, boost::regex::perl|boost::regex::icase), pattern(s) { }
       void execute(void);
       std::string name(void) const;
+      const boost::regex& regex(void) const { return(regexp); }
     
     private:
       std::string pattern;
+      boost::unordered_map<std::string, int> memo;
     };
   
 
     //! Regular expression matching: ARG1 regexp(ARG2)
     /** Takes the top item on the stack and compiles this into a regular
      * expression, then matches it against the next item on the stack.
-     * This is likely to be pretty inefficient, so it's better to use
-     * matchRegex instead if you can.
+     * Each distinct pattern is only compiled once, but it's still
+     * better to use matchRegex instead if you can.
      */
     class matchStringAsRegex : public Action {
     public:
       matchStringAsRegex() : Action("matchStringAsRegex") { }
       void execute(void);
+
+    private:
+      typedef std::pair<std::string, std::string>    PatternSubject;
+
+      boost::unordered_map<std::string, boost::regex> compiled;
+      boost::unordered_map<PatternSubject, int> memo;
     };
   
   
@@ -214,7 +228,8 @@ namespace loos {
      * instantiation.  At execution, examines each matched capture for
      * the first one that converts to an integer and pushes that value
      * onto the data stack.  If no match is found (or no numeric
-     * conversion works), then "-1" is pushed onto the stack.
+     * conversion works), then "-1" is pushed onto the stack.  As with
+     * matchRegex, results are remembered for each distinct string.
      */
     class extractNumber : public Action {
     public:
@@ -224,10 +239,12 @@ namespace loos {
 
       void execute(void);
       std::string name(void) const;
+      const boost::regex& regex(void) const { return(regexp); }
 
     private:
       boost::regex regexp;
       std::string pattern;
+      boost::unordered_map<std::string, int> memo;
     };
 
 
@@ -0,0 +1,666 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include <KernelPlan.hpp>
+#include <Kernel.hpp>
+#include <KernelActions.hpp>
+#include <Atom.hpp>
+#include <Selectors.hpp>
+
+#include <map>
+#include <sstream>
+#include <typeinfo>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+
+namespace loos {
+
+  namespace internal {
+
+    namespace {
+
+      typedef boost::dynamic_bitset<>   Mask;
+
+
+      // A string property for every atom, stored as an index into a
+      // table of the unique strings
+      struct StringColumn {
+        std::vector<uint> ids;
+        std::vector<std::string> strings;
+      };
+
+
+      // What the per-atom Kernel would have on its stack, but for all
+      // atoms at once
+      struct Column {
+        enum Kind { CONSTANT, STRINGS, INTS, MASK };
+
+        Column() : kind(CONSTANT) { }
+        explicit Column(const Value& v) : kind(CONSTANT), value(v) { }
+        explicit Column(const boost::shared_ptr<const StringColumn>& s) : kind(STRINGS), strings(s) { }
+        explicit Column(const boost::shared_ptr<const std::vector<long> >& i) : kind(INTS), ints(i) { }
+        explicit Column(const boost::shared_ptr<const Mask>& m) : kind(MASK), mask(m) { }
+
+        // The Value the Kernel would have for atom i
+        Value at(const uint i) const {
+          switch(kind) {
+          case STRINGS: return(Value(strings->strings[strings->ids[i]]));
+          case INTS: return(Value((*ints)[i]));
+          case MASK: return(Value(static_cast<int>((*mask)[i])));
+          case CONSTANT:
+          default:
+            return(value);
+          }
+        }
+
+        // True if every atom would have an INT value here
+        bool isInt(void) const {
+          return(kind == INTS || kind == MASK || (kind == CONSTANT && value.type == Value::INT));
+        }
+
+        long intAt(const uint i) const {
+          switch(kind) {
+          case INTS: return((*ints)[i]);
+          case MASK: return((*mask)[i]);
+          default:
+            return(value.itg);
+          }
+        }
+
+        Kind kind;
+        Value value;
+        boost::shared_ptr<const StringColumn> strings;
+        boost::shared_ptr<const std::vector<long> > ints;
+        boost::shared_ptr<const Mask> mask;
+      };
+
+
+      typedef uint (Atom::*StringProperty)(void) const;
+
+
+      template<class T> bool isAction(const Action* a) {
+        return(typeid(*a) == typeid(T));
+      }
+
+
+      // Same as compare() for two INT values
+      int compareInts(const long x, const long y) {
+        int e = x - y;
+        return(e);
+      }
+
+
+      bool testComparison(const KernelPlan::Opcode op, const int c) {
+        switch(op) {
+        case KernelPlan::EQUALS: return(c == 0);
+        case KernelPlan::LESS_THAN: return(c < 0);
+        case KernelPlan::LESS_THAN_EQUALS: return(c <= 0);
+        case KernelPlan::GREATER_THAN: return(c > 0);
+        case KernelPlan::GREATER_THAN_EQUALS:
+        default:
+          return(c >= 0);
+        }
+      }
+
+
+      // As the comparison Actions do it: < and <= are false if either
+      // operand is a negative integer
+      bool checksNegative(const KernelPlan::Opcode op) {
+        return(op == KernelPlan::LESS_THAN || op == KernelPlan::LESS_THAN_EQUALS);
+      }
+
+
+      bool applyComparison(const KernelPlan::Opcode op, const Value& lhs, const Value& rhs) {
+        if (checksNegative(op) &&
+            ((lhs.type == Value::INT && lhs.itg < 0) || (rhs.type == Value::INT && rhs.itg < 0)))
+          return(false);
+        return(testComparison(op, compare(lhs, rhs)));
+      }
+
+
+
+      class Evaluator {
+      public:
+        explicit Evaluator(const std::vector<pAtom>& atoms) : _atoms(atoms), _n(atoms.size()) { }
+
+        Mask run(const std::vector<KernelPlan::Step>& steps);
+
+      private:
+        void push(const Column& c) { _stack.push_back(c); }
+        Column pop(void);
+
+        Column strings(const KernelPlan::Opcode op);
+        boost::shared_ptr<const StringColumn> internStrings(StringProperty property) const;
+        Column ints(const KernelPlan::Opcode op) const;
+
+        Column comparison(const KernelPlan::Opcode op, const Column& lhs, const Column& rhs) const;
+        Column matchRegex(const Column& subject, const boost::regex& re) const;
+        Column extractNumber(const Column& subject, const boost::regex& re) const;
+        Column matchStringAsRegex(const Column& subject, const Column& pattern) const;
+
+        Mask toMask(const Column& c) const;
+        Column hydrogen(void);
+        Column backbone(void) const;
+
+      private:
+        const std::vector<pAtom>& _atoms;
+        uint _n;
+        std::vector<Column> _stack;
+
+        // String properties are only interned once per evaluation
+        std::map<KernelPlan::Opcode, Column> _string_cache;
+      };
+
+
+
+      Column Evaluator::pop(void) {
+        if (_stack.empty())
+          throw(LOOSError("Operation requested on an empty stack."));
+        Column c = _stack.back();
+        _stack.pop_back();
+        return(c);
+      }
+
+
+      boost::shared_ptr<const StringColumn> Evaluator::internStrings(StringProperty property) const {
+        boost::shared_ptr<StringColumn> col(new StringColumn);
+        col->ids.resize(_n);
+
+        // Maps StringTable handles to indices into col->strings
+        boost::unordered_map<uint, uint> lookup;
+        uint last = 0;
+        uint last_id = 0;
+
+        for (uint i=0; i<_n; ++i) {
+          uint h = ((*_atoms[i]).*property)();
+
+          // Neighboring atoms usually share resnames and segids, so
+          // check the last handle before hashing
+          if (i == 0 || h != last) {
+            boost::unordered_map<uint, uint>::iterator j = lookup.find(h);
+            if (j == lookup.end()) {
+              last_id = col->strings.size();
+              lookup[h] = last_id;
+              col->strings.push_back(StringTable::lookup(h));
+            } else
+              last_id = j->second;
+            last = h;
+          }
+          col->ids[i] = last_id;
+        }
+
+        return(col);
+      }
+
+
+      Column Evaluator::strings(const KernelPlan::Opcode op) {
+        std::map<KernelPlan::Opcode, Column>::const_iterator i = _string_cache.find(op);
+        if (i != _string_cache.end())
+          return(i->second);
+
+        StringProperty property;
+        switch(op) {
+        case KernelPlan::PUSH_NAME: property = &Atom::nameHandle; break;
+        case KernelPlan::PUSH_RESNAME: property = &Atom::resnameHandle; break;
+        case KernelPlan::PUSH_SEGID: property = &Atom::segidHandle; break;
+        case KernelPlan::PUSH_CHAINID:
+        default:
+          property = &Atom::chainIdHandle;
+        }
+
+        Column c(internStrings(property));
+        _string_cache[op] = c;
+        return(c);
+      }
+
+
+      Column Evaluator::ints(const KernelPlan::Opcode op) const {
+        boost::shared_ptr< std::vector<long> > col(new std::vector<long>(_n));
+        std::vector<long>& v = *col;
+
+        switch(op) {
+        case KernelPlan::PUSH_ID:
+          for (uint i=0; i<_n; ++i)
+            v[i] = _atoms[i]->id();
+          break;
+        case KernelPlan::PUSH_RESID:
+          for (uint i=0; i<_n; ++i)
+            v[i] = _atoms[i]->resid();
+          break;
+        case KernelPlan::PUSH_INDEX:
+        default:
+          for (uint i=0; i<_n; ++i)
+            v[i] = static_cast<long>(_atoms[i]->index());
+        }
+
+        return(Column(boost::shared_ptr<const std::vector<long> >(col)));
+      }
+
+
+
+      Column Evaluator::comparison(const KernelPlan::Opcode op, const Column& lhs, const Column& rhs) const {
+        if (lhs.kind == Column::CONSTANT && rhs.kind == Column::CONSTANT)
+          return(Column(Value(applyComparison(op, lhs.value, rhs.value))));
+
+        boost::shared_ptr<Mask> result(new Mask(_n));
+        Mask& m = *result;
+
+        if ((lhs.kind == Column::STRINGS && rhs.kind == Column::CONSTANT)
+            || (lhs.kind == Column::CONSTANT && rhs.kind == Column::STRINGS)) {
+
+          // Compare each unique string once...
+          bool strings_first = (lhs.kind == Column::STRINGS);
+          const StringColumn& col = strings_first ? *lhs.strings : *rhs.strings;
+          const Value& constant = strings_first ? rhs.value : lhs.value;
+
+          std::vector<char> table(col.strings.size());
+          for (uint k=0; k<table.size(); ++k) {
+            Value s(col.strings[k]);
+            table[k] = strings_first ? applyComparison(op, s, constant) : applyComparison(op, constant, s);
+          }
+
+          for (uint i=0; i<_n; ++i)
+            if (table[col.ids[i]])
+              m.set(i);
+
+        } else if (lhs.isInt() && rhs.isInt() && (lhs.kind == Column::CONSTANT || rhs.kind == Column::CONSTANT)) {
+
+          bool negative_false = checksNegative(op);
+          for (uint i=0; i<_n; ++i) {
+            long x = lhs.intAt(i);
+            long y = rhs.intAt(i);
+            if (negative_false && (x < 0 || y < 0))
+              continue;
+            if (testComparison(op, compareInts(x, y)))
+              m.set(i);
+          }
+
+        } else {
+
+          // Anything else is done one atom at a time
+          for (uint i=0; i<_n; ++i)
+            if (applyComparison(op, lhs.at(i), rhs.at(i)))
+              m.set(i);
+        }
+
+        return(Column(boost::shared_ptr<const Mask>(result)));
+      }
+
+
+      Column Evaluator::matchRegex(const Column& subject, const boost::regex& re) const {
+        if (subject.kind == Column::CONSTANT)
+          return(Column(Value(static_cast<int>(boost::regex_search(subject.value.getString(), re)))));
+
+        boost::shared_ptr<Mask> result(new Mask(_n));
+        Mask& m = *result;
+
+        if (subject.kind == Column::STRINGS) {
+          const StringColumn& col = *subject.strings;
+          std::vector<char> table(col.strings.size());
+          for (uint k=0; k<table.size(); ++k)
+            table[k] = boost::regex_search(col.strings[k], re);
+
+          for (uint i=0; i<_n; ++i)
+            if (table[col.ids[i]])
+              m.set(i);
+
+        } else
+          for (uint i=0; i<_n; ++i)
+            if (boost::regex_search(subject.at(i).getString(), re))
+              m.set(i);
+
+        return(Column(boost::shared_ptr<const Mask>(result)));
+      }
+
+
+      // Same as the extractNumber Action, for a single string
+      long extractFrom(const std::string& s, const boost::regex& re) {
+        boost::smatch what;
+
+        if (boost::regex_search(s, what, re)) {
+          for (unsigned i=0; i<what.size(); i++) {
+            int val;
+            if ((std::stringstream(what[i]) >> val))
+              return(val);
+          }
+        }
+
+        return(-1);
+      }
+
+
+      Column Evaluator::extractNumber(const Column& subject, const boost::regex& re) const {
+        if (subject.kind == Column::CONSTANT)
+          return(Column(Value(extractFrom(subject.value.getString(), re))));
+
+        boost::shared_ptr< std::vector<long> > result(new std::vector<long>(_n));
+        std::vector<long>& v = *result;
+
+        if (subject.kind == Column::STRINGS) {
+          const StringColumn& col = *subject.strings;
+          std::vector<long> table(col.strings.size());
+          for (uint k=0; k<table.size(); ++k)
+            table[k] = extractFrom(col.strings[k], re);
+
+          for (uint i=0; i<_n; ++i)
+            v[i] = table[col.ids[i]];
+
+        } else
+          for (uint i=0; i<_n; ++i)
+            v[i] = extractFrom(subject.at(i).getString(), re);
+
+        return(Column(boost::shared_ptr<const std::vector<long> >(result)));
+      }
+
+
+      Column Evaluator::matchStringAsRegex(const Column& subject, const Column& pattern) const {
+        if (pattern.kind == Column::CONSTANT) {
+          boost::regex re(pattern.value.getString(), boost::regex::perl|boost::regex::icase);
+          return(matchRegex(subject, re));
+        }
+
+        // Each distinct pattern is only compiled once
+        boost::unordered_map<std::string, boost::regex> compiled;
+        boost::shared_ptr<Mask> result(new Mask(_n));
+        for (uint i=0; i<_n; ++i) {
+          std::string p = pattern.at(i).getString();
+          boost::unordered_map<std::string, boost::regex>::iterator j = compiled.find(p);
+          if (j == compiled.end())
+            j = compiled.insert(std::make_pair(p, boost::regex(p, boost::regex::perl|boost::regex::icase))).first;
+          if (boost::regex_search(subject.at(i).getString(), j->second))
+            result->set(i);
+        }
+
+        return(Column(boost::shared_ptr<const Mask>(result)));
+      }
+
+
+      Mask Evaluator::toMask(const Column& c) const {
+        switch(c.kind) {
+        case Column::MASK:
+          return(*c.mask);
+
+        case Column::INTS:
+          {
+            Mask m(_n);
+            for (uint i=0; i<_n; ++i)
+              if ((*c.ints)[i])
+                m.set(i);
+            return(m);
+          }
+
+        case Column::CONSTANT:
+        default:
+          {
+            Mask m(_n);
+            if (c.value.itg)
+              m.set();
+            return(m);
+          }
+        }
+      }
+
+
+      Column Evaluator::hydrogen(void) {
+        Column names = strings(KernelPlan::PUSH_NAME);
+        const StringColumn& col = *names.strings;
+        std::vector<char> table(col.strings.size());
+        for (uint k=0; k<table.size(); ++k)
+          table[k] = (!col.strings[k].empty() && col.strings[k][0] == 'H');
+
+        boost::shared_ptr<Mask> result(new Mask(_n));
+        for (uint i=0; i<_n; ++i) {
+          if (!table[col.ids[i]])
+            continue;
+          if (_atoms[i]->checkProperty(Atom::massbit) && !(_atoms[i]->mass() < 1.1))
+            continue;
+          result->set(i);
+        }
+
+        return(Column(boost::shared_ptr<const Mask>(result)));
+      }
+
+
+      Column Evaluator::backbone(void) const {
+        BackboneSelector bbsel;
+        boost::shared_ptr<Mask> result(new Mask(_n));
+        for (uint i=0; i<_n; ++i)
+          if (bbsel(_atoms[i]))
+            result->set(i);
+
+        return(Column(boost::shared_ptr<const Mask>(result)));
+      }
+
+
+
+      Mask Evaluator::run(const std::vector<KernelPlan::Step>& steps) {
+
+        for (std::vector<KernelPlan::Step>::const_iterator step = steps.begin(); step != steps.end(); ++step) {
+          switch(step->op) {
+
+          case KernelPlan::PUSH_VALUE:
+            push(Column(step->value));
+            break;
+
+          case KernelPlan::PUSH_NAME:
+          case KernelPlan::PUSH_RESNAME:
+          case KernelPlan::PUSH_SEGID:
+          case KernelPlan::PUSH_CHAINID:
+            push(strings(step->op));
+            break;
+
+          case KernelPlan::PUSH_ID:
+          case KernelPlan::PUSH_RESID:
+          case KernelPlan::PUSH_INDEX:
+            push(ints(step->op));
+            break;
+
+          case KernelPlan::DROP:
+            pop();
+            break;
+
+          case KernelPlan::DUP:
+            {
+              Column c = pop();
+              push(c);
+              push(c);
+            }
+            break;
+
+          case KernelPlan::EQUALS:
+          case KernelPlan::LESS_THAN:
+          case KernelPlan::LESS_THAN_EQUALS:
+          case KernelPlan::GREATER_THAN:
+          case KernelPlan::GREATER_THAN_EQUALS:
+            {
+              Column rhs = pop();
+              Column lhs = pop();
+              push(comparison(step->op, lhs, rhs));
+            }
+            break;
+
+          case KernelPlan::MATCH_REGEX:
+            push(matchRegex(pop(), *(step->regex)));
+            break;
+
+          case KernelPlan::EXTRACT_NUMBER:
+            push(extractNumber(pop(), *(step->regex)));
+            break;
+
+          case KernelPlan::MATCH_STRING_AS_REGEX:
+            {
+              Column pattern = pop();
+              Column subject = pop();
+              push(matchStringAsRegex(subject, pattern));
+            }
+            break;
+
+          case KernelPlan::LOGICAL_AND:
+          case KernelPlan::LOGICAL_OR:
+            {
+              Column v2 = pop();
+              Column v1 = pop();
+              bool is_and = (step->op == KernelPlan::LOGICAL_AND);
+              if (!(v1.isInt() && v2.isInt()))
+                throw(LOOSError(is_and ? "Invalid operands to logicalAnd" : "Invalid operands to logicalOr"));
+
+              boost::shared_ptr<Mask> result(new Mask(toMask(v1)));
+              if (is_and)
+                *result &= toMask(v2);
+              else
+                *result |= toMask(v2);
+              push(Column(boost::shared_ptr<const Mask>(result)));
+            }
+            break;
+
+          case KernelPlan::LOGICAL_NOT:
+            {
+              Column v1 = pop();
+              if (!v1.isInt())
+                throw(LOOSError("Invalid operand to logicalNot"));
+              boost::shared_ptr<Mask> result(new Mask(toMask(v1)));
+              result->flip();
+              push(Column(boost::shared_ptr<const Mask>(result)));
+            }
+            break;
+
+          case KernelPlan::LOGICAL_TRUE:
+            push(Column(Value(1)));
+            break;
+
+          case KernelPlan::HYDROGEN:
+            push(hydrogen());
+            break;
+
+          case KernelPlan::BACKBONE:
+            push(backbone());
+            break;
+          }
+        }
+
+        // Same checks as KernelSelector...
+        if (_stack.size() != 1)
+          throw(LOOSError("Execution error - unexpected values on stack"));
+        if (!_stack.back().isInt())
+          throw(LOOSError("Execution error - unexpected value on top of stack"));
+
+        return(toMask(_stack.back()));
+      }
+
+    }
+
+
+
+    KernelPlan::KernelPlan(const Kernel& k) : _compiled(true) {
+      const std::vector<Action*>& commands = k.commands();
+
+      for (std::vector<Action*>::const_iterator i = commands.begin(); i != commands.end(); ++i) {
+        const Action* a = *i;
+        Step step;
+
+        if (isAction<pushString>(a)) {
+          step.op = PUSH_VALUE;
+          step.value = static_cast<const pushString*>(a)->value();
+        } else if (isAction<pushInt>(a)) {
+          step.op = PUSH_VALUE;
+          step.value = static_cast<const pushInt*>(a)->value();
+        } else if (isAction<pushFloat>(a)) {
+          step.op = PUSH_VALUE;
+          step.value = static_cast<const pushFloat*>(a)->value();
+        } else if (isAction<pushAtomName>(a))
+          step.op = PUSH_NAME;
+        else if (isAction<pushAtomId>(a))
+          step.op = PUSH_ID;
+        else if (isAction<pushAtomIndex>(a))
+          step.op = PUSH_INDEX;
+        else if (isAction<pushAtomResname>(a))
+          step.op = PUSH_RESNAME;
+        else if (isAction<pushAtomResid>(a))
+          step.op = PUSH_RESID;
+        else if (isAction<pushAtomSegid>(a))
+          step.op = PUSH_SEGID;
+        else if (isAction<pushAtomChainId>(a))
+          step.op = PUSH_CHAINID;
+        else if (isAction<drop>(a))
+          step.op = DROP;
+        else if (isAction<dup>(a))
+          step.op = DUP;
+        else if (isAction<equals>(a))
+          step.op = EQUALS;
+        else if (isAction<lessThan>(a))
+          step.op = LESS_THAN;
+        else if (isAction<lessThanEquals>(a))
+          step.op = LESS_THAN_EQUALS;
+        else if (isAction<greaterThan>(a))
+          step.op = GREATER_THAN;
+        else if (isAction<greaterThanEquals>(a))
+          step.op = GREATER_THAN_EQUALS;
+        else if (isAction<matchRegex>(a)) {
+          step.op = MATCH_REGEX;
+          step.regex = &(static_cast<const matchRegex*>(a)->regex());
+        } else if (isAction<matchStringAsRegex>(a))
+          step.op = MATCH_STRING_AS_REGEX;
+        else if (isAction<extractNumber>(a)) {
+          step.op = EXTRACT_NUMBER;
+          step.regex = &(static_cast<const extractNumber*>(a)->regex());
+        } else if (isAction<logicalAnd>(a))
+          step.op = LOGICAL_AND;
+        else if (isAction<logicalOr>(a))
+          step.op = LOGICAL_OR;
+        else if (isAction<logicalNot>(a))
+          step.op = LOGICAL_NOT;
+        else if (isAction<logicalTrue>(a))
+          step.op = LOGICAL_TRUE;
+        else if (isAction<Hydrogen>(a))
+          step.op = HYDROGEN;
+        else if (isAction<Backbone>(a))
+          step.op = BACKBONE;
+        else {
+          _compiled = false;
+          _steps.clear();
+          return;
+        }
+
+        _steps.push_back(step);
+      }
+    }
+
+
+    boost::dynamic_bitset<> KernelPlan::evaluate(const std::vector<pAtom>& atoms) const {
+      if (!_compiled)
+        throw(LOOSError("Attempting to evaluate a KernelPlan that could not be compiled"));
+
+      // The Kernel is never run for an empty group, so there's nothing
+      // to check
+      if (atoms.empty())
+        return(boost::dynamic_bitset<>());
+
+      Evaluator evaluator(atoms);
+      return(evaluator.run(_steps));
+    }
+
+  }
+
+}
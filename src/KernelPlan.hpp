@@ -0,0 +1,96 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#if !defined(LOOS_KERNELPLAN_HPP)
+#define LOOS_KERNELPLAN_HPP
+
+#include <vector>
+
+#include <boost/dynamic_bitset.hpp>
+#include <boost/regex.hpp>
+
+#include <loos_defs.hpp>
+#include <exceptions.hpp>
+
+#include "KernelValue.hpp"
+
+
+namespace loos {
+
+  class Kernel;
+
+  namespace internal {
+
+    //! Column-wise evaluation of the commands in a Kernel
+    /**
+     * The Kernel executes its commands once for every atom, pushing
+     * and popping a Value for each step.  A KernelPlan instead takes
+     * the same commands and runs each of them once over the whole list
+     * of atoms.  String properties (name, resname, segid, chain ID)
+     * are interned, so string comparisons and regular expressions only
+     * need to be tested once per unique string.  Integer properties
+     * are compared as plain integer arrays, and the logical operators
+     * work on bitmasks.
+     *
+     * The results (including any errors thrown) are the same as
+     * running the Kernel on each atom.  If the Kernel contains a
+     * command the plan does not know about, then compiled() returns
+     * false and the Kernel should be used directly.
+     *
+     * The plan refers to data held by the Kernel's commands, so the
+     * Kernel must outlive the plan.
+     */
+    class KernelPlan {
+    public:
+      explicit KernelPlan(const Kernel& k);
+
+      //! True if every command in the Kernel could be compiled
+      bool compiled(void) const { return(_compiled); }
+
+      //! Bit i is set if atoms[i] is selected
+      boost::dynamic_bitset<> evaluate(const std::vector<pAtom>& atoms) const;
+
+      enum Opcode { PUSH_VALUE, PUSH_NAME, PUSH_ID, PUSH_INDEX, PUSH_RESNAME, PUSH_RESID, PUSH_SEGID, PUSH_CHAINID,
+                    DROP, DUP, EQUALS, LESS_THAN, LESS_THAN_EQUALS, GREATER_THAN, GREATER_THAN_EQUALS,
+                    MATCH_REGEX, MATCH_STRING_AS_REGEX, EXTRACT_NUMBER,
+                    LOGICAL_AND, LOGICAL_OR, LOGICAL_NOT, LOGICAL_TRUE, HYDROGEN, BACKBONE };
+
+      struct Step {
+        Step() : op(LOGICAL_TRUE), regex(0) { }
+
+        Opcode op;
+        Value value;                  // Constant for PUSH_VALUE
+        const boost::regex* regex;    // Pattern for MATCH_REGEX and EXTRACT_NUMBER
+      };
+
+    private:
+      std::vector<Step> _steps;
+      bool _compiled;
+    };
+
+  }
+
+}
+
+
+#endif
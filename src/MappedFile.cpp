@@ -0,0 +1,93 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <MappedFile.hpp>
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+namespace loos {
+
+
+  void MappedFile::open(const std::string& fname) {
+    close();
+    filename_ = fname;
+
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw(FileOpenError(fname, strerror(errno), errno));
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0) {
+      int err = errno;
+      ::close(fd);
+      throw(FileOpenError(fname, strerror(err), err));
+    }
+
+    size_ = sb.st_size;
+    if (size_ == 0) {
+      ::close(fd);
+      throw(FileOpenError(fname, "Cannot memory-map an empty file"));
+    }
+
+    void* p = mmap(0, size_, PROT_READ, MAP_SHARED, fd, 0);
+    int err = errno;
+    ::close(fd);          // The mapping keeps its own reference to the file
+    if (p == MAP_FAILED) {
+      size_ = 0;
+      throw(FileOpenError(fname, std::string("Cannot memory-map file: ") + strerror(err), err));
+    }
+
+    data_ = static_cast<char*>(p);
+  }
+
+
+  void MappedFile::close() {
+    if (data_ != 0)
+      munmap(data_, size_);
+    data_ = 0;
+    size_ = 0;
+  }
+
+
+  void MappedFile::willNeed(const unsigned long offset, const unsigned long length) const {
+    if (data_ == 0 || offset >= size_)
+      return;
+
+    // madvise() requires a page-aligned address...
+    unsigned long pagesize = sysconf(_SC_PAGESIZE);
+    unsigned long start = offset - (offset % pagesize);
+    unsigned long end = offset + length;
+    if (end > size_)
+      end = size_;
+
+    madvise(data_ + start, end - start, MADV_WILLNEED);
+  }
+
+}
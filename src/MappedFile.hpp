@@ -0,0 +1,80 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(LOOS_MAPPEDFILE_HPP)
+#define LOOS_MAPPEDFILE_HPP
+
+#include <string>
+
+#include <boost/utility.hpp>
+
+#include <loos_defs.hpp>
+#include <exceptions.hpp>
+
+
+namespace loos {
+
+  //! Read-only, memory-mapped view of an entire file
+  /**
+   * The file is mapped when opened and unmapped when the object is
+   * destroyed (or close() is called).  Data is paged in on demand by
+   * the kernel, so mapping even a very large file is cheap.  Use
+   * willNeed() to hint that a region will be accessed soon so the
+   * kernel can start reading it ahead of time.
+   */
+  class MappedFile : public boost::noncopyable {
+  public:
+    MappedFile() : data_(0), size_(0) { }
+
+    //! Maps the file named \a fname, throwing a FileOpenError on failure
+    explicit MappedFile(const std::string& fname) : data_(0), size_(0) {
+      open(fname);
+    }
+
+    ~MappedFile() { close(); }
+
+    void open(const std::string& fname);
+    void close();
+
+    bool isOpen() const { return(data_ != 0); }
+
+    //! Pointer to the start of the mapped file
+    const char* data() const { return(data_); }
+
+    //! Size of the file (in bytes) at the time it was mapped
+    unsigned long size() const { return(size_); }
+
+    std::string filename() const { return(filename_); }
+
+    //! Advise the kernel that the region [offset, offset+length) will be needed soon
+    void willNeed(const unsigned long offset, const unsigned long length) const;
+
+  private:
+    char* data_;
+    unsigned long size_;
+    std::string filename_;
+  };
+
+}
+
+
+#endif
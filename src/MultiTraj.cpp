@@ -23,31 +23,198 @@
 
 #include <MultiTraj.hpp>
 
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/algorithm/string.hpp>
+
 namespace loos {
 
 
+	namespace internal {
+
+		// The NetCDF library is not thread-safe, so any trajectory that
+		// may be opened through it must be opened one at a time...
+		boost::mutex netcdf_open_mutex;
+
+		bool mayUseNetcdf(const std::string& fname) {
+			std::string::size_type i = fname.rfind('.');
+			if (i == std::string::npos)
+				return(false);
+			std::string suffix = boost::to_lower_copy(fname.substr(i+1));
+			return(suffix == "nc" || suffix == "netcdf" || suffix == "crd" || suffix == "mdcrd");
+		}
+
+
+		// Opens trajectories from a list in parallel, recording their
+		// sizes.  The first few are kept open (so they need not be
+		// reopened right away).  Trajectories that fail to open are
+		// flagged so the caller can retry them and get the original
+		// exception.
+		class MultiTrajScanner {
+		public:
+			MultiTrajScanner(const std::vector<std::string>& names, const AtomicGroup& model, const uint nkeep)
+				: _names(names), _model(model), _nkeep(nkeep), _next(0),
+				  _sizes(names.size(), 0), _opened(names.size(), 0), _trajs(names.size())
+			{ }
+
+			void scan(uint nthreads) {
+				if (nthreads > _names.size())
+					nthreads = _names.size();
+
+				if (nthreads <= 1) {
+					worker();
+					return;
+				}
+
+				boost::thread_group threads;
+				for (uint i=0; i<nthreads; ++i)
+					threads.create_thread(boost::bind(&MultiTrajScanner::worker, this));
+				threads.join_all();
+			}
+
+			bool opened(const uint i) const { return(_opened[i]); }
+			const std::vector<uint>& sizes() const { return(_sizes); }
+			const std::vector<pTraj>& trajectories() const { return(_trajs); }
+
+		private:
+			void worker() {
+				while (true) {
+					uint i;
+					{
+						boost::mutex::scoped_lock lock(_mutex);
+						if (_next >= _names.size())
+							return;
+						i = _next++;
+					}
+
+					try {
+						pTraj traj;
+						if (mayUseNetcdf(_names[i])) {
+							boost::mutex::scoped_lock lock(netcdf_open_mutex);
+							traj = createTrajectory(_names[i], _model);
+						} else
+							traj = createTrajectory(_names[i], _model);
+
+						_sizes[i] = traj->nframes();
+						_opened[i] = 1;
+						if (i < _nkeep)
+							_trajs[i] = traj;
+					}
+					catch (...) {
+						// Left for the caller to retry...
+					}
+				}
+			}
+
+			const std::vector<std::string>& _names;
+			const AtomicGroup& _model;
+			uint _nkeep;
+
+			boost::mutex _mutex;
+			uint _next;
+
+			// Each thread only writes to its own elements
+			std::vector<uint> _sizes;
+			std::vector<char> _opened;
+			std::vector<pTraj> _trajs;
+		};
+
+	}
+
+
+
+	void MultiTrajectory::addTrajectory(const std::string& filename) {
+		pTraj traj = createTrajectory(filename, _model);
+		if (!_atom_subset.empty())
+			traj->setAtomSubset(_atom_subset);
+
+		_filenames.push_back(filename);
+		_sizes.push_back(traj->nframes());
+		_trajectories.push_back(traj);
+		touch(_filenames.size() - 1);
+		closeExcessTrajectories();
+
+		_nframes += nframes(_filenames.size() - 1);
+	}
+
+
+	void MultiTrajectory::maxOpenTrajectories(const uint n) {
+		if (n == 0)
+			throw(LOOSError("MultiTraj must be able to keep at least one trajectory open"));
+		_max_open = n;
+		closeExcessTrajectories();
+	}
+
+
+	// Moves trajectory i to the front of the most-recently-used list
+	void MultiTrajectory::touch(const uint i) const {
+		if (!_open.empty() && _open.front() == i)
+			return;
+		_open.remove(i);
+		_open.push_front(i);
+	}
+
+
+	// Closes the least recently used trajectories until no more than
+	// _max_open are open, but never the current one or the one the
+	// last frame was read from (which would be reopened at frame 0)
+	void MultiTrajectory::closeExcessTrajectories() const {
+		std::list<uint>::iterator i = _open.end();
+		while (_open.size() > _max_open && i != _open.begin()) {
+			--i;
+			if (*i == _curtraj || *i == _last_read)
+				continue;
+			_trajectories[*i].reset();
+			i = _open.erase(i);
+		}
+	}
+
+
+	// Returns the ith trajectory, opening it if necessary
+	pTraj MultiTrajectory::trajectory(const uint i) const {
+		if (!_trajectories[i]) {
+			pTraj traj = createTrajectory(_filenames[i], _model);
+			if (traj->nframes() != _sizes[i])
+				throw(LOOSError("Trajectory '" + _filenames[i] + "' has changed size since it was added to the MultiTraj"));
+			if (!_atom_subset.empty())
+				traj->setAtomSubset(_atom_subset);
+			_trajectories[i] = traj;
+		}
+
+		touch(i);
+		if (_open.size() > _max_open) {
+			pTraj traj = _trajectories[i];   // Keep a reference in case it is closed
+			closeExcessTrajectories();
+			return(traj);
+		}
+		return(_trajectories[i]);
+	}
+
+
 	void MultiTrajectory::findNextUsableTraj() {
-		for (; _curtraj < _trajectories.size(); ++_curtraj)
-			if (_trajectories[_curtraj]->nframes() > _skip)
+		for (; _curtraj < _filenames.size(); ++_curtraj)
+			if (_sizes[_curtraj] > _skip)
 				break;
 	}
 
-	//! Rewinds MultiTrajectory and all contained trajectories
+	//! Rewinds MultiTrajectory
+	/**
+	 * Only the first usable trajectory is touched here, since frames
+	 * are always read from the sub-trajectories by index.
+	 */
 	void MultiTrajectory::rewindImpl() {
-
-		for (uint i=0; i<_trajectories.size(); ++i)
-			_trajectories[i]->rewind();
 		_curtraj = 0;
 		_curframe = _skip;
 		findNextUsableTraj();
-		if (!eof())
-			_trajectories[_curtraj]->readFrame(_curframe);
+		if (!eof() && trajectory(_curtraj)->readFrame(_curframe))
+			_last_read = _curtraj;
 	}
 
 
 	MultiTrajectory::Location MultiTrajectory::frameIndexToLocation(const uint i) {
 		uint k, j;
-		for (j=k=0; k<_trajectories.size(); ++k) {
+		for (j=k=0; k<_filenames.size(); ++k) {
 			uint n = nframes(k);
 			if (j + n > i)
 				break;
@@ -73,26 +240,73 @@ namespace loos {
 	bool MultiTrajectory::parseFrame() {
 		if (eof() || atEnd())
 			return 0;
-		return(_trajectories[_curtraj]->readFrame(_curframe));
+		if (!trajectory(_curtraj)->readFrame(_curframe))
+			return(false);
+		_last_read = _curtraj;
+		return(true);
 	}
 
 	void MultiTrajectory::updateGroupCoordsImpl(AtomicGroup& g) {
 		if (!eof())
-			_trajectories[_curtraj]->updateGroupCoords(g);
+			trajectory(_curtraj)->updateGroupCoords(g);
+	}
+
+
+	void MultiTrajectory::updateArenaCoordsImpl(CoordinateArena& arena) {
+		if (!eof())
+			trajectory(_curtraj)->updateArenaCoords(arena);
 	}
 
 	void MultiTrajectory::updateGroupVelocitiesImpl(AtomicGroup& g) {
 		if (!eof())
-			_trajectories[_curtraj]->updateGroupVelocities(g);
+			trajectory(_curtraj)->updateGroupVelocities(g);
 	}
 
 
+	// Pass the atom subset along to all open trajectories (the others
+	// get it when they are opened)
+	void MultiTrajectory::atomSubsetChangedImpl() {
+		for (uint i=0; i<_trajectories.size(); ++i) {
+			if (!_trajectories[i])
+				continue;
+			if (_atom_subset.empty())
+				_trajectories[i]->clearAtomSubset();
+			else
+				_trajectories[i]->setAtomSubset(_atom_subset);
+		}
+	}
+
+
+	// Sizes of the trajectories are found by opening them in parallel.
+	// Only the first _max_open are kept open.
 	void MultiTrajectory::initWithList(const std::vector<std::string>& filenames, const AtomicGroup& model) {
+		internal::MultiTrajScanner scanner(filenames, model, _max_open);
+		uint nthreads = boost::thread::hardware_concurrency();
+		if (nthreads < 4)
+			nthreads = 4;       // Opening is often bound by I/O latency, not CPU
+		scanner.scan(nthreads);
+
+		// Reopen any failed trajectories here so the original exception
+		// propagates to the caller
+		std::vector<uint> sizes = scanner.sizes();
+		for (uint i=0; i<filenames.size(); ++i)
+			if (!scanner.opened(i))
+				sizes[i] = createTrajectory(filenames[i], model)->nframes();
+
+		uint base = _filenames.size();
 		for (uint i=0; i<filenames.size(); ++i) {
-			pTraj traj = createTrajectory(filenames[i], model);
-			_trajectories.push_back(traj);
-			_nframes += nframes(i);
+			_filenames.push_back(filenames[i]);
+			_sizes.push_back(sizes[i]);
+			_trajectories.push_back(scanner.trajectories()[i]);
+			_nframes += nframes(base + i);
 		}
+
+		// Earlier trajectories are more recently used, so they are
+		// the last to be closed
+		for (uint i=filenames.size(); i > 0; --i)
+			if (_trajectories[base + i - 1])
+				touch(base + i - 1);
+		closeExcessTrajectories();
 	}
 
 }
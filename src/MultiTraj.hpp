@@ -22,6 +22,8 @@
 #if !defined(LOOS_MULTITRAJ_HPP)
 #define LOOS_MULTITRAJ_HPP
 
+#include <list>
+
 #include <loos_defs.hpp>
 #include <AtomicGroup.hpp>
 #include <Trajectory.hpp>
@@ -38,29 +40,36 @@ namespace loos {
 	 * Note that the skip and stride settings are applied to each sub-trajectory (as opposed
 	 * to the composite trajectory).  They are also set ONLY at instantiation.
 	 *
+	 * The sub-trajectories are scanned in parallel when the
+	 * MultiTrajectory is created (to get their sizes), but are only
+	 * kept open as needed.  When reading crosses into a new
+	 * sub-trajectory, it is opened and the least recently used one is
+	 * closed if more than maxOpenTrajectories() are open.  This keeps
+	 * the number of open files bounded when combining very many
+	 * trajectories.
 	 */
 	class MultiTrajectory : public Trajectory {
 	public:
 		typedef std::pair<uint, uint>   Location;
 
 		MultiTrajectory()
-			: _nframes(0), _skip(0), _stride(1), _curtraj(0), _curframe(0)
+			: _nframes(0), _skip(0), _stride(1), _curtraj(0), _curframe(0), _last_read(no_trajectory), _max_open(default_max_open)
 		{ cached_first = true; }
 
 		//! instantiate a new empty MultiTrajectory
 		MultiTrajectory(const AtomicGroup& model)
-			: _nframes(0), _skip(0), _stride(1), _curtraj(0), _curframe(0), _model(model)
+			: _nframes(0), _skip(0), _stride(1), _curtraj(0), _curframe(0), _last_read(no_trajectory), _model(model), _max_open(default_max_open)
 		{ cached_first = true; }
 
 		MultiTrajectory(const AtomicGroup& model, const uint skip, const uint stride)
-			: _nframes(0), _skip(skip), _stride(stride), _curtraj(0), _curframe(0), _model(model)
+			: _nframes(0), _skip(skip), _stride(stride), _curtraj(0), _curframe(0), _last_read(no_trajectory), _model(model), _max_open(default_max_open)
 		{ cached_first = true; }
 
 
 		//! Instantiate a new MultiTrajectory using the passed filenames
 		MultiTrajectory(const std::vector<std::string>& filenames,
 						const AtomicGroup& model)
-			: _nframes(0), _skip(0), _stride(1), _curtraj(0), _curframe(0), _model(model)
+			: _nframes(0), _skip(0), _stride(1), _curtraj(0), _curframe(0), _last_read(no_trajectory), _model(model), _max_open(default_max_open)
 		{
 			cached_first = true;
 			initWithList(filenames, model);
@@ -71,7 +80,7 @@ namespace loos {
 						const AtomicGroup& model,
 						const uint skip,
 						const uint stride)
-			: _nframes(0), _skip(skip), _stride(stride), _curtraj(0), _curframe(skip), _model(model)
+			: _nframes(0), _skip(skip), _stride(stride), _curtraj(0), _curframe(skip), _last_read(no_trajectory), _model(model), _max_open(default_max_open)
 		{
 			cached_first = true;
 			initWithList(filenames, model);
@@ -79,12 +88,7 @@ namespace loos {
 
 
 		//! Add a trajectory (by filename)
-		void addTrajectory(const std::string& filename) {
-			pTraj traj = createTrajectory(filename, _model);
-			_trajectories.push_back(traj);
-			if (traj->nframes() > _skip)
-				_nframes += (traj->nframes() - _skip) / _stride;
-		}
+		void addTrajectory(const std::string& filename);
 
 
 		virtual std::string description() const { return("virtual-trajectory"); }
@@ -96,50 +100,70 @@ namespace loos {
 
 		//! Number of frames in the ith trajectory
 		uint nframes(const uint i) const {
-			if (i >= _trajectories.size())
+			if (i >= _filenames.size())
 				throw(LOOSError("Requesting trajectory size for non-existent trajectory in MultiTraj"));
 
-			if (_trajectories[i]->nframes() <= _skip)
+			if (_sizes[i] <= _skip)
 				return 0;
-			return( (_trajectories[i]->nframes() - _skip + _stride - 1) / _stride );
+			return( (_sizes[i] - _skip + _stride - 1) / _stride );
 		}
 
 		//! Number of trajectories contained
-		uint size() const { return(_trajectories.size()); }
+		uint size() const { return(_filenames.size()); }
 
 		//! Access the individual trajectories
+		/**
+		 * The trajectory will be opened if it is not already open,
+		 * which may close another one.
+		 */
 		pTraj operator[](const uint i) const {
-			if (i >= _trajectories.size())
+			if (i >= _filenames.size())
+				throw(LOOSError("MultiTraj trajectory index out of bounds"));
+			return(trajectory(i));
+		}
+
+		//! Filename of the ith trajectory (does not open the trajectory)
+		std::string trajectoryFilename(const uint i) const {
+			if (i >= _filenames.size())
 				throw(LOOSError("MultiTraj trajectory index out of bounds"));
-			return(_trajectories[i]);
+			return(_filenames[i]);
 		}
 
+		//! Number of frames in the ith trajectory, without skip & stride (does not open the trajectory)
+		uint trajectoryFrames(const uint i) const {
+			if (i >= _filenames.size())
+				throw(LOOSError("MultiTraj trajectory index out of bounds"));
+			return(_sizes[i]);
+		}
+
+		//! Maximum number of sub-trajectories kept open at once
+		uint maxOpenTrajectories() const { return(_max_open); }
+
+		//! Set the maximum number of sub-trajectories kept open (must be at least 1)
+		void maxOpenTrajectories(const uint n);
+
 		//! Ignore timesteps (for now)
 		virtual float timestep() const { return(0.0); }
 
 		//! Whether or not the current sub-trajectory has a periodic box
 		virtual bool hasPeriodicBox() const {
-			uint i = eof() ? _trajectories.size()-1 : _curtraj;
-			return(_trajectories[i]->hasPeriodicBox());
+			return(trajectory(lastReadIndex())->hasPeriodicBox());
 		}
 
 		//! The periodic box of the current sub-trajectory
 		virtual GCoord periodicBox() const {
-			uint i = eof() ? _trajectories.size()-1 : _curtraj;
-			return(_trajectories[i]->periodicBox());
+			return(trajectory(lastReadIndex())->periodicBox());
 		}
 
 		//! Whether or not the current sub-trajectory has a periodic box
 		virtual bool hasVelocities() const {
-			uint i = eof() ? _trajectories.size()-1 : _curtraj;
-			return(_trajectories[i]->hasVelocities());
+			return(trajectory(lastReadIndex())->hasVelocities());
 		}
 
 
 		//! Coordinates from the most recently read frame
 		virtual std::vector<GCoord> coords() const {
-			uint i = eof() ? _trajectories.size()-1 : _curtraj;
-			return(_trajectories[i]->coords());
+			return(trajectory(lastReadIndex())->coords());
 		}
 
 
@@ -153,9 +177,12 @@ namespace loos {
 		Location frameIndexToLocation(const uint i);
 
 		bool eof() const {
-			return _curtraj >= _trajectories.size();
+			return _curtraj >= _filenames.size();
 		}
 
+		//! Default number of sub-trajectories kept open
+		static const uint default_max_open = 16;
+
 	private:
 
 		virtual void rewindImpl();
@@ -163,10 +190,28 @@ namespace loos {
 		virtual void seekFrameImpl(const uint i);
 		virtual bool parseFrame();
 		virtual void updateGroupCoordsImpl(AtomicGroup& g);
+		virtual void updateArenaCoordsImpl(CoordinateArena& arena);
 		virtual void updateGroupVelocitiesImpl(AtomicGroup& g);
+		virtual void atomSubsetChangedImpl();
 
 		void findNextUsableTraj();
 
+		uint lastTrajectoryIndex() const {
+			return(eof() ? _filenames.size()-1 : _curtraj);
+		}
+
+		// Trajectory the last frame was actually read from.  It is never
+		// closed, so it is still positioned at that frame.
+		uint lastReadIndex() const {
+			return(_last_read == no_trajectory ? lastTrajectoryIndex() : _last_read);
+		}
+
+		static const uint no_trajectory = static_cast<uint>(-1);
+
+		pTraj trajectory(const uint i) const;
+		void touch(const uint i) const;
+		void closeExcessTrajectories() const;
+
 
 		// Make these private so you can't accidently try to use them...
 		MultiTrajectory(const std::string& s) { }
@@ -178,8 +223,17 @@ namespace loos {
 		uint _nframes;
 		uint _skip, _stride;
 		uint _curtraj, _curframe;
+		uint _last_read;
 		AtomicGroup _model;
-		std::vector<pTraj> _trajectories;
+
+		std::vector<std::string> _filenames;
+		std::vector<uint> _sizes;             // Raw frame count for each trajectory
+
+		// Sub-trajectories are opened on demand, and only the most
+		// recently used ones are kept open (null pointers are closed)
+		mutable std::vector<pTraj> _trajectories;
+		mutable std::list<uint> _open;        // Most recently used first
+		uint _max_open;
 
 	};
 
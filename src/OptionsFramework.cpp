@@ -22,6 +22,7 @@
 
 #include <utils_structural.hpp>
 #include <OptionsFramework.hpp>
+#include <xtcwriter.hpp>
 
 #include <boost/lambda/lambda.hpp>
 
@@ -90,6 +91,24 @@ namespace loos {
       return(oss.str());
     }
 
+    // -------------------------------------------------------
+
+    void ThreadOptions::addGeneric(po::options_description& opts) {
+      opts.add_options()
+        ("threads", po::value<uint>(&nthreads)->default_value(nthreads), "Number of threads to use (0=all available)");
+    }
+
+    bool ThreadOptions::postConditions(po::variables_map& map) {
+      ThreadPool::setGlobalThreads(nthreads);
+      return(true);
+    }
+
+    std::string ThreadOptions::print() const {
+      std::ostringstream oss;
+      oss << "threads=" << nthreads;
+      return(oss.str());
+    }
+
     // -------------------------------------------------------
     void BasicSplitBy::addGeneric(po::options_description& opts) {
       opts.add_options()
@@ -358,7 +377,8 @@ namespace loos {
         ("modeltype", po::value<std::string>(&model_type)->default_value(model_type), modeltypes.c_str())
         ("trajtype", po::value<std::string>(&traj_type)->default_value(traj_type), trajtypes.c_str())
         ("stride,i", po::value<unsigned int>(&stride)->default_value(stride), "Take every ith frame")
-        ("range,r", po::value<std::string>(&frame_index_spec), "Which frames to use (matlab style range, overrides stride and skip)");
+        ("range,r", po::value<std::string>(&frame_index_spec), "Which frames to use (matlab style range, overrides stride and skip)")
+        ("prefetch", po::value<unsigned int>(&prefetch)->default_value(prefetch), "Read up to this many frames ahead in the background (0 = off)");
     };
 
     void TrajectoryWithFrameIndices::addHidden(po::options_description& opts) {
@@ -392,6 +412,9 @@ namespace loos {
       else
         trajectory = createTrajectory(traj_name, traj_type, model);
 
+      if (prefetch > 0)
+        trajectory = pTraj(new PrefetchTrajectory(trajectory, frameList(), prefetch));
+
       return(true);
     }
 
@@ -403,6 +426,8 @@ namespace loos {
         oss << ", skip=" << skip;
       else if (!frame_index_spec.empty())
         oss << ", range='" << frame_index_spec << "'";
+      if (prefetch > 0)
+        oss << ", prefetch=" << prefetch;
 
       return(oss.str());
     }
@@ -423,7 +448,8 @@ namespace loos {
         ("modeltype", po::value<std::string>(), modeltypes.c_str())
         ("skip,k", po::value<uint>(&skip)->default_value(skip), "Number of frames to skip in sub-trajectories")
         ("stride,i", po::value<uint>(&stride)->default_value(stride), "Step through sub-trajectories by this amount")
-        ("range,r", po::value<std::string>(&frame_index_spec), "Which frames to use in composite trajectory");
+        ("range,r", po::value<std::string>(&frame_index_spec), "Which frames to use in composite trajectory")
+        ("prefetch", po::value<uint>(&prefetch)->default_value(prefetch), "Read up to this many frames ahead in the background (0 = off)");
     }
 
     void MultiTrajOptions::addHidden(po::options_description& opts) {
@@ -451,6 +477,11 @@ namespace loos {
       mtraj = MultiTrajectory(traj_names, model, skip, stride);
       trajectory = pTraj(&mtraj, boost::lambda::_1);
 
+      // Only the composite trajectory is prefetched, so mtraj may still
+      // be queried for information about the sub-trajectories
+      if (prefetch > 0)
+        trajectory = pTraj(new PrefetchTrajectory(trajectory, frameList(), prefetch));
+
       return true;
     }
 
@@ -468,6 +499,8 @@ namespace loos {
       for (uint i=0; i<traj_names.size(); ++i)
         oss << "'" << traj_names[i] << "'" << (i < traj_names.size()-1 ? "," : "");
       oss << ")";
+      if (prefetch > 0)
+        oss << ", prefetch=" << prefetch;
       return oss.str();
     }
 
@@ -482,13 +515,13 @@ namespace loos {
       for (uint i=0; i<mtraj.size(); ++i) {
         uint n = mtraj.nframes(i);
         if (n == 0)
-          oss << boost::format("# Warning- '%s' was skipped due to insufficient frames\n") % mtraj[i]->filename();
+          oss << boost::format("# Warning- '%s' was skipped due to insufficient frames\n") % mtraj.trajectoryFilename(i);
         else {
           oss << boost::format("# %d\t%d\t%d\t%s\n")
             % j
             % start_cnt
             % (start_cnt + n - 1)
-            % mtraj[i]->filename();
+            % mtraj.trajectoryFilename(i);
           ++j;
         }
         start_cnt += n;
@@ -504,7 +537,8 @@ namespace loos {
 
       opts.add_options()
 	("outtrajtype,t", po::value<std::string>(&type), types.c_str())
-	("append", po::value<bool>(&append)->default_value(append), "Append if trajectory exists, otherwise overwrite");
+	("append", po::value<bool>(&append)->default_value(append), "Append if trajectory exists, otherwise overwrite")
+	("xtc-threads", po::value<uint>(&xtc_threads)->default_value(xtc_threads), "Threads used to compress XTC output (0 = serial)");
     }
 
     void OutputTrajectoryOptions::addHidden(po::options_description& opts) {
@@ -528,6 +562,11 @@ namespace loos {
 	type = boost::get<1>(names);
 
       outraj = createOutputTrajectory(name, type, append);
+      if (xtc_threads > 0) {
+        XTCWriter* xtc = dynamic_cast<XTCWriter*>(outraj.get());
+        if (xtc)
+          xtc->compressionThreads(xtc_threads);
+      }
       return(true);
     }
 
@@ -542,6 +581,8 @@ namespace loos {
 	% name
 	% type
 	% append;
+      if (xtc_threads > 0)
+        oss << ",xtc_threads=" << xtc_threads;
       return(oss.str());
     }
 
@@ -552,7 +593,8 @@ namespace loos {
 
       opts.add_options()
 	("outtrajtype,t", po::value<std::string>(&type)->default_value("dcd"), types.c_str())
-	("append", po::value<bool>(&append)->default_value(append), "Append if trajectory exists, otherwise overwrite");
+	("append", po::value<bool>(&append)->default_value(append), "Append if trajectory exists, otherwise overwrite")
+	("xtc-threads", po::value<uint>(&xtc_threads)->default_value(xtc_threads), "Threads used to compress XTC output (0 = serial)");
     }
 
 
@@ -561,6 +603,8 @@ namespace loos {
       oss << boost::format("outraj_type='%s',append=%d")
 	% type
 	% append;
+      if (xtc_threads > 0)
+        oss << ",xtc_threads=" << xtc_threads;
       return(oss.str());
     }
 
@@ -568,7 +612,13 @@ namespace loos {
     pTrajectoryWriter OutputTrajectoryTypeOptions::createTrajectory(const std::string& prefix) {
 
       std::string fname = prefix + "." + type;
-      return(createOutputTrajectory(fname, type, append));
+      pTrajectoryWriter traj = createOutputTrajectory(fname, type, append);
+      if (xtc_threads > 0) {
+        XTCWriter* xtc = dynamic_cast<XTCWriter*>(traj.get());
+        if (xtc)
+          xtc->compressionThreads(xtc_threads);
+      }
+      return(traj);
     }
 
     // -------------------------------------------------------
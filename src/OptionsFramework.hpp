@@ -29,6 +29,8 @@
 #include <AtomicGroup.hpp>
 #include <Trajectory.hpp>
 #include <MultiTraj.hpp>
+#include <PrefetchTraj.hpp>
+#include <ThreadPool.hpp>
 #include <sfactories.hpp>
 #include <boost/algorithm/string.hpp>
 #include <exceptions.hpp>
@@ -381,6 +383,26 @@ namespace loos {
     };
 
 
+    // -------------------------------------------------
+
+    //! Number of threads to use (--threads)
+    /**
+     * Sizes the shared ThreadPool (see ThreadPool::global()) once the
+     * options are parsed.  A value of 0 uses all available cores.
+     */
+    class ThreadOptions : public OptionsPackage {
+    public:
+      ThreadOptions() : nthreads(1) { }
+      explicit ThreadOptions(const uint n) : nthreads(n) { }
+
+      uint nthreads;
+
+    private:
+      void addGeneric(po::options_description& opts);
+      bool postConditions(po::variables_map& map);
+      std::string print() const;
+    };
+
     // -------------------------------------------------
 
     //! Provides a mechanism for controlling how to split an AtomicGroup
@@ -536,12 +558,13 @@ namespace loos {
      **/
     class TrajectoryWithFrameIndices : public OptionsPackage {
     public:
-      TrajectoryWithFrameIndices() : skip(0), stride(1), frame_index_spec("") { }
+      TrajectoryWithFrameIndices() : skip(0), stride(1), prefetch(0), frame_index_spec("") { }
 
       //! Returns the list of frames the user requested
       std::vector<uint> frameList() const;
 
       unsigned int skip, stride;
+      unsigned int prefetch;
       std::string frame_index_spec;
       std::string model_name, model_type, traj_name, traj_type;
 
@@ -588,11 +611,12 @@ namespace loos {
      **/
     class MultiTrajOptions : public OptionsPackage {
     public:
-      MultiTrajOptions() : skip(0), stride(1) { }
+      MultiTrajOptions() : skip(0), stride(1), prefetch(0) { }
 
 
       uint skip;
       uint stride;
+      uint prefetch;
       std::vector< std::string > traj_names;
       std::string model_name, model_type, frame_index_spec;
 
@@ -717,14 +741,15 @@ namespace loos {
     // ----------------------------------------------------------------------
     class OutputTrajectoryOptions : public OptionsPackage {
     public:
-      OutputTrajectoryOptions() : name("output.dcd"), label("Output Trajectory"), append(false) {}
-      OutputTrajectoryOptions(const std::string& s) : name(s), label("Output Trajectory"), append(false) {}
-      OutputTrajectoryOptions(const std::string& s, const bool appending) : name(s), label("Output Trajectory"), append(appending) {}
+      OutputTrajectoryOptions() : name("output.dcd"), label("Output Trajectory"), append(false), xtc_threads(0) {}
+      OutputTrajectoryOptions(const std::string& s) : name(s), label("Output Trajectory"), append(false), xtc_threads(0) {}
+      OutputTrajectoryOptions(const std::string& s, const bool appending) : name(s), label("Output Trajectory"), append(appending), xtc_threads(0) {}
 
 
       std::string name;
       std::string label;
       bool append;
+      uint xtc_threads;
       std::string type;
       std::string basename;
       pTrajectoryWriter outraj;
@@ -752,22 +777,25 @@ namespace loos {
       OutputTrajectoryTypeOptions() :
 	label("Output Trajectory Type"),
 	append(false),
+	xtc_threads(0),
 	type("dcd") {}
 
       OutputTrajectoryTypeOptions(const std::string& s) :
 	label("Output Trajectory Type"),
 	append(false),
+	xtc_threads(0),
 	type(s) {}
 
       OutputTrajectoryTypeOptions(const std::string& s, const bool appending) :
 	label("Output Trajectory Type"),
-	append(appending), type(s) {}
+	append(appending), xtc_threads(0), type(s) {}
 
       pTrajectoryWriter createTrajectory(const std::string& prefix);
 
 
       std::string label;
       bool append;
+      uint xtc_threads;
       std::string type;
 
     private:
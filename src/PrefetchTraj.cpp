@@ -0,0 +1,275 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <PrefetchTraj.hpp>
+
+#include <sstream>
+
+
+namespace loos {
+
+
+	PrefetchTrajectory::PrefetchTrajectory(const pTraj& traj, const uint depth)
+		: _traj(traj), _depth(depth), _stop(false), _done(false), _worker_position(0), _thread(0)
+	{
+		for (uint i=0; i<traj->nframes(); ++i)
+			_schedule.push_back(i);
+		init();
+	}
+
+
+	PrefetchTrajectory::PrefetchTrajectory(const pTraj& traj, const std::vector<uint>& frames, const uint depth)
+		: _traj(traj), _schedule(frames), _depth(depth), _stop(false), _done(false), _worker_position(0), _thread(0)
+	{
+		init();
+	}
+
+
+	PrefetchTrajectory::~PrefetchTrajectory() {
+		stopWorker();
+	}
+
+
+	void PrefetchTrajectory::init() {
+		if (_depth == 0)
+			_depth = 1;
+
+		_filename = _traj->filename();
+		_natoms = _traj->natoms();
+		_nframes = _traj->nframes();
+		_timestep = _traj->timestep();
+		_has_velocities = _traj->hasVelocities();
+		_velocity_conversion = _traj->velocityConversionFactor();
+
+		// Cache the first frame, per the Trajectory requirements...
+		if (_nframes > 0)
+			fetchFrame(0, _current);
+		cached_first = true;
+		_next_position = (!_schedule.empty() && _schedule[0] == 0) ? 1 : 0;
+
+		_atom_subset = _traj->atomSubset();
+	}
+
+
+	// Reads a frame from the wrapped trajectory.  This is used both by
+	// the worker thread and for synchronous reads (when the worker is
+	// not running).
+	void PrefetchTrajectory::fetchFrame(const uint index, Frame& frame) {
+		if (!_traj->readFrame(index)) {
+			std::ostringstream oss;
+			oss << "Unable to read frame " << index << " from " << _traj->filename();
+			throw(FileReadError(_traj->filename(), oss.str()));
+		}
+
+		frame.index = index;
+		frame.has_box = _traj->hasPeriodicBox();
+		if (frame.has_box)
+			frame.box = _traj->periodicBox();
+
+		std::vector<GCoord> crds = _traj->coords();
+		frame.coords.swap(crds);
+
+		if (_has_velocities) {
+			std::vector<GCoord> vels = _traj->velocities();
+			frame.velocities.swap(vels);
+		}
+	}
+
+
+	void PrefetchTrajectory::worker() {
+		while (true) {
+			uint position;
+			{
+				boost::unique_lock<boost::mutex> lock(_mutex);
+				while (!_stop && _buffer.size() >= _depth)
+					_cond.wait(lock);
+				if (_stop)
+					return;
+				if (_worker_position >= _schedule.size()) {
+					_done = true;
+					_cond.notify_all();
+					return;
+				}
+				position = _worker_position++;
+			}
+
+			Frame frame;
+			frame.position = position;
+			try {
+				fetchFrame(_schedule[position], frame);
+			}
+			catch (std::exception& e) {
+				boost::unique_lock<boost::mutex> lock(_mutex);
+				_error = e.what();
+				_done = true;
+				_cond.notify_all();
+				return;
+			}
+			catch (...) {
+				boost::unique_lock<boost::mutex> lock(_mutex);
+				_error = "Unknown error while prefetching frames";
+				_done = true;
+				_cond.notify_all();
+				return;
+			}
+
+			boost::unique_lock<boost::mutex> lock(_mutex);
+			_buffer.push_back(Frame());
+			_buffer.back().swap(frame);
+			_cond.notify_all();
+		}
+	}
+
+
+	void PrefetchTrajectory::startWorker(const uint position) {
+		stopWorker();
+		_worker_position = position;
+		_thread = new boost::thread(boost::bind(&PrefetchTrajectory::worker, this));
+	}
+
+
+	void PrefetchTrajectory::stopWorker() {
+		if (_thread) {
+			{
+				boost::unique_lock<boost::mutex> lock(_mutex);
+				_stop = true;
+				_cond.notify_all();
+			}
+			_thread->join();
+			delete _thread;
+			_thread = 0;
+		}
+
+		_buffer.clear();
+		_stop = _done = false;
+		_error.clear();
+	}
+
+
+	// Searches for a frame in the schedule, starting from where we
+	// currently are and wrapping around (so a new pass through the
+	// frames will be found)
+	bool PrefetchTrajectory::findInSchedule(const uint index, uint& position) const {
+		uint n = _schedule.size();
+		for (uint j=0; j<n; ++j) {
+			uint k = (_next_position + j) % n;
+			if (_schedule[k] == index) {
+				position = k;
+				return(true);
+			}
+		}
+		return(false);
+	}
+
+
+	// The frame to read is tracked by the base class, so the seek
+	// functions are no-ops and the requested frame is taken from
+	// currentFrame() here.
+	bool PrefetchTrajectory::parseFrame() {
+		uint target = currentFrame();
+		if (target >= _nframes)
+			return(false);
+
+		bool restarted = false;
+		while (true) {
+			std::string error;
+			{
+				boost::unique_lock<boost::mutex> lock(_mutex);
+				while (_buffer.empty() && _thread != 0 && !_done)
+					_cond.wait(lock);
+
+				if (!_buffer.empty() && _buffer.front().index == target) {
+					_current.swap(_buffer.front());
+					_buffer.pop_front();
+					_next_position = _current.position + 1;
+					_cond.notify_all();
+					return(true);
+				}
+
+				// The worker failed while reading the frame we want...
+				if (_buffer.empty() && _done && !_error.empty()
+					&& _worker_position > 0 && _schedule[_worker_position-1] == target)
+					error = _error;
+			}
+
+			if (!error.empty()) {
+				stopWorker();
+				throw(LOOSError(error));
+			}
+
+			// Requested frame is not coming from the worker, so reposition it
+			uint position;
+			if (!restarted && findInSchedule(target, position)) {
+				startWorker(position);
+				restarted = true;
+				continue;
+			}
+
+			// Frame is not in the schedule, so just read it directly
+			stopWorker();
+			fetchFrame(target, _current);
+			return(true);
+		}
+	}
+
+
+	void PrefetchTrajectory::rewindImpl() {
+		stopWorker();
+		_next_position = 0;
+	}
+
+
+	void PrefetchTrajectory::atomSubsetChangedImpl() {
+		stopWorker();
+		if (_atom_subset.empty())
+			_traj->clearAtomSubset();
+		else
+			_traj->setAtomSubset(_atom_subset);
+	}
+
+
+	void PrefetchTrajectory::updateGroupCoordsImpl(AtomicGroup& g) {
+		for (AtomicGroup::iterator i = g.begin(); i != g.end(); ++i) {
+			uint idx = (*i)->index();
+			if (idx >= _current.coords.size())
+				throw(LOOSError(**i, "Atom index into trajectory frame is out of bounds"));
+			(*i)->coords(_current.coords[idx]);
+		}
+
+		if (_current.has_box)
+			g.periodicBox(_current.box);
+	}
+
+
+	void PrefetchTrajectory::updateGroupVelocitiesImpl(AtomicGroup& g) {
+		for (AtomicGroup::iterator i = g.begin(); i != g.end(); ++i) {
+			uint idx = (*i)->index();
+			if (idx >= _current.velocities.size())
+				throw(LOOSError(**i, "Atom index into trajectory frame is out of bounds"));
+			(*i)->velocities(_current.velocities[idx]);
+		}
+
+		if (_current.has_box)
+			g.periodicBox(_current.box);
+	}
+
+}
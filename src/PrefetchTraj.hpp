@@ -0,0 +1,162 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if !defined(LOOS_PREFETCHTRAJ_HPP)
+#define LOOS_PREFETCHTRAJ_HPP
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <loos_defs.hpp>
+#include <AtomicGroup.hpp>
+#include <Trajectory.hpp>
+
+
+namespace loos {
+
+	//! Reads frames from another trajectory ahead of time on a background thread
+	/**
+	 * This class wraps any pTraj (e.g. one returned by
+	 * createTrajectory(), or a MultiTrajectory) and reads frames from
+	 * it on a separate thread while the caller is busy with the
+	 * current frame.  Up to \a depth decoded frames are kept in a
+	 * buffer.  Frames are read in the order given by the frame list
+	 * passed at construction (e.g. from
+	 * TrajectoryWithFrameIndices::frameList()), or sequentially if no
+	 * list is given.
+	 *
+	 * Reading frames out of order is allowed, but will stall while the
+	 * background reader is repositioned.  If the requested frame is
+	 * part of the frame list, prefetching resumes from that point in
+	 * the list (so repeated passes over the same list are
+	 * prefetched).
+	 *
+	 * The wrapped trajectory must not be used directly while it is
+	 * owned by a PrefetchTrajectory.  The background thread is not
+	 * started until the first frame is requested.
+	 */
+	class PrefetchTrajectory : public Trajectory {
+
+		// A fully decoded frame, along with its position in the frame list
+		struct Frame {
+			uint index;
+			uint position;
+			bool has_box;
+			GCoord box;
+			std::vector<GCoord> coords;
+			std::vector<GCoord> velocities;
+
+			void swap(Frame& f) {
+				std::swap(index, f.index);
+				std::swap(position, f.position);
+				std::swap(has_box, f.has_box);
+				std::swap(box, f.box);
+				coords.swap(f.coords);
+				velocities.swap(f.velocities);
+			}
+		};
+
+	public:
+		//! Prefetch frames of \a traj sequentially, buffering up to \a depth frames
+		PrefetchTrajectory(const pTraj& traj, const uint depth = 4);
+
+		//! Prefetch the frames of \a traj listed in \a frames, buffering up to \a depth frames
+		PrefetchTrajectory(const pTraj& traj, const std::vector<uint>& frames, const uint depth = 4);
+
+		~PrefetchTrajectory();
+
+		virtual std::string description() const { return(_traj->description() + " (prefetched)"); }
+		virtual std::string filename() const { return(_traj->filename()); }
+
+		virtual uint natoms() const { return(_natoms); }
+		virtual float timestep() const { return(_timestep); }
+		virtual uint nframes() const { return(_nframes); }
+
+		virtual bool hasPeriodicBox() const { return(_current.has_box); }
+		virtual GCoord periodicBox() const { return(_current.box); }
+
+		virtual bool hasVelocities() const { return(_has_velocities); }
+		virtual double velocityConversionFactor() const { return(_velocity_conversion); }
+
+		virtual std::vector<GCoord> coords() const { return(_current.coords); }
+
+		//! The wrapped trajectory
+		pTraj trajectory() const { return(_traj); }
+
+		//! Number of frames that will be buffered
+		uint depth() const { return(_depth); }
+
+	private:
+		// Not copyable, since there is a thread attached...
+		PrefetchTrajectory(const PrefetchTrajectory&);
+		PrefetchTrajectory& operator=(const PrefetchTrajectory&);
+
+		void init();
+
+		virtual void rewindImpl();
+		virtual void seekNextFrameImpl() { }
+		virtual void seekFrameImpl(const uint) { }
+		virtual bool parseFrame();
+		virtual void updateGroupCoordsImpl(AtomicGroup& g);
+		virtual void updateArenaCoordsImpl(CoordinateArena& arena) { arena.coords(_current.coords); }
+		virtual void updateGroupVelocitiesImpl(AtomicGroup& g);
+		virtual std::vector<GCoord> velocitiesImpl() const { return(_current.velocities); }
+		virtual void atomSubsetChangedImpl();
+
+		void startWorker(const uint position);
+		void stopWorker();
+		void worker();
+		void fetchFrame(const uint index, Frame& frame);
+		bool findInSchedule(const uint index, uint& position) const;
+
+	private:
+		pTraj _traj;
+		std::vector<uint> _schedule;
+		uint _depth;
+
+		uint _natoms, _nframes;
+		float _timestep;
+		bool _has_velocities;
+		double _velocity_conversion;
+
+		Frame _current;
+		uint _next_position;    // Position in schedule following the current frame
+
+		// Shared with the worker thread (guarded by _mutex)
+		boost::mutex _mutex;
+		boost::condition_variable _cond;
+		std::deque<Frame> _buffer;
+		bool _stop, _done;
+		std::string _error;
+		uint _worker_position;
+		boost::thread* _thread;
+	};
+
+}
+
+
+#endif
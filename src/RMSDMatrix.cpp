@@ -0,0 +1,656 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <RMSDMatrix.hpp>
+#include <AtomicGroup.hpp>
+#include <Trajectory.hpp>
+#include <CoordinateArena.hpp>
+#include <alignment.hpp>
+#include <ThreadPool.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <cmath>
+#include <iostream>
+
+#include <boost/cstdint.hpp>
+#include <boost/format.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+namespace loos {
+
+  const uint RMSDFrames::lanes;
+
+
+  RMSDFrames::RMSDFrames(const AtomicGroup& subset, pTraj& traj, const std::vector<uint>& indices,
+                         const ulong budget)
+    : _nframes(indices.size()),
+      _natoms(subset.size()),
+      _stride(paddedStride(subset.size())),
+      _buffer(indices.size(), paddedStride(subset.size()), budget),
+      _sumsq(indices.size())
+  {
+    CoordinateArena arena(subset);
+    CoordinateArena::Indices idx = arena.indices(subset);
+    std::vector<double> xyz(3 * _natoms);
+
+    for (uint i=0; i<_nframes; ++i) {
+      traj->readFrame(indices[i]);
+      traj->updateArenaCoords(arena);
+      for (uint j=0; j<_natoms; ++j) {
+        uint k = idx[j];
+        xyz[3*j] = arena.x()[k];
+        xyz[3*j+1] = arena.y()[k];
+        xyz[3*j+2] = arena.z()[k];
+      }
+      store(i, &xyz[0]);
+    }
+  }
+
+
+  RMSDFrames::RMSDFrames(const std::vector< std::vector<double> >& frames, const ulong budget)
+    : _nframes(frames.size()),
+      _natoms(frames.empty() ? 0 : frames[0].size() / 3),
+      _stride(paddedStride(_natoms)),
+      _buffer(frames.size(), paddedStride(_natoms), budget),
+      _sumsq(frames.size())
+  {
+    for (uint i=0; i<_nframes; ++i) {
+      if (frames[i].size() != 3 * _natoms)
+        throw(LOOSError("Frames passed to RMSDFrames must all be the same size"));
+      store(i, &(frames[i][0]));
+    }
+  }
+
+
+  // Centering is done in double precision before converting to float
+  void RMSDFrames::store(const uint i, const double* xyz) {
+    double c[3] = {0.0, 0.0, 0.0};
+    for (uint j=0; j<_natoms; ++j)
+      for (uint k=0; k<3; ++k)
+        c[k] += xyz[3*j+k];
+    for (uint k=0; k<3; ++k)
+      c[k] /= _natoms;
+
+    float* p = _buffer.frame(i);
+    std::fill(p, p + 3 * _stride, 0.0f);
+
+    double ss = 0.0;
+    for (uint j=0; j<_natoms; ++j)
+      for (uint k=0; k<3; ++k) {
+        float v = xyz[3*j+k] - c[k];
+        p[k * _stride + j] = v;
+        ss += static_cast<double>(v) * v;
+      }
+
+    _sumsq[i] = ss;
+  }
+
+
+  namespace {
+
+    // Partial sums are kept for this many atoms, then added into
+    // double accumulators so round-off doesn't build up for large
+    // selections
+    const uint chunk_atoms = 256;
+
+    // Target size (in bytes) for the frames in one tile
+    const ulong tile_cache_bytes = 512ul << 10;
+
+
+    // Correlation matrix between frame i of a and frame j of b.  Each
+    // lane sums every lanes'th atom independently, so the inner loop
+    // is vectorized without having to reorder any sums.  R is the
+    // type the products and partial sums are computed in.
+    template<typename R>
+    void innerProduct(const RMSDFrames& a, const uint i, const RMSDFrames& b, const uint j, double* A) {
+      const uint L = RMSDFrames::lanes;
+      const float* ax = a.x(i);
+      const float* ay = a.y(i);
+      const float* az = a.z(i);
+      const float* bx = b.x(j);
+      const float* by = b.y(j);
+      const float* bz = b.z(j);
+      uint n = a.stride();
+
+      for (uint m=0; m<9; ++m)
+        A[m] = 0.0;
+
+      for (uint k0=0; k0<n; k0 += chunk_atoms) {
+        R xx[L], xy[L], xz[L], yx[L], yy[L], yz[L], zx[L], zy[L], zz[L];
+        for (uint l=0; l<L; ++l)
+          xx[l] = xy[l] = xz[l] = yx[l] = yy[l] = yz[l] = zx[l] = zy[l] = zz[l] = 0;
+
+        uint kend = std::min(n, k0 + chunk_atoms);
+        for (uint k=k0; k<kend; k += L)
+          for (uint l=0; l<L; ++l) {
+            R ux = ax[k+l], uy = ay[k+l], uz = az[k+l];
+            R vx = bx[k+l], vy = by[k+l], vz = bz[k+l];
+            xx[l] += ux * vx;  xy[l] += ux * vy;  xz[l] += ux * vz;
+            yx[l] += uy * vx;  yy[l] += uy * vy;  yz[l] += uy * vz;
+            zx[l] += uz * vx;  zy[l] += uz * vy;  zz[l] += uz * vz;
+          }
+
+        for (uint l=0; l<L; ++l) {
+          A[0] += xx[l];  A[1] += xy[l];  A[2] += xz[l];
+          A[3] += yx[l];  A[4] += yy[l];  A[5] += yz[l];
+          A[6] += zx[l];  A[7] += zy[l];  A[8] += zz[l];
+        }
+      }
+    }
+
+
+    // The RMSD comes from the difference between E0 and the largest
+    // eigenvalue, which nearly cancel when the RMSD is small compared
+    // to the size of the structure.  Round-off in the float products
+    // grows roughly as sqrt(n) * eps * E0, so when that would be more
+    // than about 0.1% of the MSD, the pair is redone in double.
+    double pairRMSD(const RMSDFrames& a, const uint i, const RMSDFrames& b, const uint j) {
+      const double float_eps = std::numeric_limits<float>::epsilon();
+      const double tolerance = 2e-3;
+
+      double A[9];
+      uint n = a.natoms();
+      double E0 = (a.sumOfSquares(i) + b.sumOfSquares(j)) / 2.0;
+
+      innerProduct<float>(a, i, b, j, A);
+      double rmsd = alignment::qcpRMSD(A, E0, n);
+
+      double err = 2.0 * std::sqrt(static_cast<double>(n)) * float_eps * E0 / n;
+      if (err > tolerance * rmsd * rmsd) {
+        innerProduct<double>(a, i, b, j, A);
+        rmsd = alignment::qcpRMSD(A, E0, n);
+      }
+
+      return(rmsd);
+    }
+
+
+    struct Tile {
+      Tile() : index(0), row(0), col(0) { }
+      Tile(const ulong k, const uint r, const uint c) : index(k), row(r), col(c) { }
+      ulong index;
+      uint row, col;
+    };
+
+
+    // Tiles in row order (lower triangle, including the diagonal, when symmetric)
+    std::vector<Tile> tileList(const uint nr, const uint nc, const uint size, const bool symmetric) {
+      uint rows = (nr + size - 1) / size;
+      uint cols = (nc + size - 1) / size;
+      std::vector<Tile> tiles;
+      for (uint i=0; i<rows; ++i)
+        for (uint j=0; j<(symmetric ? i+1 : cols); ++j)
+          tiles.push_back(Tile(tiles.size(), i, j));
+      return(tiles);
+    }
+
+
+    // Reports progress as tiles are finished
+    class TileProgress {
+    public:
+      TileProgress(const size_t total, const bool verbose)
+        : _total(total), _done(0), _verbose(verbose), _start(time(0)),
+          _update(std::max(static_cast<size_t>(1), total / 20))
+      { }
+
+      void finished() {
+        if (!_verbose)
+          return;
+        boost::lock_guard<boost::mutex> lock(_mtx);
+        if (++_done % _update == 0)
+          status();
+      }
+
+      void status() const {
+        if (_done == 0)
+          return;
+        time_t dt = time(0) - _start;
+        ulong left = static_cast<ulong>(_total - _done) * dt / _done;
+        std::cerr << boost::format("Tile %6d /%6d, Elapsed = %5d s, Remaining = %02d:%02d:%02d\n")
+          % _done % _total % dt % (left / 3600) % ((left % 3600) / 60) % (left % 60);
+      }
+
+    private:
+      size_t _total;
+      size_t _done;
+      bool _verbose;
+      time_t _start;
+      size_t _update;
+      boost::mutex _mtx;
+    };
+
+
+    // Destinations for finished tiles.  Blocks are row-major, and
+    // diagonal tiles of a symmetric matrix arrive already mirrored.
+    struct MatrixSink {
+      MatrixSink(RealMatrix& r, const bool sym) : R(r), symmetric(sym) { }
+
+      void operator()(const Tile&, const uint row, const uint col, const float* block, const uint nr, const uint nc) {
+        for (uint i=0; i<nr; ++i)
+          for (uint j=0; j<nc; ++j) {
+            R(row + i, col + j) = block[i * nc + j];
+            if (symmetric)
+              R(col + j, row + i) = block[i * nc + j];
+          }
+      }
+
+      RealMatrix& R;
+      bool symmetric;
+    };
+
+
+    struct FileSink {
+      FileSink(RMSDMatrixFile& f) : file(f) { }
+
+      void operator()(const Tile& t, const uint row, const uint col, const float* block, const uint nr, const uint nc) {
+        file.writeTile(t.index, row, col, block, nr, nc);
+      }
+
+      RMSDMatrixFile& file;
+    };
+
+
+    template<class Sink>
+    struct TileWorker {
+      TileWorker(const RMSDFrames& a, const RMSDFrames& b, Sink& k, const std::vector<Tile>& t,
+                 TileProgress& p, const uint s, const bool sym)
+        : A(a), B(b), sink(k), tiles(t), progress(p), size(s), symmetric(sym)
+      { }
+
+      void operator()(const ulong begin, const ulong end) const {
+        std::vector<float> block(static_cast<ulong>(size) * size);
+        for (ulong k=begin; k<end; ++k) {
+          const Tile& t = tiles[k];
+          uint row = t.row * size;
+          uint col = t.col * size;
+          uint nr = std::min(A.nframes(), row + size) - row;
+          uint nc = std::min(B.nframes(), col + size) - col;
+          bool diagonal = symmetric && t.row == t.col;
+
+          for (uint i=0; i<nr; ++i) {
+            float* p = &block[i * nc];
+            if (diagonal) {
+              for (uint j=0; j<i; ++j)
+                p[j] = block[j * nc + i] = pairRMSD(A, row + i, B, col + j);
+              p[i] = 0.0;
+            } else
+              for (uint j=0; j<nc; ++j)
+                p[j] = pairRMSD(A, row + i, B, col + j);
+          }
+
+          sink(t, row, col, &block[0], nr, nc);
+          progress.finished();
+        }
+      }
+
+      const RMSDFrames& A;
+      const RMSDFrames& B;
+      Sink& sink;
+      const std::vector<Tile>& tiles;
+      TileProgress& progress;
+      uint size;
+      bool symmetric;
+    };
+
+
+    // Tiles are handed out one at a time, since they are already
+    // sized to make good use of the cache
+    template<class Sink>
+    void computeTiles(const RMSDFrames& A, const RMSDFrames& B, Sink& sink, const std::vector<Tile>& tiles,
+                      const uint size, const RMSDMatrixOptions& opts, const bool symmetric) {
+      if (tiles.empty())
+        return;
+
+      boost::shared_ptr<ThreadPool> pool = ThreadPool::select(opts.nthreads);
+      TileProgress progress(tiles.size(), opts.verbose);
+      pool->parallelFor(0, tiles.size(), TileWorker<Sink>(A, B, sink, tiles, progress, size, symmetric), 1);
+
+      if (opts.verbose)
+        progress.status();
+    }
+
+
+    RealMatrix computeMatrix(const RMSDFrames& A, const RMSDFrames& B, const RMSDMatrixOptions& opts, const bool symmetric) {
+      if (A.natoms() != B.natoms())
+        throw(LOOSError("Cannot compute RMSDs between frames with different numbers of atoms"));
+
+      RealMatrix R(A.nframes(), B.nframes());
+      uint size = opts.tile ? opts.tile : rmsdTileSize(A);
+      MatrixSink sink(R, symmetric);
+      computeTiles(A, B, sink, tileList(A.nframes(), B.nframes(), size, symmetric), size, opts, symmetric);
+
+      return(R);
+    }
+
+
+    void computeFile(const RMSDFrames& A, const RMSDFrames& B, RMSDMatrixFile& out, const RMSDMatrixOptions& opts, const bool symmetric) {
+      if (A.natoms() != B.natoms())
+        throw(LOOSError("Cannot compute RMSDs between frames with different numbers of atoms"));
+      if (out.rows() != A.nframes() || out.cols() != B.nframes() || out.symmetric() != symmetric)
+        throw(LOOSError("RMSD matrix file does not match the frames being compared"));
+
+      std::vector<Tile> tiles = tileList(A.nframes(), B.nframes(), out.tileSize(), symmetric);
+      std::vector<Tile> todo;
+      for (std::vector<Tile>::const_iterator i = tiles.begin(); i != tiles.end(); ++i)
+        if (!out.tileDone(i->index))
+          todo.push_back(*i);
+
+      if (opts.verbose && todo.size() < tiles.size())
+        std::cerr << boost::format("Resuming with %d of %d tiles already done\n") % (tiles.size() - todo.size()) % tiles.size();
+
+      FileSink sink(out);
+      computeTiles(A, B, sink, todo, out.tileSize(), opts, symmetric);
+      out.checkpoint();
+    }
+
+
+    // On-disk layout of an RMSDMatrixFile.  The per-tile done flags
+    // follow the header, and the matrix data starts at the next
+    // multiple of matrix_alignment.
+    struct MatrixFileHeader {
+      char magic[8];
+      boost::uint32_t version;
+      boost::uint32_t rows, cols, tile;
+      boost::uint32_t symmetric;
+      boost::uint32_t pad;
+      boost::uint64_t ntiles;
+    };
+
+    const char matrix_magic[8] = { 'L', 'O', 'O', 'S', 'R', 'M', 'S', 'D' };
+    const boost::uint32_t matrix_version = 1;
+    const ulong matrix_flags_offset = 64;
+    const ulong matrix_alignment = 4096;
+
+    // Seconds between automatic checkpoints
+    const time_t checkpoint_interval = 30;
+
+
+    void preadAll(const int fd, const std::string& fname, void* buf, const ulong n, const ulong offset) {
+      char* p = static_cast<char*>(buf);
+      ulong done = 0;
+      while (done < n) {
+        ssize_t k = pread(fd, p + done, n - done, offset + done);
+        if (k <= 0)
+          throw(FileReadError(fname, k == 0 ? std::string("Unexpected end of file") : strerror(errno)));
+        done += k;
+      }
+    }
+
+
+    void pwriteAll(const int fd, const std::string& fname, const void* buf, const ulong n, const ulong offset) {
+      const char* p = static_cast<const char*>(buf);
+      ulong done = 0;
+      while (done < n) {
+        ssize_t k = pwrite(fd, p + done, n - done, offset + done);
+        if (k < 0)
+          throw(FileWriteError(fname, strerror(errno)));
+        done += k;
+      }
+    }
+
+
+    MatrixFileHeader readHeader(const int fd, const std::string& fname) {
+      MatrixFileHeader h;
+      preadAll(fd, fname, &h, sizeof(h), 0);
+      if (memcmp(h.magic, matrix_magic, sizeof(matrix_magic)) != 0)
+        throw(FileReadError(fname, "Not an RMSD matrix file"));
+      if (h.version != matrix_version)
+        throw(FileReadError(fname, "Unsupported RMSD matrix file version"));
+      return(h);
+    }
+
+  }
+
+
+  RealMatrix allToAllRMSD(const RMSDFrames& frames, const RMSDMatrixOptions& opts) {
+    return(computeMatrix(frames, frames, opts, true));
+  }
+
+
+  RealMatrix allToAllRMSD(const RMSDFrames& A, const RMSDFrames& B, const RMSDMatrixOptions& opts) {
+    return(computeMatrix(A, B, opts, false));
+  }
+
+
+  void allToAllRMSD(const RMSDFrames& frames, RMSDMatrixFile& out, const RMSDMatrixOptions& opts) {
+    computeFile(frames, frames, out, opts, true);
+  }
+
+
+  void allToAllRMSD(const RMSDFrames& A, const RMSDFrames& B, RMSDMatrixFile& out, const RMSDMatrixOptions& opts) {
+    computeFile(A, B, out, opts, false);
+  }
+
+
+  uint rmsdTileSize(const RMSDFrames& frames) {
+    ulong frame_bytes = 3ul * frames.stride() * sizeof(float);
+    return(std::max(1ul, tile_cache_bytes / (2 * frame_bytes)));
+  }
+
+
+  // --- RMSDMatrixFile
+
+
+  RMSDMatrixFile::RMSDMatrixFile(const std::string& fname, const uint rows, const uint cols, const bool symmetric,
+                                 const uint tile, const bool resume, const bool mapped)
+    : _fname(fname), _fd(-1), _rows(rows), _cols(cols), _tile(tile),
+      _symmetric(symmetric), _mapped(mapped), _map(0), _map_size(0),
+      _last_checkpoint(time(0))
+  {
+    if (symmetric && rows != cols)
+      throw(LOOSError("A symmetric RMSD matrix must be square"));
+    if (tile == 0)
+      throw(LOOSError("RMSD matrix tile size must be positive"));
+
+    if (resume && access(fname.c_str(), F_OK) == 0)
+      reopen();
+    else
+      create(tile);
+
+    if (_mapped) {
+      _map_size = dataOffset() + static_cast<ulong>(_rows) * _cols * sizeof(float);
+      void* p = mmap(0, _map_size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+      if (p == MAP_FAILED) {
+        int err = errno;
+        ::close(_fd);
+        throw(FileOpenError(_fname, std::string("Cannot memory-map RMSD matrix file: ") + strerror(err), err));
+      }
+      _map = static_cast<char*>(p);
+    }
+  }
+
+
+  RMSDMatrixFile::~RMSDMatrixFile() {
+    try {
+      checkpoint();
+    }
+    catch (...) { }
+
+    if (_map)
+      munmap(_map, _map_size);
+    ::close(_fd);
+  }
+
+
+  void RMSDMatrixFile::create(const uint tile) {
+    _fd = open(_fname.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (_fd < 0)
+      throw(FileOpenError(_fname, strerror(errno), errno));
+
+    _tile = tile;
+    ulong ntiles = tileList(_rows, _cols, _tile, _symmetric).size();
+    _done.assign(ntiles, 0);
+
+    MatrixFileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, matrix_magic, sizeof(matrix_magic));
+    h.version = matrix_version;
+    h.rows = _rows;
+    h.cols = _cols;
+    h.tile = _tile;
+    h.symmetric = _symmetric;
+    h.ntiles = ntiles;
+    pwriteAll(_fd, _fname, &h, sizeof(h), 0);
+
+    // The data region is left as a hole until tiles are written
+    if (ftruncate(_fd, dataOffset() + static_cast<ulong>(_rows) * _cols * sizeof(float)) != 0) {
+      int err = errno;
+      ::close(_fd);
+      throw(FileOpenError(_fname, std::string("Cannot size RMSD matrix file: ") + strerror(err), err));
+    }
+  }
+
+
+  void RMSDMatrixFile::reopen() {
+    _fd = open(_fname.c_str(), O_RDWR);
+    if (_fd < 0)
+      throw(FileOpenError(_fname, strerror(errno), errno));
+
+    MatrixFileHeader h = readHeader(_fd, _fname);
+    if (h.rows != _rows || h.cols != _cols || (h.symmetric != 0) != _symmetric) {
+      ::close(_fd);
+      throw(FileOpenError(_fname, "Cannot resume: RMSD matrix file was written for a different set of frames"));
+    }
+
+    _tile = h.tile;
+    if (h.ntiles != tileList(_rows, _cols, _tile, _symmetric).size()) {
+      ::close(_fd);
+      throw(FileOpenError(_fname, "Cannot resume: RMSD matrix file is corrupt"));
+    }
+
+    _done.resize(h.ntiles);
+    if (!_done.empty())
+      preadAll(_fd, _fname, &_done[0], _done.size(), matrix_flags_offset);
+  }
+
+
+  ulong RMSDMatrixFile::dataOffset() const {
+    return((matrix_flags_offset + _done.size() + matrix_alignment - 1) / matrix_alignment * matrix_alignment);
+  }
+
+
+  ulong RMSDMatrixFile::tilesDone() const {
+    return(std::count(_done.begin(), _done.end(), 1));
+  }
+
+
+  void RMSDMatrixFile::writeBlock(const uint row, const uint col, const float* data, const uint nr, const uint nc, const uint ld) {
+    ulong base = dataOffset();
+    for (uint i=0; i<nr; ++i) {
+      ulong offset = base + (static_cast<ulong>(row + i) * _cols + col) * sizeof(float);
+      if (_map)
+        memcpy(_map + offset, data + i * ld, nc * sizeof(float));
+      else
+        pwriteAll(_fd, _fname, data + i * ld, nc * sizeof(float), offset);
+    }
+  }
+
+
+  void RMSDMatrixFile::writeTile(const ulong k, const uint row, const uint col, const float* data, const uint nr, const uint nc) {
+    writeBlock(row, col, data, nr, nc, nc);
+
+    if (_symmetric && row != col) {
+      std::vector<float> transposed(static_cast<ulong>(nr) * nc);
+      for (uint i=0; i<nr; ++i)
+        for (uint j=0; j<nc; ++j)
+          transposed[j * nr + i] = data[i * nc + j];
+      writeBlock(col, row, &transposed[0], nc, nr, nr);
+    }
+
+    boost::lock_guard<boost::mutex> lock(_mtx);
+    _pending.push_back(k);
+    if (time(0) - _last_checkpoint >= checkpoint_interval)
+      checkpointLocked();
+  }
+
+
+  void RMSDMatrixFile::checkpoint() {
+    boost::lock_guard<boost::mutex> lock(_mtx);
+    checkpointLocked();
+  }
+
+
+  // Tiles are only marked done once their data is on disk, so a
+  // crash can lose work but never leave a tile flagged with no data.
+  void RMSDMatrixFile::checkpointLocked() {
+    _last_checkpoint = time(0);
+    if (_pending.empty())
+      return;
+
+    if (_map ? msync(_map, _map_size, MS_SYNC) : fdatasync(_fd))
+      throw(FileWriteError(_fname, std::string("Cannot sync RMSD matrix: ") + strerror(errno)));
+
+    const char flag = 1;
+    for (std::vector<ulong>::const_iterator i = _pending.begin(); i != _pending.end(); ++i) {
+      pwriteAll(_fd, _fname, &flag, 1, matrix_flags_offset + *i);
+      _done[*i] = 1;
+    }
+    _pending.clear();
+
+    if (fdatasync(_fd))
+      throw(FileWriteError(_fname, std::string("Cannot sync RMSD matrix: ") + strerror(errno)));
+  }
+
+
+  RealMatrix RMSDMatrixFile::read(const std::string& fname) {
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw(FileOpenError(fname, strerror(errno), errno));
+
+    try {
+      MatrixFileHeader h = readHeader(fd, fname);
+      std::vector<char> done(h.ntiles);
+      if (!done.empty())
+        preadAll(fd, fname, &done[0], done.size(), matrix_flags_offset);
+      if (std::count(done.begin(), done.end(), 1) != static_cast<long>(done.size()))
+        throw(FileReadError(fname, "RMSD matrix file is incomplete"));
+
+      ulong base = (matrix_flags_offset + h.ntiles + matrix_alignment - 1) / matrix_alignment * matrix_alignment;
+      RealMatrix R(h.rows, h.cols);
+      std::vector<float> row(h.cols);
+      for (uint i=0; i<h.rows; ++i) {
+        if (h.cols)
+          preadAll(fd, fname, &row[0], h.cols * sizeof(float), base + static_cast<ulong>(i) * h.cols * sizeof(float));
+        for (uint j=0; j<h.cols; ++j)
+          R(i, j) = row[j];
+      }
+
+      ::close(fd);
+      return(R);
+    }
+    catch (...) {
+      ::close(fd);
+      throw;
+    }
+  }
+
+}
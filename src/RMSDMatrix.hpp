@@ -0,0 +1,202 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(LOOS_RMSD_MATRIX_HPP)
+#define LOOS_RMSD_MATRIX_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/utility.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <loos_defs.hpp>
+#include <FrameBuffer.hpp>
+#include <MatrixOps.hpp>
+
+
+namespace loos {
+
+  //! Pre-centered, single-precision frames for all-to-all RMSD calculations
+  /**
+   * Each frame is centered at the origin once and stored as three
+   * float arrays (x, y, z), padded with zeros to a multiple of the
+   * SIMD width so the inner-product kernel can work on whole vectors.
+   * The sum of squares of each frame is precomputed (in double
+   * precision).  Storage comes from a FrameBuffer, so it spills to a
+   * temporary file if it would use more than the memory budget.
+   */
+  class RMSDFrames : public boost::noncopyable {
+  public:
+    //! Number of floats processed together by the inner-product kernel
+    static const uint lanes = 8;
+
+    //! Reads and centers \a subset for each frame in \a indices from \a traj
+    RMSDFrames(const AtomicGroup& subset, pTraj& traj, const std::vector<uint>& indices,
+               const ulong budget = FrameBuffer::default_memory_budget);
+
+    //! Centers and stores frames given as packed xyz (e.g. from readCoords())
+    explicit RMSDFrames(const std::vector< std::vector<double> >& frames,
+                        const ulong budget = FrameBuffer::default_memory_budget);
+
+    uint nframes() const { return(_nframes); }
+    uint natoms() const { return(_natoms); }
+
+    //! Length of each coordinate array (natoms rounded up to a multiple of lanes)
+    uint stride() const { return(_stride); }
+
+    bool spilled() const { return(_buffer.spilled()); }
+
+    const float* x(const uint i) const { return(_buffer.frame(i)); }
+    const float* y(const uint i) const { return(_buffer.frame(i) + _stride); }
+    const float* z(const uint i) const { return(_buffer.frame(i) + 2 * _stride); }
+
+    //! Sum of the squared (centered) coordinates of frame \a i
+    double sumOfSquares(const uint i) const { return(_sumsq[i]); }
+
+  private:
+    static uint paddedStride(const uint n) { return((n + lanes - 1) / lanes * lanes); }
+    void store(const uint i, const double* xyz);
+
+    uint _nframes, _natoms, _stride;
+    FrameBuffer _buffer;
+    std::vector<double> _sumsq;
+  };
+
+
+  //! Options for the all-to-all RMSD engine
+  struct RMSDMatrixOptions {
+    RMSDMatrixOptions() : nthreads(0), tile(0), verbose(false) { }
+
+    //! Threads to use (0 means the shared ThreadPool, see ThreadPool::select())
+    uint nthreads;
+
+    //! Frames per side of a tile (0 picks a size that fits in the L2 cache)
+    /** Ignored when writing to an RMSDMatrixFile, which has its own tile size */
+    uint tile;
+
+    //! Report progress to stderr
+    bool verbose;
+  };
+
+
+  //! Pair-wise RMSD (after optimal superposition) between all frames
+  /**
+   * The matrix is divided into square tiles of frame pairs, small
+   * enough that both sets of frames in a tile stay in cache while all
+   * of the pairs are computed, and tiles are handed out to threads as
+   * they become free.  The inner products are computed with a
+   * vectorizable float kernel (summed in double every few hundred
+   * atoms) and the RMSD from them using QCP, without computing the
+   * rotation.  Only the lower triangle is computed; the matrix is
+   * symmetric with zeros on the diagonal.
+   */
+  RealMatrix allToAllRMSD(const RMSDFrames& frames, const RMSDMatrixOptions& opts = RMSDMatrixOptions());
+
+  //! Pair-wise RMSD between every frame in \a A and every frame in \a B
+  RealMatrix allToAllRMSD(const RMSDFrames& A, const RMSDFrames& B, const RMSDMatrixOptions& opts = RMSDMatrixOptions());
+
+
+  //! Tile size (frames per side) that keeps a tile of \a frames in the L2 cache
+  uint rmsdTileSize(const RMSDFrames& frames);
+
+
+  //! Binary, tiled RMSD matrix file for out-of-core all-to-all calculations
+  /**
+   * When the RMSD matrix is too large to keep in memory, the engine
+   * can write each finished tile directly into a file instead.  The
+   * file holds a small header, one completion flag per tile, and the
+   * matrix itself as native-endian floats in row-major order, starting
+   * at a page boundary.  Tiles are written with pwrite(), or copied
+   * into a memory-mapping of the file if \p mapped is set.
+   *
+   * Completed tiles are recorded in the file at checkpoints (every
+   * few seconds, and when the file is closed).  Data is synced to disk
+   * before the flags are, so if a run is interrupted, reopening the
+   * file with \p resume set picks up where the last checkpoint left
+   * off and only the remaining tiles are computed.
+   *
+   * For a symmetric (single trajectory) matrix, both triangles are
+   * written.
+   */
+  class RMSDMatrixFile : public boost::noncopyable {
+  public:
+    //! Creates a new matrix file, or reopens an existing one if \p resume is set
+    /**
+     * When resuming, the size and symmetry must match the existing file
+     * and the tile size stored in the file is used instead of \p tile.
+     */
+    RMSDMatrixFile(const std::string& fname, const uint rows, const uint cols, const bool symmetric,
+                   const uint tile, const bool resume = false, const bool mapped = false);
+
+    ~RMSDMatrixFile();
+
+    uint rows() const { return(_rows); }
+    uint cols() const { return(_cols); }
+    bool symmetric() const { return(_symmetric); }
+    uint tileSize() const { return(_tile); }
+    ulong numberOfTiles() const { return(_done.size()); }
+
+    //! Number of tiles already completed (e.g. by a previous run)
+    ulong tilesDone() const;
+
+    bool tileDone(const ulong k) const { return(_done[k] != 0); }
+
+    //! Writes the \a nr x \a nc block \a data (row-major) at (\a row, \a col) and marks tile \a k done
+    void writeTile(const ulong k, const uint row, const uint col, const float* data, const uint nr, const uint nc);
+
+    //! Syncs the data and records the completed tiles in the file
+    void checkpoint();
+
+    //! Reads a matrix file (which must be complete) into memory
+    static RealMatrix read(const std::string& fname);
+
+  private:
+    void create(const uint tile);
+    void reopen();
+    void writeBlock(const uint row, const uint col, const float* data, const uint nr, const uint nc, const uint ld);
+    ulong dataOffset() const;
+    void checkpointLocked();
+
+    std::string _fname;
+    int _fd;
+    uint _rows, _cols, _tile;
+    bool _symmetric, _mapped;
+    char* _map;
+    ulong _map_size;
+    std::vector<char> _done;
+    std::vector<ulong> _pending;
+    time_t _last_checkpoint;
+    boost::mutex _mtx;
+  };
+
+
+  //! All-to-all RMSD for \a frames, written to \a out (skipping tiles already done)
+  void allToAllRMSD(const RMSDFrames& frames, RMSDMatrixFile& out, const RMSDMatrixOptions& opts = RMSDMatrixOptions());
+
+  //! RMSD between frames in \a A and \a B, written to \a out (skipping tiles already done)
+  void allToAllRMSD(const RMSDFrames& A, const RMSDFrames& B, RMSDMatrixFile& out, const RMSDMatrixOptions& opts = RMSDMatrixOptions());
+
+}
+
+
+#endif
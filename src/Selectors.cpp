@@ -20,6 +20,7 @@
 */
 
 #include <Selectors.hpp>
+#include <KernelPlan.hpp>
 
 namespace loos {
 
@@ -199,4 +200,15 @@ namespace loos {
     return(results.itg);
   }
 
+
+  // Falls back to running the Kernel on each atom if it contains
+  // commands that can't be compiled
+  boost::dynamic_bitset<> KernelSelector::mask(const std::vector<pAtom>& atoms) const {
+    internal::KernelPlan plan(krnl);
+    if (plan.compiled())
+      return(plan.evaluate(atoms));
+
+    return(AtomSelector::mask(atoms));
+  }
+
 }
@@ -207,7 +207,9 @@ namespace loos {
   /**
    * This predicate takes a compiled Kernel and executes it once for each
    * Atom.  This is primarily for use in conjunction with the Parser for
-   * handling selections based on user input.
+   * handling selections based on user input.  When selecting from a
+   * whole group (i.e. AtomicGroup::select()), the Kernel is instead
+   * evaluated column-wise over all of the atoms at once.
    *
    * Example:
    * \code
@@ -222,6 +224,9 @@ namespace loos {
 
     bool operator()(const pAtom& pa) const;
 
+    //! Evaluates the Kernel over all atoms at once (see internal::KernelPlan)
+    boost::dynamic_bitset<> mask(const std::vector<pAtom>& atoms) const;
+
   private:
     Kernel& krnl;
 
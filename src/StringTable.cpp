@@ -0,0 +1,98 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <StringTable.hpp>
+#include <exceptions.hpp>
+
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+
+namespace loos {
+
+  namespace {
+
+    // Strings are stored in fixed-size chunks that are never
+    // reallocated, so a string's address never changes once it has
+    // been interned.  The chunk pointers are likewise only written
+    // once, before any handle into that chunk is handed out.
+    const uint chunk_bits = 12;
+    const uint chunk_size = 1u << chunk_bits;
+    const uint max_chunks = 16384;
+
+    struct Table {
+      Table() : n(0) {
+        for (uint i=0; i<max_chunks; ++i)
+          chunks[i] = 0;
+        add(std::string());
+      }
+
+      StringTable::Handle add(const std::string& s) {
+        uint c = n >> chunk_bits;
+        if (c >= max_chunks)
+          throw(LOOSError("Too many distinct strings for the StringTable"));
+        if (chunks[c] == 0)
+          chunks[c] = new std::string[chunk_size];
+        chunks[c][n & (chunk_size - 1)] = s;
+        handles[s] = n;
+        return(n++);
+      }
+
+      boost::mutex mutex;
+      boost::unordered_map<std::string, StringTable::Handle> handles;
+      std::string* chunks[max_chunks];
+      uint n;
+    };
+
+    // Function-local static so the table is safely constructed on
+    // first use, even if that happens during static initialization
+    Table& table() {
+      static Table t;
+      return(t);
+    }
+
+  }
+
+
+  StringTable::Handle StringTable::intern(const std::string& s) {
+    Table& t = table();
+    boost::lock_guard<boost::mutex> lock(t.mutex);
+
+    boost::unordered_map<std::string, Handle>::const_iterator i = t.handles.find(s);
+    if (i != t.handles.end())
+      return(i->second);
+    return(t.add(s));
+  }
+
+
+  const std::string& StringTable::lookup(const Handle h) {
+    return(table().chunks[h >> chunk_bits][h & (chunk_size - 1)]);
+  }
+
+
+  uint StringTable::size() {
+    Table& t = table();
+    boost::lock_guard<boost::mutex> lock(t.mutex);
+    return(t.n);
+  }
+
+}
@@ -0,0 +1,62 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(LOOS_STRING_TABLE_HPP)
+#define LOOS_STRING_TABLE_HPP
+
+#include <string>
+
+#include <loos_defs.hpp>
+
+
+namespace loos {
+
+  //! Global table of interned strings
+  /**
+   * Atoms only have a few hundred distinct names, resnames, segids,
+   * etc., even in very large systems.  Rather than each atom storing
+   * its own copies of these strings, the strings are stored once in
+   * this table and atoms store a small integer handle.  Two handles
+   * are equal if and only if their strings are equal.
+   *
+   * Interning is thread-safe.  Looking up a handle does not lock, since
+   * strings are never moved or removed once they are in the table.
+   * The empty string always has the handle 0.
+   */
+  class StringTable {
+  public:
+    typedef uint Handle;
+
+    //! Returns the handle for \a s, adding it to the table if necessary
+    static Handle intern(const std::string& s);
+
+    //! Returns the string for the handle \a h
+    static const std::string& lookup(const Handle h);
+
+    //! Number of distinct strings in the table
+    static uint size();
+  };
+
+}
+
+
+#endif
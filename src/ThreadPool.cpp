@@ -0,0 +1,266 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <ThreadPool.hpp>
+#include <exceptions.hpp>
+
+#include <algorithm>
+#include <exception>
+
+#include <boost/bind.hpp>
+#include <boost/thread/locks.hpp>
+
+
+namespace loos {
+
+  namespace {
+
+    // Chunks per thread when no grain size is given, so that uneven
+    // chunks can be balanced by stealing
+    const ulong chunks_per_thread = 4;
+
+    // The global pool is shared so that resizing it never pulls it out
+    // from under anyone still using it
+    boost::mutex global_mtx;
+    boost::shared_ptr<ThreadPool> global_pool;
+    uint global_threads = 0;
+
+    uint resolveThreads(const uint n) {
+      if (n)
+        return(n);
+      return(std::max(1u, boost::thread::hardware_concurrency()));
+    }
+
+    // Both assume global_mtx is held
+    uint globalSize() {
+      return(global_pool ? global_pool->size() : resolveThreads(global_threads));
+    }
+
+    boost::shared_ptr<ThreadPool> globalPool() {
+      if (!global_pool)
+        global_pool = boost::shared_ptr<ThreadPool>(new ThreadPool(global_threads));
+      return(global_pool);
+    }
+
+  }
+
+
+  void ThreadPool::Batch::finish() {
+    boost::lock_guard<boost::mutex> lock(mtx);
+    if (--pending == 0)
+      cv.notify_all();
+  }
+
+
+  void ThreadPool::Batch::fail(const std::string& msg) {
+    boost::lock_guard<boost::mutex> lock(mtx);
+    if (!failed) {
+      failed = true;
+      error = msg;
+    }
+  }
+
+
+  bool ThreadPool::Batch::done() {
+    boost::lock_guard<boost::mutex> lock(mtx);
+    return(pending == 0);
+  }
+
+
+  void ThreadPool::Batch::wait() {
+    boost::unique_lock<boost::mutex> lock(mtx);
+    while (pending > 0)
+      cv.wait(lock);
+  }
+
+
+  ThreadPool::ThreadPool(const uint nthreads) : _queued(0), _stop(false) {
+    uint n = resolveThreads(nthreads);
+    for (uint i=0; i<n; ++i)
+      _queues.push_back(boost::shared_ptr<Queue>(new Queue));
+    for (uint i=0; i+1<n; ++i)
+      _threads.create_thread(boost::bind(&ThreadPool::worker, this, i));
+  }
+
+
+  ThreadPool::~ThreadPool() {
+    {
+      boost::lock_guard<boost::mutex> lock(_sleep_mtx);
+      _stop = true;
+      _wake.notify_all();
+    }
+    _threads.join_all();
+  }
+
+
+  ulong ThreadPool::chunkSize(const ulong n, const ulong grain) const {
+    if (grain)
+      return(grain);
+    return(std::max(1ul, n / (chunks_per_thread * size())));
+  }
+
+
+  // Workers use their own queue; any other thread shares the last one
+  uint ThreadPool::self() const {
+    const uint* p = _self.get();
+    return(p ? *p : _queues.size() - 1);
+  }
+
+
+  bool ThreadPool::take(const uint self, Item& item) {
+    uint n = _queues.size();
+    for (uint k=0; k<n; ++k) {
+      Queue& q = *(_queues[(self + k) % n]);
+      boost::lock_guard<boost::mutex> lock(q.mtx);
+      if (q.items.empty())
+        continue;
+      if (k == 0) {
+        item = q.items.back();
+        q.items.pop_back();
+      } else {
+        item = q.items.front();
+        q.items.pop_front();
+      }
+
+      boost::lock_guard<boost::mutex> sleep_lock(_sleep_mtx);
+      --_queued;
+      return(true);
+    }
+    return(false);
+  }
+
+
+  void ThreadPool::execute(const Item& item) {
+    try {
+      (*item.task)();
+    }
+    catch (std::exception& e) {
+      item.batch->fail(e.what());
+    }
+    catch (...) {
+      item.batch->fail("Unknown exception in thread pool task");
+    }
+    item.batch->finish();
+  }
+
+
+  void ThreadPool::worker(const uint id) {
+    _self.reset(new uint(id));
+
+    while (true) {
+      Item item;
+      if (take(id, item)) {
+        execute(item);
+        continue;
+      }
+
+      boost::unique_lock<boost::mutex> lock(_sleep_mtx);
+      while (_queued <= 0 && !_stop)
+        _wake.wait(lock);
+      if (_stop && _queued <= 0)
+        return;
+    }
+  }
+
+
+  void ThreadPool::run(const std::vector<Task>& tasks) {
+    if (tasks.empty())
+      return;
+
+    Batch batch(tasks.size());
+
+    // Run inline, but with the same error handling as when queued
+    if (_queues.size() == 1 || tasks.size() == 1) {
+      for (std::vector<Task>::const_iterator i = tasks.begin(); i != tasks.end(); ++i)
+        execute(Item(&(*i), &batch));
+      if (batch.failed)
+        throw(LOOSError(batch.error));
+      return;
+    }
+
+    uint me = self();
+    uint n = _queues.size();
+
+    // Counted before they are queued so an idle worker never sees
+    // work it cannot find and goes back to sleep
+    {
+      boost::lock_guard<boost::mutex> lock(_sleep_mtx);
+      _queued += tasks.size();
+    }
+
+    // Dealt out in reverse so each queue's first chunks are taken first
+    for (ulong k = tasks.size(); k-- > 0; ) {
+      Queue& q = *(_queues[(me + k) % n]);
+      boost::lock_guard<boost::mutex> lock(q.mtx);
+      q.items.push_back(Item(&tasks[k], &batch));
+    }
+
+    {
+      boost::lock_guard<boost::mutex> lock(_sleep_mtx);
+      _wake.notify_all();
+    }
+
+    // Help out (possibly with other batches) until nothing is left to
+    // take, then wait for tasks still running elsewhere
+    Item item;
+    while (!batch.done() && take(me, item))
+      execute(item);
+    batch.wait();
+
+    if (batch.failed)
+      throw(LOOSError(batch.error));
+  }
+
+
+  boost::shared_ptr<ThreadPool> ThreadPool::global() {
+    boost::lock_guard<boost::mutex> lock(global_mtx);
+    return(globalPool());
+  }
+
+
+  void ThreadPool::setGlobalThreads(const uint nthreads) {
+    boost::shared_ptr<ThreadPool> old;    // If this is the last user, shut it down outside the lock
+    {
+      boost::lock_guard<boost::mutex> lock(global_mtx);
+      global_threads = nthreads;
+      if (global_pool && global_pool->size() != resolveThreads(nthreads))
+        old.swap(global_pool);
+    }
+  }
+
+
+  uint ThreadPool::globalThreads() {
+    boost::lock_guard<boost::mutex> lock(global_mtx);
+    return(globalSize());
+  }
+
+
+  boost::shared_ptr<ThreadPool> ThreadPool::select(const uint nthreads) {
+    {
+      boost::lock_guard<boost::mutex> lock(global_mtx);
+      if (nthreads == 0 || nthreads == globalSize())
+        return(globalPool());
+    }
+    return(boost::shared_ptr<ThreadPool>(new ThreadPool(nthreads)));
+  }
+
+}
@@ -0,0 +1,218 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(LOOS_THREAD_POOL_HPP)
+#define LOOS_THREAD_POOL_HPP
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <loos_defs.hpp>
+
+
+namespace loos {
+
+  //! Work-stealing pool of threads for data-parallel loops
+  /**
+   * A pool of size \a n runs \a n-1 worker threads, and the thread
+   * that calls parallelFor() or parallelReduce() does its share of
+   * the work too.  A pool of size 1 simply runs everything in the
+   * calling thread.
+   *
+   * Each worker has its own queue of tasks.  A loop is split into
+   * chunks that are dealt out across the queues; workers take from
+   * the back of their own queue and, when that is empty, steal from
+   * the front of the others.  The caller never blocks while there is
+   * still queued work, so a task may itself call parallelFor() on the
+   * same pool (nested parallelism) without deadlocking.  This also
+   * means tasks may call into LAPACK/BLAS, including a threaded
+   * ATLAS, though the two will then compete for cores.
+   *
+   * If a task throws, the remaining tasks of that loop are still run
+   * and a LOOSError with the first message is thrown in the caller.
+   * This is the same for any pool size, including 1, so the original
+   * exception type is not preserved.
+   *
+   * Tools normally use the shared pool from global(), sized by the
+   * --threads option (see OptionsFramework::ThreadOptions).
+   */
+  class ThreadPool : public boost::noncopyable {
+  public:
+    typedef boost::function<void ()> Task;
+
+    //! Creates a pool of \a nthreads threads (0 means one per core)
+    explicit ThreadPool(const uint nthreads = 0);
+    ~ThreadPool();
+
+    //! Number of threads, including the calling thread
+    uint size() const { return(_threads.size() + 1); }
+
+    //! Runs all \a tasks, returning when they are complete
+    void run(const std::vector<Task>& tasks);
+
+
+    //! Calls \a body(lo, hi) for chunks covering [\a begin, \a end)
+    /**
+     * With \a grain of 0, the range is split into a few chunks per
+     * thread.  \a body is shared by all threads.
+     */
+    template<class Body>
+    void parallelFor(const ulong begin, const ulong end, Body body, const ulong grain = 0) {
+      if (end <= begin)
+        return;
+      ulong size = chunkSize(end - begin, grain);
+
+      std::vector<Task> tasks;
+      for (ulong lo = begin; lo < end; lo += size)
+        tasks.push_back(ForChunk<Body>(body, lo, std::min(end, lo + size)));
+      run(tasks);
+    }
+
+
+    //! Reduces [\a begin, \a end) with \a map(lo, hi) over chunks, combined with \a combine
+    /**
+     * The chunk results are combined in order starting from \a init,
+     * i.e. \a combine(\a combine(\a init, r0), r1)..., so the result
+     * does not depend on which threads ran which chunks.
+     */
+    template<typename T, class Map, class Combine>
+    T parallelReduce(const ulong begin, const ulong end, const T& init, Map map, Combine combine,
+                     const ulong grain = 0) {
+      if (end <= begin)
+        return(init);
+      ulong size = chunkSize(end - begin, grain);
+      ulong n = (end - begin + size - 1) / size;
+
+      std::vector<T> results(n, init);
+      std::vector<Task> tasks;
+      for (ulong k=0; k<n; ++k)
+        tasks.push_back(ReduceChunk<T, Map>(map, begin + k * size, std::min(end, begin + (k+1) * size), results[k]));
+      run(tasks);
+
+      T result = init;
+      for (ulong k=0; k<n; ++k)
+        result = combine(result, results[k]);
+      return(result);
+    }
+
+
+    //! The pool shared by the library and tools
+    /**
+     * Hold on to the returned pointer for as long as the pool is
+     * used (a temporary, as in global()->parallelFor(...), lasts for
+     * the whole call).
+     */
+    static boost::shared_ptr<ThreadPool> global();
+
+    //! Sets the size of the global pool (0 means one per core)
+    /**
+     * A pool already returned by global() or select() keeps its size
+     * and stays alive until its last user lets go of it.  Only later
+     * calls get the resized pool.
+     */
+    static void setGlobalThreads(const uint nthreads);
+
+    //! Size of the global pool
+    static uint globalThreads();
+
+    //! Returns the global pool if \a nthreads is 0 or matches its size, otherwise a new pool
+    static boost::shared_ptr<ThreadPool> select(const uint nthreads);
+
+
+  private:
+
+    template<class Body>
+    struct ForChunk {
+      ForChunk(Body& b, const ulong l, const ulong h) : body(&b), lo(l), hi(h) { }
+      void operator()() { (*body)(lo, hi); }
+      Body* body;
+      ulong lo, hi;
+    };
+
+    template<typename T, class Map>
+    struct ReduceChunk {
+      ReduceChunk(Map& m, const ulong l, const ulong h, T& r) : map(&m), lo(l), hi(h), result(&r) { }
+      void operator()() { *result = (*map)(lo, hi); }
+      Map* map;
+      ulong lo, hi;
+      T* result;
+    };
+
+
+    // Tracks the outstanding tasks from one call to run()
+    struct Batch {
+      explicit Batch(const ulong n) : pending(n), failed(false) { }
+      void finish();
+      void fail(const std::string& msg);
+      bool done();
+      void wait();
+
+      boost::mutex mtx;
+      boost::condition_variable cv;
+      ulong pending;
+      bool failed;
+      std::string error;
+    };
+
+    struct Item {
+      Item() : task(0), batch(0) { }
+      Item(const Task* t, Batch* b) : task(t), batch(b) { }
+      const Task* task;
+      Batch* batch;
+    };
+
+    struct Queue {
+      boost::mutex mtx;
+      std::deque<Item> items;
+    };
+
+
+    ulong chunkSize(const ulong n, const ulong grain) const;
+    uint self() const;
+    bool take(const uint self, Item& item);
+    void execute(const Item& item);
+    void worker(const uint id);
+
+
+    boost::thread_group _threads;
+    std::vector< boost::shared_ptr<Queue> > _queues;   // One per worker, plus one for outside callers
+    boost::thread_specific_ptr<uint> _self;
+
+    boost::mutex _sleep_mtx;
+    boost::condition_variable _wake;
+    long _queued;
+    bool _stop;
+  };
+
+}
+
+
+#endif
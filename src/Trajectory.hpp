@@ -26,6 +26,7 @@
 #include <string>
 #include <stdexcept>
 #include <vector>
+#include <algorithm>
 
 #include <boost/utility.hpp>
 #include <boost/lambda/lambda.hpp>
@@ -34,6 +35,7 @@
 #include <AtomicGroup.hpp>
 
 #include <AtomicGroup.hpp>
+#include <CoordinateArena.hpp>
 
 
 namespace loos {
@@ -83,7 +85,8 @@ namespace loos {
 		}
 
 
-		Trajectory(const Trajectory& t) : ifs(t.ifs), cached_first(t.cached_first), _filename(t._filename), _current_frame(t._current_frame)
+		Trajectory(const Trajectory& t) : ifs(t.ifs), cached_first(t.cached_first), _filename(t._filename), _current_frame(t._current_frame),
+										  _atom_subset(t._atom_subset)
 		{
 		}
 
@@ -172,6 +175,23 @@ namespace loos {
 			updateGroupCoordsImpl(g);
 		}
 
+		//! Update the coordinates in a CoordinateArena with the current frame.
+		/** Arena slots correspond to frame indices, so the arena may not
+		 * be larger than the frame.  Formats that store their frame
+		 * contiguously copy it straight into the arena without going
+		 * through any atoms.  The periodic box is also set (if present).
+		 * As with coords(), only atoms in the atom subset (if one is set)
+		 * are valid.
+		 */
+		void updateArenaCoords(CoordinateArena& arena)
+		{
+			if (arena.size() > natoms())
+				throw(LOOSError("CoordinateArena is larger than the trajectory frame"));
+			updateArenaCoordsImpl(arena);
+			if (hasPeriodicBox())
+				arena.periodicBox(periodicBox());
+		}
+
 
 
 		//! Returns the current frame's velocities as a vector of GCoords
@@ -212,6 +232,50 @@ namespace loos {
 		}
 
 
+		//! Register the atoms that will actually be used from each frame
+		/** Formats that support partial frame reads (e.g. DCD and Amber
+		 * NetCDF) will only read coordinates for these atoms from subsequent
+		 * frames.  Other formats ignore the subset and read full frames.
+		 * The indices are Atom::index() values, i.e. indices into the
+		 * trajectory frame.
+		 *
+		 * Once a subset is registered, the coordinates for atoms that
+		 * are not in the subset are undefined for any frame read after
+		 * the subset was set.  This includes the values returned by
+		 * coords().  Only use this when you are certain no other atoms
+		 * will be needed (or call clearAtomSubset() first).  The frame
+		 * that is currently cached is not affected.
+		 */
+		void setAtomSubset(const std::vector<uint>& indices) {
+			_atom_subset = indices;
+			std::sort(_atom_subset.begin(), _atom_subset.end());
+			_atom_subset.erase(std::unique(_atom_subset.begin(), _atom_subset.end()), _atom_subset.end());
+			if (!_atom_subset.empty() && _atom_subset.back() >= natoms())
+				throw(LOOSError("Atom subset index is out of range for the trajectory"));
+			atomSubsetChangedImpl();
+		}
+
+		//! Register the atoms in \a g as the only ones that will be used
+		void setAtomSubset(const AtomicGroup& g) {
+			std::vector<uint> indices;
+			indices.reserve(g.size());
+			for (AtomicGroup::const_iterator i = g.begin(); i != g.end(); ++i)
+				indices.push_back((*i)->index());
+			setAtomSubset(indices);
+		}
+
+		//! Go back to reading full frames
+		void clearAtomSubset() {
+			_atom_subset.clear();
+			atomSubsetChangedImpl();
+		}
+
+		bool hasAtomSubset() const { return(!_atom_subset.empty()); }
+
+		//! The registered atom subset (sorted, with no duplicates)
+		const std::vector<uint>& atomSubset() const { return(_atom_subset); }
+
+
 		//! Seek to the next frame in the sequence (used by readFrame() when
 		//! operating as an iterator).
 		void seekNextFrame(void) {
@@ -302,6 +366,26 @@ namespace loos {
 		std::string _filename;   // Remember filename (if passed)
 		uint _current_frame;
 
+		std::vector<uint> _atom_subset;   // Atoms of interest (empty means all)
+
+		typedef std::pair<uint, uint>  IndexRun;   // first index, number of indices
+
+		//! Collapse the atom subset into contiguous runs of indices
+		/** Runs separated by no more than \a max_gap indices are merged,
+		 * since it is usually cheaper to read a few extra atoms than
+		 * to perform another seek/read.
+		 */
+		std::vector<IndexRun> atomSubsetRuns(const uint max_gap = 0) const {
+			std::vector<IndexRun> runs;
+			for (std::vector<uint>::const_iterator i = _atom_subset.begin(); i != _atom_subset.end(); ++i) {
+				if (!runs.empty() && *i <= runs.back().first + runs.back().second + max_gap)
+					runs.back().second = *i - runs.back().first + 1;
+				else
+					runs.push_back(IndexRun(*i, 1));
+			}
+			return(runs);
+		}
+
 	private:
 
 		//! NVI implementation for seeking next frame
@@ -316,12 +400,20 @@ namespace loos {
 		//! NVI implementation of updateGroupCoords() for derived classes to override
 		virtual void updateGroupCoordsImpl(AtomicGroup& g) =0;
 
+		//! NVI implementation of updateArenaCoords() (the default copies coords())
+		virtual void updateArenaCoordsImpl(CoordinateArena& arena) {
+			arena.coords(coords());
+		}
+
 		virtual void updateGroupVelocitiesImpl(AtomicGroup& g) {
 			throw(LOOSError("No velocity update implementation defined but trajectory supports it"));
 		}
 
 		virtual std::vector<GCoord> velocitiesImpl() const { return(std::vector<GCoord>()); }
 
+		//! Called when the atom subset changes (formats supporting partial reads should override)
+		virtual void atomSubsetChangedImpl() { }
+
 	};
 
 }
@@ -34,46 +34,52 @@
 
 
 #include <string>
+#include <vector>
 #include <ext/slist>
 
+#include <boost/unordered_map.hpp>
+
 
 namespace loos {
 
   //! Class for uniquifying strings...
-  /**  This class uses an slist and just does a linear search to see if
-   *   we've already encountered the passed string before.  This probably
-   *   should be updated to use a faster method in the future...
+  /**  Strings are kept in a hash map, so adding and finding strings
+   *   takes constant time.  Each unique string is assigned an index in
+   *   the order it was first added.
    */
   class UniqueStrings {
   public:
 
     //! Adds a string to the unique string list
     void add(const std::string& s) {
-      if (find(s) < 0)
-        uniques.push_front(s);
+      if (indices.find(s) == indices.end()) {
+        indices[s] = uniques.size();
+        uniques.push_back(s);
+      }
     }
 
     //! Number of unique strings found...
     int size(void) const { return(uniques.size()); }
 
-    //! Returns the raw slist of strings...
-    __gnu_cxx::slist<std::string> strings(void) const { return(uniques); }
+    //! Returns the unique strings as an slist, in order of their indices
+    __gnu_cxx::slist<std::string> strings(void) const {
+      return(__gnu_cxx::slist<std::string>(uniques.begin(), uniques.end()));
+    }
 
     //! Checks to see if we've encountered this string before...
     /** Returns an index (a unique int) representing this string.
      *  If the string is not found, returns -1.
      */
     int find(const std::string& s) {
-      int j = 0;
-      __gnu_cxx::slist<std::string>::const_iterator i;
-      for (i = uniques.begin(); i != uniques.end(); i++, j++)
-        if (*i == s)
-          return(j);
-      return(-1); 
+      boost::unordered_map<std::string, int>::const_iterator i = indices.find(s);
+      if (i == indices.end())
+        return(-1);
+      return(i->second);
     }
 
   private:
-    __gnu_cxx::slist<std::string> uniques;
+    std::vector<std::string> uniques;
+    boost::unordered_map<std::string, int> indices;
   };
 
 }
@@ -0,0 +1,201 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <VerletList.hpp>
+#include <CellList.hpp>
+#include <exceptions.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace loos {
+
+
+  VerletList::VerletList(const AtomicGroup& first, const AtomicGroup& second, const double cutoff, const double skin)
+    : _first(first), _second(second), _self(false), _cutoff(cutoff), _skin(skin)
+  {
+    init();
+  }
+
+
+  VerletList::VerletList(const AtomicGroup& group, const double cutoff, const double skin)
+    : _first(group), _second(group), _self(true), _cutoff(cutoff), _skin(skin)
+  {
+    init();
+  }
+
+
+  void VerletList::init() {
+    if (!(_cutoff > 0.0))
+      throw(LOOSError("VerletList cutoff must be greater than zero"));
+    if (_skin < 0.0)
+      throw(LOOSError("VerletList skin cannot be negative"));
+
+    for (AtomicGroup::const_iterator i = _first.begin(); i != _first.end(); ++i)
+      _first_atoms.push_back(i->get());
+    for (AtomicGroup::const_iterator i = _second.begin(); i != _second.end(); ++i)
+      _second_atoms.push_back(i->get());
+
+    _periodic = false;
+    _builds = 0;
+    build(false, GCoord(0,0,0));
+  }
+
+
+  bool VerletList::update() {
+    if (!needsRebuild(false, GCoord(0,0,0)))
+      return(false);
+    build(false, GCoord(0,0,0));
+    return(true);
+  }
+
+
+  bool VerletList::update(const GCoord& box) {
+    if (!needsRebuild(true, box)) {
+      _box = box;
+      return(false);
+    }
+    build(true, box);
+    return(true);
+  }
+
+
+  void VerletList::rebuild() {
+    build(false, GCoord(0,0,0));
+  }
+
+
+  void VerletList::rebuild(const GCoord& box) {
+    build(true, box);
+  }
+
+
+  // The distance between any pair can change by at most the
+  // displacement of each atom plus the change in the box (which
+  // shifts the periodic images).  The list remains valid while that
+  // is within the skin.
+  bool VerletList::needsRebuild(const bool periodic, const GCoord& box) const {
+    if (periodic != _periodic)
+      return(true);
+
+    double box_change = periodic ? (box - _ref_box).length() : 0.0;
+    if (box_change >= _skin)
+      return(true);
+
+    double limit = (_skin - box_change) / 2.0;
+    double limit2 = limit * limit;
+
+    for (uint i=0; i<_first_atoms.size(); ++i)
+      if (_first_atoms[i]->coords().distance2(_first_ref[i]) > limit2)
+        return(true);
+
+    if (!_self)
+      for (uint i=0; i<_second_atoms.size(); ++i)
+        if (_second_atoms[i]->coords().distance2(_second_ref[i]) > limit2)
+          return(true);
+
+    return(false);
+  }
+
+
+  void VerletList::build(const bool periodic, const GCoord& box) {
+    _periodic = periodic;
+    _box = box;
+    _ref_box = box;
+
+    _first_ref.resize(_first_atoms.size());
+    for (uint i=0; i<_first_atoms.size(); ++i)
+      _first_ref[i] = _first_atoms[i]->coords();
+    if (!_self) {
+      _second_ref.resize(_second_atoms.size());
+      for (uint i=0; i<_second_atoms.size(); ++i)
+        _second_ref[i] = _second_atoms[i]->coords();
+    }
+
+    const std::vector<GCoord>& targets = _self ? _first_ref : _second_ref;
+    double reach = _cutoff + _skin;
+    double reach2 = reach * reach;
+
+    CellList cells(reach);
+    if (periodic)
+      cells.update(targets, box);
+    else
+      cells.update(targets);
+
+    _pairs.clear();
+    std::vector<uint> near;
+    for (uint i=0; i<_first_ref.size(); ++i) {
+      near.clear();
+      cells.candidates(_first_ref[i], near);
+      std::sort(near.begin(), near.end());
+      for (std::vector<uint>::const_iterator j = near.begin(); j != near.end(); ++j) {
+        if (_self && *j <= i)
+          continue;
+        if (cells.distance2(_first_ref[i], *j) <= reach2)
+          _pairs.push_back(Pair(i, *j));
+      }
+    }
+
+    ++_builds;
+  }
+
+
+  std::vector<VerletList::Pair> VerletList::contacts() const {
+    double cut2 = _cutoff * _cutoff;
+    std::vector<Pair> result;
+    for (std::vector<Pair>::const_iterator i = _pairs.begin(); i != _pairs.end(); ++i)
+      if (distance2(*i) <= cut2)
+        result.push_back(*i);
+
+    return(result);
+  }
+
+
+  uint VerletList::count() const {
+    double cut2 = _cutoff * _cutoff;
+    uint n = 0;
+    for (std::vector<Pair>::const_iterator i = _pairs.begin(); i != _pairs.end(); ++i)
+      if (distance2(*i) <= cut2)
+        ++n;
+
+    return(n);
+  }
+
+
+  uint VerletList::count(const double inner, const double outer) const {
+    if (outer > _cutoff)
+      throw(LOOSError("Contact distance is larger than the VerletList cutoff"));
+
+    double inner2 = inner * inner;
+    double outer2 = outer * outer;
+    uint n = 0;
+    for (std::vector<Pair>::const_iterator i = _pairs.begin(); i != _pairs.end(); ++i) {
+      double d = distance2(*i);
+      if (d >= inner2 && d <= outer2)
+        ++n;
+    }
+
+    return(n);
+  }
+
+}
@@ -0,0 +1,148 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(LOOS_VERLET_LIST_HPP)
+#define LOOS_VERLET_LIST_HPP
+
+#include <vector>
+#include <utility>
+
+#include <loos_defs.hpp>
+#include <Coord.hpp>
+#include <AtomicGroup.hpp>
+
+
+namespace loos {
+
+  //! Verlet (neighbor) list of atom pairs that can be reused across frames
+  /**
+   * A VerletList holds all pairs of atoms (one from each of two
+   * groups, or unique pairs from a single group) that are within
+   * cutoff + skin of each other.  As long as no atom has moved more
+   * than half the skin since the list was built, every pair that is
+   * now within the cutoff must already be in the list, so contacts
+   * can be found by checking only those pairs rather than all N*M.
+   * Atoms in a trajectory usually move much less than an angstrom
+   * between saved frames, so the list only needs to be rebuilt
+   * occasionally.
+   *
+   * Call update() after reading each frame.  It checks how far the
+   * atoms have moved (and how much the periodic box has changed), and
+   * only rebuilds the list (using a CellList) if needed:
+   \code
+   AtomicGroup lipids = selectAtoms(model, "resname == 'POPC'");
+   AtomicGroup protein = selectAtoms(model, "segid == 'PROT'");
+   VerletList vlist(lipids, protein, 4.0, 2.0);
+   while (traj->readFrame()) {
+     traj->updateGroupCoords(model);
+     vlist.update(model.periodicBox());
+     std::cout << vlist.count() << std::endl;
+   }
+   \endcode
+   *
+   * Distances are calculated the same way as AtomicGroup::within()
+   * (pairs exactly at the cutoff are included).  The groups share
+   * their atoms with the ones passed in, so updating the coordinates
+   * of the originals is enough.  Atoms that are wrapped back into the
+   * box by the trajectory appear to move a long way, so they will
+   * trigger a rebuild.  The box change test assumes atoms stay close
+   * to the primary cell (i.e. the trajectory is imaged, not unwrapped).
+   */
+  class VerletList {
+  public:
+    //! A pair of atoms, as indices into the first and second groups
+    typedef std::pair<uint, uint>    Pair;
+
+    //! Pairs between \a first and \a second within \a cutoff (non-periodic until update() is given a box)
+    VerletList(const AtomicGroup& first, const AtomicGroup& second, const double cutoff, const double skin);
+
+    //! Unique pairs (i < j) within \a group
+    VerletList(const AtomicGroup& group, const double cutoff, const double skin);
+
+    //! Updates the list for the current coordinates (non-periodic)
+    /**
+     * Returns true if the list had to be rebuilt
+     */
+    bool update();
+
+    //! Updates the list for the current coordinates using the periodic box \a box
+    bool update(const GCoord& box);
+
+    //! Forces the list to be rebuilt
+    void rebuild();
+    void rebuild(const GCoord& box);
+
+    //! Candidate pairs (within cutoff + skin when the list was last built)
+    const std::vector<Pair>& pairs() const { return(_pairs); }
+
+    //! Pairs currently within the cutoff
+    std::vector<Pair> contacts() const;
+
+    //! Number of pairs currently within the cutoff
+    uint count() const;
+
+    //! Number of pairs whose distance d is \a inner <= d <= \a outer
+    /**
+     * \a outer must be no larger than the cutoff
+     */
+    uint count(const double inner, const double outer) const;
+
+    //! Squared distance between the atoms of a pair (periodic if a box was given)
+    double distance2(const Pair& p) const {
+      const GCoord& u = _first_atoms[p.first]->coords();
+      const GCoord& v = _second_atoms[p.second]->coords();
+      return(_periodic ? u.distance2(v, _box) : u.distance2(v));
+    }
+
+    double cutoff() const { return(_cutoff); }
+    double skin() const { return(_skin); }
+
+    //! Number of times the list has been built
+    uint builds() const { return(_builds); }
+
+    const AtomicGroup& first() const { return(_first); }
+    const AtomicGroup& second() const { return(_second); }
+
+  private:
+    void init();
+    bool needsRebuild(const bool periodic, const GCoord& box) const;
+    void build(const bool periodic, const GCoord& box);
+
+  private:
+    AtomicGroup _first, _second;
+    std::vector<const Atom*> _first_atoms, _second_atoms;   // Kept alive by the groups above
+    bool _self;
+    double _cutoff, _skin;
+
+    bool _periodic;
+    GCoord _box;                  // Current box, for distances
+    GCoord _ref_box;              // Box when last built
+
+    std::vector<Pair> _pairs;
+    std::vector<GCoord> _first_ref, _second_ref;   // Coordinates when last built
+    uint _builds;
+  };
+
+}
+
+
+#endif
@@ -5,9 +5,12 @@
 
 #include <ensembles.hpp>
 #include <alignment.hpp>
+#include <ThreadPool.hpp>
 
 #include <cmath>
 
+#include <boost/bind.hpp>
+
 
 namespace loos {
 
@@ -110,33 +113,188 @@ namespace loos {
 
 
 
-    // Return the RMSD only for a kabsch alignment between U and V assuming
-    // both are centered
-    double centeredRMSD(const vecDouble& U, const vecDouble& V) {
+    namespace {
+
+      // Eigenvector for the largest eigenvalue of the symmetric 4x4
+      // matrix K (overwritten).  Used by qcpRMSD() when the fast path
+      // cannot find the eigenvector.
+      void largestEigenvector4(double* K, double* q) {
+        char jobz = 'V', uplo = 'U';
+        f77int n = 4, lda = 4, lwork = 64, info;
+        double W[4], work[64];
 
-      int n = U.size();
+        dsyev_(&jobz, &uplo, &n, K, &lda, W, work, &lwork, &info);
+        if (info < 0)
+          throw(NumericalError("dsyev_ reported an argument error.", info));
+        if (info > 0)
+          throw(NumericalError("dsyev_ failed to converge.", info));
 
-      double ssu[3] = {0.0, 0.0, 0.0};
-      double ssv[3] = {0.0, 0.0, 0.0};
+        // Eigenvalues are in ascending order, so the last column
+        for (uint i=0; i<4; ++i)
+          q[i] = K[12 + i];
+      }
+
+    }
+
+
+    // Finds the largest eigenvalue of the key 4x4 matrix from the roots
+    // of its characteristic polynomial (Newton-Raphson, starting from
+    // the upper bound E0), then, if requested, the rotation from the
+    // corresponding eigenvector (quaternion).  Adapted from the
+    // reference implementation by Liu & Theobald.
+    double qcpRMSD(const double* A, const double E0, const uint n, double* rot) {
+      const double evalprec = 1e-11;
+      const double evecprec = 1e-6;
+      const double evalcheck = 1e-9;
+      const int maxiter = 50;
+
+      double Sxx = A[0], Sxy = A[1], Sxz = A[2];
+      double Syx = A[3], Syy = A[4], Syz = A[5];
+      double Szx = A[6], Szy = A[7], Szz = A[8];
+
+      double Sxx2 = Sxx * Sxx, Syy2 = Syy * Syy, Szz2 = Szz * Szz;
+      double Sxy2 = Sxy * Sxy, Syz2 = Syz * Syz, Sxz2 = Sxz * Sxz;
+      double Syx2 = Syx * Syx, Szy2 = Szy * Szy, Szx2 = Szx * Szx;
+
+      double SyzSzymSyySzz2 = 2.0 * (Syz * Szy - Syy * Szz);
+      double Sxx2Syy2Szz2Syz2Szy2 = Syy2 + Szz2 - Sxx2 + Syz2 + Szy2;
+
+      double C2 = -2.0 * (Sxx2 + Syy2 + Szz2 + Sxy2 + Syx2 + Sxz2 + Szx2 + Syz2 + Szy2);
+      double C1 = 8.0 * (Sxx*Syz*Szy + Syy*Szx*Sxz + Szz*Sxy*Syx - Sxx*Syy*Szz - Syz*Szx*Sxy - Szy*Syx*Sxz);
+
+      double SxzpSzx = Sxz + Szx, SyzpSzy = Syz + Szy, SxypSyx = Sxy + Syx;
+      double SyzmSzy = Syz - Szy, SxzmSzx = Sxz - Szx, SxymSyx = Sxy - Syx;
+      double SxxpSyy = Sxx + Syy, SxxmSyy = Sxx - Syy;
+      double Sxy2Sxz2Syx2Szx2 = Sxy2 + Sxz2 - Syx2 - Szx2;
+
+      double C0 = Sxy2Sxz2Syx2Szx2 * Sxy2Sxz2Syx2Szx2
+        + (Sxx2Syy2Szz2Syz2Szy2 + SyzSzymSyySzz2) * (Sxx2Syy2Szz2Syz2Szy2 - SyzSzymSyySzz2)
+        + (-(SxzpSzx)*(SyzmSzy) + (SxymSyx)*(SxxmSyy-Szz)) * (-(SxzmSzx)*(SyzpSzy) + (SxymSyx)*(SxxmSyy+Szz))
+        + (-(SxzpSzx)*(SyzpSzy) - (SxypSyx)*(SxxpSyy-Szz)) * (-(SxzmSzx)*(SyzmSzy) - (SxypSyx)*(SxxpSyy+Szz))
+        + (+(SxypSyx)*(SyzpSzy) + (SxzpSzx)*(SxxmSyy+Szz)) * (-(SxymSyx)*(SyzmSzy) + (SxzpSzx)*(SxxpSyy+Szz))
+        + (+(SxypSyx)*(SyzmSzy) + (SxzmSzx)*(SxxmSyy-Szz)) * (-(SxymSyx)*(SyzpSzy) + (SxzmSzx)*(SxxpSyy-Szz));
+
+      double lambda = E0;
+      for (int i=0; i<maxiter; ++i) {
+        double old = lambda;
+        double x2 = lambda * lambda;
+        double b = (x2 + C2) * lambda;
+        double a = b + C1;
+        double slope = 2.0 * x2 * lambda + b + a;
+        if (slope == 0.0)     // Sitting on a repeated root (e.g. linear structures)
+          break;
+        lambda -= (a * lambda + C0) / slope;
+        if (std::fabs(lambda - old) < std::fabs(evalprec * lambda))
+          break;
+      }
 
-      for (int j=0; j<n; j += 3) {
-        for (uint i=0; i<3; ++i) {
-          ssu[i] += U[j+i] * U[j+i];
-          ssv[i] += V[j+i] * V[j+i];
+      double rms = std::sqrt(std::fabs(2.0 * (E0 - lambda) / n));
+      if (rot == 0)
+        return(rms);
+
+      // The eigenvector is a column of the adjoint of (K - lambda I).
+      // Try each column in turn in case one is degenerate.
+      double a11 = SxxpSyy + Szz - lambda, a12 = SyzmSzy, a13 = -SxzmSzx, a14 = SxymSyx;
+      double a21 = SyzmSzy, a22 = SxxmSyy - Szz - lambda, a23 = SxypSyx, a24 = SxzpSzx;
+      double a31 = a13, a32 = a23, a33 = Syy - Sxx - Szz - lambda, a34 = SyzpSzy;
+      double a41 = a14, a42 = a24, a43 = a34, a44 = Szz - SxxpSyy - lambda;
+
+      double a3344_4334 = a33 * a44 - a43 * a34, a3244_4234 = a32 * a44 - a42 * a34;
+      double a3243_4233 = a32 * a43 - a42 * a33, a3143_4133 = a31 * a43 - a41 * a33;
+      double a3144_4134 = a31 * a44 - a41 * a34, a3142_4132 = a31 * a42 - a41 * a32;
+
+      double q1 =  a22 * a3344_4334 - a23 * a3244_4234 + a24 * a3243_4233;
+      double q2 = -a21 * a3344_4334 + a23 * a3144_4134 - a24 * a3143_4133;
+      double q3 =  a21 * a3244_4234 - a22 * a3144_4134 + a24 * a3142_4132;
+      double q4 = -a21 * a3243_4233 + a22 * a3143_4133 - a23 * a3142_4132;
+      double qsqr = q1*q1 + q2*q2 + q3*q3 + q4*q4;
+
+      if (qsqr < evecprec) {
+        q1 =  a12 * a3344_4334 - a13 * a3244_4234 + a14 * a3243_4233;
+        q2 = -a11 * a3344_4334 + a13 * a3144_4134 - a14 * a3143_4133;
+        q3 =  a11 * a3244_4234 - a12 * a3144_4134 + a14 * a3142_4132;
+        q4 = -a11 * a3243_4233 + a12 * a3143_4133 - a13 * a3142_4132;
+        qsqr = q1*q1 + q2*q2 + q3*q3 + q4*q4;
+
+        if (qsqr < evecprec) {
+          double a1324_1423 = a13 * a24 - a14 * a23, a1224_1422 = a12 * a24 - a14 * a22;
+          double a1223_1322 = a12 * a23 - a13 * a22, a1124_1421 = a11 * a24 - a14 * a21;
+          double a1123_1321 = a11 * a23 - a13 * a21, a1122_1221 = a11 * a22 - a12 * a21;
+
+          q1 =  a42 * a1324_1423 - a43 * a1224_1422 + a44 * a1223_1322;
+          q2 = -a41 * a1324_1423 + a43 * a1124_1421 - a44 * a1123_1321;
+          q3 =  a41 * a1224_1422 - a42 * a1124_1421 + a44 * a1122_1221;
+          q4 = -a41 * a1223_1322 + a42 * a1123_1321 - a43 * a1122_1221;
+          qsqr = q1*q1 + q2*q2 + q3*q3 + q4*q4;
+
+          if (qsqr < evecprec) {
+            q1 =  a32 * a1324_1423 - a33 * a1224_1422 + a34 * a1223_1322;
+            q2 = -a31 * a1324_1423 + a33 * a1124_1421 - a34 * a1123_1321;
+            q3 =  a31 * a1224_1422 - a32 * a1124_1421 + a34 * a1122_1221;
+            q4 = -a31 * a1223_1322 + a32 * a1123_1321 - a33 * a1122_1221;
+            qsqr = q1*q1 + q2*q2 + q3*q3 + q4*q4;
+
+            if (qsqr < evecprec)
+              qsqr = 0.0;
+          }
         }
       }
 
-      n /= 3;
+      // For near-degenerate K (e.g. linear or planar structures), every
+      // column may vanish, or the one that passed above may be mostly
+      // round-off.  Check that q really is an eigenvector for lambda,
+      // i.e. q'(K - lambda I)q ~ 0, and otherwise solve for it directly.
+      if (qsqr > 0.0) {
+        double r = a11 * q1 * q1 + a22 * q2 * q2 + a33 * q3 * q3 + a44 * q4 * q4
+          + 2.0 * (a12 * q1 * q2 + a13 * q1 * q3 + a14 * q1 * q4 + a23 * q2 * q3 + a24 * q2 * q4 + a34 * q3 * q4);
+        if (r < -evalcheck * E0 * qsqr)
+          qsqr = 0.0;
+      }
+
+      if (qsqr == 0.0) {
+        double K[16] = { a11 + lambda, a12, a13, a14,
+                         a21, a22 + lambda, a23, a24,
+                         a31, a32, a33 + lambda, a34,
+                         a41, a42, a43, a44 + lambda };
+        double q[4];
+        largestEigenvector4(K, q);
+        q1 = q[0];
+        q2 = q[1];
+        q3 = q[2];
+        q4 = q[3];
+        qsqr = q1*q1 + q2*q2 + q3*q3 + q4*q4;
+      }
 
-      double E0 = ssu[0] + ssu[1] + ssu[2] + ssv[0] + ssv[1] + ssv[2];
+      double normq = std::sqrt(qsqr);
+      q1 /= normq;
+      q2 /= normq;
+      q3 /= normq;
+      q4 /= normq;
+
+      double a2 = q1 * q1, x2 = q2 * q2, y2 = q3 * q3, z2 = q4 * q4;
+      double xy = q2 * q3, az = q1 * q4, zx = q4 * q2;
+      double ay = q1 * q3, yz = q3 * q4, ax = q1 * q2;
+
+      // This is the rotation taking V onto U, so store its transpose
+      rot[0] = a2 + x2 - y2 - z2;
+      rot[3] = 2 * (xy + az);
+      rot[6] = 2 * (zx - ay);
+      rot[1] = 2 * (xy - az);
+      rot[4] = a2 - x2 + y2 - z2;
+      rot[7] = 2 * (yz + ax);
+      rot[2] = 2 * (zx + ay);
+      rot[5] = 2 * (yz - ax);
+      rot[8] = a2 - x2 - y2 + z2;
+
+      return(rms);
+    }
 
-      SVDTupleVec svd = kabschCore(U, V);
 
-      vecDouble S(boost::get<1>(svd));
-      double ss = S[0] + S[1] + S[2];
-      double rmsd = std::sqrt(std::abs(E0-2.0*ss)/n);
 
-      return(rmsd);
+    // Return the RMSD only for a kabsch alignment between U and V assuming
+    // both are centered
+    double centeredRMSD(const vecDouble& U, const vecDouble& V) {
+      return(qcpCenteredRMSD(U.data(), V.data(), U.size() / 3));
     }
 
 
@@ -145,34 +303,13 @@ namespace loos {
     // Both will be centered first.
     double alignedRMSD(const vecDouble& U, const vecDouble& V) {
 
-      int n = U.size();
-
       vecDouble cU(U);
       vecDouble cV(V);
 
       centerAtOrigin(cU);
       centerAtOrigin(cV);
 
-      SVDTupleVec svd = kabschCore(cU, cV);
-
-      double ssu[3] = {0.0, 0.0, 0.0};
-      double ssv[3] = {0.0, 0.0, 0.0};
-
-      for (int j=0; j<n; j += 3) {
-        for (uint i=0; i<3; ++i) {
-          ssu[i] += cU[j+i] * cU[j+i];
-          ssv[i] += cV[j+i] * cV[j+i];
-        }
-      }
-
-      n /= 3;
-
-      double E0 = ssu[0] + ssu[1] + ssu[2] + ssv[0] + ssv[1] + ssv[2];
-
-      vecDouble S(boost::get<1>(svd));
-      double ss = S[0] + S[1] + S[2];
-      double rmsd = std::sqrt(std::abs(E0-2.0*ss)/n);
-      return(rmsd);
+      return(qcpCenteredRMSD(cU.data(), cV.data(), cU.size() / 3));
     }
 
 
@@ -181,29 +318,10 @@ namespace loos {
     // Kabsch alignment between U and V, assuming both are centered.
     // Returns the tranformation matrix to align U onto V.
     GMatrix kabschCentered(const vecDouble& U, const vecDouble& V) {
-      SVDTupleVec svd = kabschCore(U, V);
-
-      vecDouble R(boost::get<0>(svd));
-      vecDouble VV(boost::get<2>(svd));
-
-      double M[9];
+      double A[9], M[9];
+      double E0 = qcpInnerProduct(U.data(), V.data(), U.size() / 3, A);
+      qcpRMSD(A, E0, U.size() / 3, M);
 
-#if defined(__linux__) || defined(__CYGWIN__) || defined(__FreeBSD__)
-      char ta = 'N';
-      char tb = 'T';
-      f77int three = 3;
-      double one = 1.0;
-      double zero = 0.0;
-
-      dgemm_(&ta, &tb, &three, &three, &three, &one, R.data(), &three, VV.data(), &three, &zero, M, &three);
-
-#else
-
-      cblas_dgemm(CblasColMajor, CblasNoTrans, CblasTrans, 3, 3, 3, 1.0, R.data(), 3, VV.data(), 3, 0.0, M, 3);
-
-#endif
-
-      // Construct the new transformation matrix...  (W = M')
       GMatrix Z;
       for (uint i=0; i<3; i++)
         for (uint j=0; j<3; j++)
@@ -404,6 +522,107 @@ namespace loos {
   }
 
 
+  namespace {
+
+    // Number of blocks the frames are split into for each iteration
+    const ulong alignment_blocks = 64;
+
+
+    // Aligns a block of frames onto the current target, returning the
+    // sum of the aligned coordinates for the average
+    struct AlignmentBlock {
+      AlignmentBlock(const FrameBuffer& f, const alignment::vecDouble& t, std::vector<XForm>& x)
+        : frames(f), target(t), xforms(x)
+      { }
+
+      alignment::vecDouble operator()(const ulong begin, const ulong end) const {
+        using namespace alignment;
+
+        uint n = target.size();
+        vecDouble u(n);
+        vecDouble sum(n, 0.0);
+
+        for (ulong i=begin; i<end; ++i) {
+          const float* p = frames.frame(i);
+          for (uint j=0; j<n; ++j)
+            u[j] = p[j];
+
+          GMatrix M = kabsch(u, target);
+          xforms[i].load(M);
+          applyTransform(M, u);
+          for (uint j=0; j<n; ++j)
+            sum[j] += u[j];
+        }
+
+        return(sum);
+      }
+
+      const FrameBuffer& frames;
+      const alignment::vecDouble& target;
+      std::vector<XForm>& xforms;      // Each block only writes its own frames
+    };
+
+
+    struct SumCoords {
+      alignment::vecDouble operator()(alignment::vecDouble a, const alignment::vecDouble& b) const {
+        for (uint j=0; j<a.size(); ++j)
+          a[j] += b[j];
+        return(a);
+      }
+    };
+
+  }
+
+
+  boost::tuple<std::vector<XForm>, greal, int> iterativeAlignment(const FrameBuffer& frames,
+                                                                  greal threshold, int maxiter,
+                                                                  uint nthreads) {
+    using namespace alignment;
+
+    uint nf = frames.nframes();
+    if (nf == 0)
+      throw(LOOSError("Cannot align an empty set of frames"));
+
+    boost::shared_ptr<ThreadPool> pool = ThreadPool::select(nthreads);
+
+    uint n = frames.natoms() * 3;
+    std::vector<XForm> xforms(nf);
+
+    vecDouble target(frames.frame(0), frames.frame(0) + n);
+    centerAtOrigin(target);
+
+    // The partial sums are combined in block order, so the average is
+    // summed the same way every iteration
+    ulong grain = (nf + alignment_blocks - 1) / alignment_blocks;
+
+    greal rms;
+    int iter = 0;
+    do {
+      vecDouble avg = pool->parallelReduce(0, nf, vecDouble(n, 0.0), AlignmentBlock(frames, target, xforms),
+                                           SumCoords(), grain);
+      for (uint j=0; j<n; ++j)
+        avg[j] /= nf;
+
+      rms = rmsd(target, avg);
+      target = avg;
+      ++iter;
+    } while (rms > threshold && iter <= maxiter);
+
+    boost::tuple<std::vector<XForm>, greal, int> res(xforms, rms, iter);
+    return(res);
+  }
+
+
+  boost::tuple<std::vector<XForm>, greal, int> bufferedIterativeAlignment(const AtomicGroup& model,
+                                                                          pTraj& traj,
+                                                                          const std::vector<uint>& frame_indices,
+                                                                          greal threshold, int maxiter,
+                                                                          uint nthreads, ulong memory_budget) {
+    FrameBuffer frames(model, traj, frame_indices, memory_budget);
+    return(iterativeAlignment(frames, threshold, maxiter, nthreads));
+  }
+
+
   boost::tuple<std::vector<XForm>, greal, int> iterativeAlignment(const AtomicGroup& g,
                                                                   pTraj& traj,
                                                                   greal threshold, int maxiter) {
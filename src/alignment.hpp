@@ -32,6 +32,7 @@
 #include <MatrixOps.hpp>
 
 #include <XForm.hpp>
+#include <FrameBuffer.hpp>
 
 
 namespace loos {
@@ -54,6 +55,61 @@ namespace loos {
                 double rmsd(const vecDouble& u, const vecDouble& v);
 
 
+                //! Inner product for QCP superposition of centered coordinates
+                /**
+                 * Computes the 3x3 correlation matrix \a A (row-major,
+                 * A[3*i+j] = sum U_i * V_j) and the sum of the squared
+                 * norms of \a U and \a V in a single pass over the \a n
+                 * atoms.  Coordinates are packed xyz, as in vecDouble, and
+                 * may be floats or doubles; sums are always accumulated
+                 * as doubles.  Returns E0 = (|U|^2 + |V|^2) / 2.
+                 */
+                template<typename T>
+                double qcpInnerProduct(const T* U, const T* V, const uint n, double* A) {
+                  double a0 = 0, a1 = 0, a2 = 0, a3 = 0, a4 = 0, a5 = 0, a6 = 0, a7 = 0, a8 = 0;
+                  double g = 0;
+
+                  for (uint k=0; k<3*n; k += 3) {
+                    double ux = U[k], uy = U[k+1], uz = U[k+2];
+                    double vx = V[k], vy = V[k+1], vz = V[k+2];
+
+                    g += ux*ux + uy*uy + uz*uz + vx*vx + vy*vy + vz*vz;
+
+                    a0 += ux * vx;  a1 += ux * vy;  a2 += ux * vz;
+                    a3 += uy * vx;  a4 += uy * vy;  a5 += uy * vz;
+                    a6 += uz * vx;  a7 += uz * vy;  a8 += uz * vz;
+                  }
+
+                  A[0] = a0; A[1] = a1; A[2] = a2;
+                  A[3] = a3; A[4] = a4; A[5] = a5;
+                  A[6] = a6; A[7] = a7; A[8] = a8;
+
+                  return(g / 2.0);
+                }
+
+
+                //! RMSD after optimal superposition, using Theobald's QCP method
+                /**
+                 * Takes the output of qcpInnerProduct() for \a n atoms.
+                 * If \a rot is non-null, the rotation (row-major) that
+                 * superimposes U onto V is also computed.  Otherwise, only
+                 * the RMSD is computed, which is considerably cheaper.
+                 *
+                 * See Theobald, Acta Cryst. A61:478-480 (2005) and Liu,
+                 * Agrafiotis & Theobald, J. Comput. Chem. 31:1561-1563
+                 * (2010).
+                 */
+                double qcpRMSD(const double* A, const double E0, const uint n, double* rot = 0);
+
+                //! RMSD only, for centered U and V (packed xyz)
+                template<typename T>
+                double qcpCenteredRMSD(const T* U, const T* V, const uint n) {
+                  double A[9];
+                  double E0 = qcpInnerProduct(U, V, n, A);
+                  return(qcpRMSD(A, E0, n));
+                }
+
+
         }
 
 #if !defined(SWIG)
@@ -87,6 +143,40 @@ namespace loos {
                                                                       greal threshold=1e-6,
                                                                       int maxiter=1000);
 
+
+        //! Iterative superposition of frames already held in a FrameBuffer
+        /**
+         * This is the same algorithm as the trajectory-based
+         * iterativeAlignment(), but each iteration works from the
+         * buffer rather than re-reading the trajectory.  The frames in
+         * an iteration are split into fixed blocks that are aligned in
+         * parallel on a ThreadPool (see ThreadPool::select(); 0 means
+         * the shared pool), each keeping its own partial sum for the
+         * average structure.  The blocks do not depend on the number of
+         * threads, so neither do the results.
+         */
+        boost::tuple<std::vector<XForm>,greal,int> iterativeAlignment(const FrameBuffer& frames,
+                                                                      greal threshold=1e-6,
+                                                                      int maxiter=1000,
+                                                                      uint nthreads=0);
+
+        //! Iterative superposition that only reads the trajectory once
+        /**
+         * Reads \p model for each frame in \p frame_indices into a
+         * FrameBuffer (spilling to a temporary file if it would use
+         * more than \p memory_budget bytes), then aligns using the
+         * FrameBuffer version of iterativeAlignment().  Results match
+         * the trajectory-based iterativeAlignment() to within
+         * single-precision round-off.
+         */
+        boost::tuple<std::vector<XForm>,greal,int> bufferedIterativeAlignment(const AtomicGroup& model,
+                                                                              pTraj& traj,
+                                                                              const std::vector<uint>& frame_indices,
+                                                                              greal threshold=1e-6,
+                                                                              int maxiter=1000,
+                                                                              uint nthreads=0,
+                                                                              ulong memory_budget = FrameBuffer::default_memory_budget);
+
         
 #endif // !defined(SWIG)
 }
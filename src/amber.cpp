@@ -205,8 +205,9 @@ namespace loos {
     mbona = pointers[3];
     nres = pointers[11];
 
+    AtomFactory factory(natoms);
     for (uint i=0; i<natoms; i++) {
-      pAtom pa(new Atom);
+      pAtom pa = factory.create();
       pa->id(i+1);
       pa->index(i);
       atoms.push_back(pa);
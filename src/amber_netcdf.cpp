@@ -102,28 +102,51 @@ namespace loos {
 	}
 
 
+	// Reads the per-atom triplets for the given variable (i.e. coords or
+	// velocities).  If an atom subset is set, then only the hyperslabs
+	// covering the subset are read.
+	void AmberNetcdf::readAtomData(const int varid, GCoord::element_type* data, const uint frameno, const std::string& what) {
+		size_t start[3] = {0, 0, 0};
+		size_t count[3] = {1, 1, 3};
+
+		start[0] = frameno;
+
+		if (_subset_runs.empty()) {
+			count[1] = _natoms;
+			int retval = VarTypeDecider<GCoord::element_type>::read(_ncid, varid, start, count, data);
+			if (retval)
+				throw(FileReadError(_filename, "Cannot read Amber netcdf frame (" + what + ")", retval));
+			return;
+		}
+
+		for (std::vector<IndexRun>::const_iterator i = _subset_runs.begin(); i != _subset_runs.end(); ++i) {
+			start[1] = i->first;
+			count[1] = i->second;
+			int retval = VarTypeDecider<GCoord::element_type>::read(_ncid, varid, start, count, data + i->first * 3);
+			if (retval)
+				throw(FileReadError(_filename, "Cannot read Amber netcdf frame (" + what + ")", retval));
+		}
+	}
+
+
+	void AmberNetcdf::atomSubsetChangedImpl() {
+		_subset_runs = atomSubsetRuns(256);
+	}
+
+
 	// Given a frame number, read the coord data into the internal array
 	// and retrieve the corresponding periodic box (if present)
 	void AmberNetcdf::readRawFrame(const uint frameno)  {
 		size_t start[3] = {0, 0, 0};
 		size_t count[3] = {1, 1, 3};
 
-
-		// Read coordinates first...
 		start[0] = frameno;
-		count[1] = _natoms;
 
-
-		int retval = VarTypeDecider<GCoord::element_type>::read(_ncid, _coord_id, start, count, _coord_data);
-		if (retval)
-			throw(FileReadError(_filename, "Cannot read Amber netcdf frame (coords)", retval));
+		// Read coordinates first...
+		readAtomData(_coord_id, _coord_data, frameno, "coords");
 
 		if (_velocities)
-		{
-			retval = VarTypeDecider<GCoord::element_type>::read(_ncid, _velocities_id, start, count, _velocity_data);
-			if (retval)
-				throw(FileReadError(_filename, "Cannot read Amber netcdf frame (velocities)", retval));
-		}
+			readAtomData(_velocities_id, _velocity_data, frameno, "velocities");
 
 
 		// Now get box if present...
@@ -131,7 +154,7 @@ namespace loos {
 			start[1] = 0;
 			count[1] = 3;
 
-			retval = VarTypeDecider<GCoord::element_type>::read(_ncid, _cell_lengths_id, start, count, _box_data);
+			int retval = VarTypeDecider<GCoord::element_type>::read(_ncid, _cell_lengths_id, start, count, _box_data);
 			if (retval)
 				throw(FileReadError(_filename, "Cannot read Amber netcdf periodic box", retval));
 		}
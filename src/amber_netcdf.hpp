@@ -64,6 +64,10 @@ namespace loos {
 
 
 	//! Class for reading Amber Trajectories in NetCDF format
+	/**
+	 * If an atom subset is registered (see Trajectory::setAtomSubset()),
+	 * only the hyperslabs covering those atoms are read for each frame.
+	 */
 	class AmberNetcdf : public Trajectory {
 	public:
 
@@ -130,6 +134,8 @@ namespace loos {
 		void readGlobalAttributes();
 		std::string readGlobalAttribute(const std::string& name);
 		void readRawFrame(const uint frameno);
+		void readAtomData(const int varid, GCoord::element_type* data, const uint frameno, const std::string& what);
+		void atomSubsetChangedImpl();
 
 		void updateGroupCoordsImpl(AtomicGroup& g);
 		void updateGroupVelocitiesImpl(AtomicGroup& g);
@@ -156,6 +162,7 @@ namespace loos {
 		int _cell_lengths_id;
 		int _velocities_id;
 		std::string _title, _application, _program, _programVersion, _conventions, _conventionVersion;
+		std::vector<IndexRun> _subset_runs;
 	};
 
 
@@ -23,96 +23,276 @@
 
 #include <amber_traj.hpp>
 #include <AtomicGroup.hpp>
-#include <iomanip>
-#include <sstream>
+#include <trajindex.hpp>
+
+#include <cstdlib>
+#include <cstring>
 
 namespace loos {
 
-  // Scan the trajectory file to determine frame sizes and box
-  void AmberTraj::init(void) {
-    char buf[1024];
+  namespace {
 
-    ifs->getline(buf, 1024);
-    frame_offset = ifs->tellg();
-    greal x, y, z;
+    // Amber writes coordinates as 10F8.3, i.e. 10 fields of 8
+    // characters per line
+    const uint field_width = 8;
+    const uint fields_per_line = 10;
+
+    // Block size used when scanning for frame boundaries
+    const uint scan_block_size = 4 * 1024 * 1024;
 
-    for (uint i=0; i<_natoms; i++) {
-      *(ifs) >> std::setw(8) >> x >> std::setw(8) >> y >> std::setw(8) >> z;
-      frame.push_back(GCoord(x,y,z));
+    const double powers_of_ten[] = { 1.0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+                                     1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+
+    inline bool isBlank(const char c) {
+      return(c == ' ' || c == '\t' || c == '\r');
     }
 
 
-    // This is probably not a good way of doing this???
-    ifs->getline(buf, 1024);
-    unsigned long fpos = ifs->tellg();
+    // Parses a single fixed-width field in [p, end).  Plain decimals
+    // (e.g. "-123.456") are handled directly, giving the same
+    // correctly-rounded result as strtod().  Anything else is handed
+    // off to strtod().  Returns false if the field is not a number.
+    bool parseField(const char* p, const char* end, double& value) {
+      while (p < end && isBlank(*p))
+        ++p;
+
+      bool negative = false;
+      if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+      }
+
+      const char* start = p;
+      unsigned long long mantissa = 0;
+      uint ndigits = 0, nfrac = 0;
+      for (; p < end && *p >= '0' && *p <= '9'; ++p, ++ndigits)
+        mantissa = mantissa * 10 + (*p - '0');
+      if (p < end && *p == '.')
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p, ++ndigits, ++nfrac)
+          mantissa = mantissa * 10 + (*p - '0');
+
+      const char* q = p;
+      while (q < end && isBlank(*q))
+        ++q;
+
+      if (q == end && ndigits > 0 && ndigits <= 15) {
+        value = static_cast<double>(mantissa) / powers_of_ten[nfrac];
+        if (negative)
+          value = -value;
+        return(true);
+      }
+
+      // Fall back to the slow path (exponents, etc)
+      char buf[64];
+      uint n = end - start + (negative ? 1 : 0);
+      if (p == start || n >= sizeof(buf))
+        return(false);
+      char* b = buf;
+      if (negative)
+        *b++ = '-';
+      memcpy(b, start, end - start);
+      buf[n] = '\0';
+
+      char* stop;
+      value = strtod(buf, &stop);
+      while (isBlank(*stop))
+        ++stop;
+      return(stop != buf && *stop == '\0');
+    }
 
-    ifs->getline(buf, 1024);
-    if (ifs->fail())
-      throw(FileOpenError(_filename, "Problem scanning Amber Trajectory"));
 
-    std::stringstream ss(buf);
-    double a= -1, b= -1, c= -1;
-    ss >> std::setw(8) >> a >> std::setw(8) >> b >> std::setw(8) >> c;
-    if (ss.eof()) {
-      fpos = ifs->tellg();
-      periodic = true;
-      box = GCoord(a, b, c);
+    // Parses up to n fixed-width fields from the line in [p, eol),
+    // returning the number actually found.  Parsing stops at the end
+    // of the line or at the first blank field.
+    uint parseLine(const char* p, const char* eol, double* values, const uint n, const std::string& fname) {
+      uint k = 0;
+      while (k < n && p < eol) {
+        const char* fend = (eol - p > static_cast<long>(field_width)) ? p + field_width : eol;
+
+        const char* q = p;
+        while (q < fend && isBlank(*q))
+          ++q;
+        if (q == fend)
+          break;
+
+        if (!parseField(p, fend, values[k]))
+          throw(FileReadError(fname, "Cannot parse coordinate '" + std::string(p, fend) + "' in Amber trajectory"));
+        ++k;
+        p = fend;
+      }
+
+      return(k);
     }
 
-    frame_size = fpos - frame_offset;
 
-    // Now try to count the number of frames...
-    _nframes = 1;
-    double dummy;
-    while (!ifs->fail()) {
-      ++_nframes;
-      fpos = _nframes * frame_size + frame_offset;
-      ifs->seekg(fpos);
-      *(ifs) >> dummy;
+    // Returns the end of the line starting at p (i.e. the newline, or
+    // end if there is none)
+    inline const char* endOfLine(const char* p, const char* end) {
+      const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+      return(eol == 0 ? end : eol);
     }
 
+  }
 
-    ifs->clear();
-    ifs->seekg(frame_offset + frame_size);
 
-    // Punt our failure check to the end...for now...
+
+  // Determines the layout of a frame (and whether or not there is a
+  // periodic box) from the first frame, then locates all frames
+  void AmberTraj::init(void) {
+    std::string line;
+
+    ifs->seekg(0, std::ios_base::end);
+    file_size = ifs->tellg();
+    ifs->seekg(0);
+
+    std::getline(*ifs, line);      // Title
+    frame_offset = ifs->tellg();
+    if (ifs->fail())
+      throw(FileOpenError(_filename, "Problem scanning Amber Trajectory"));
+
+    coord_lines = (3 * _natoms + fields_per_line - 1) / fields_per_line;
+    for (uint i=0; i<coord_lines; ++i)
+      std::getline(*ifs, line);
     if (ifs->fail())
+      throw(FileOpenError(_filename, "Problem scanning Amber Trajectory"));
+
+    // The line following the coordinates is either a periodic box
+    // (three fields) or the start of the next frame
+    std::getline(*ifs, line);
+    if (!ifs->fail()) {
+      double values[fields_per_line];
+      uint n = parseLine(line.data(), line.data() + line.size(), values, fields_per_line, _filename);
+      if (n == 3) {
+        periodic = true;
+        box = GCoord(values[0], values[1], values[2]);
+      }
+    }
+
+    ifs->clear();
+    scanFrames();
+
+    _nframes = frame_indices.size();
+    if (_nframes == 0)
       throw(FileOpenError(_filename, "Cannot determine frame information for Amber trajectory"));
 
+    frame.resize(_natoms);
+    next_frame = 0;
+    parseFrame();
     cached_first = true;
   }
 
 
-  bool AmberTraj::parseFrame(void) {
-    greal x, y, z;
+  // Finds the start of each frame by counting lines, reading the file
+  // in large blocks.  Only complete frames are included.  If a valid
+  // on-disk index exists for this trajectory, it is used instead and
+  // no scan is necessary.
+  void AmberTraj::scanFrames(void) {
+    frame_indices.clear();
+
+    bool use_index = (_filename != "istream");
+    internal::TrajectoryFrameIndex index(_filename, "AMBER");
+    if (use_index) {
+      // The index is only valid for the same number of atoms, since
+      // that determines the frame size...
+      if (index.load() && !index.empty() && index[0].natoms == _natoms) {
+        frame_indices = index.offsets();
+        return;
+      }
+      index.clear();
+      index.stamp();
+    }
 
-    if (ifs->eof())
-      return(false);
+    uint lines_per_frame = coord_lines + (periodic ? 1 : 0);
+    uint nlines = 0;
+    size_t pos = frame_offset;
+    size_t line_start = pos;
+    std::vector<char> block(scan_block_size);
+
+    ifs->seekg(pos);
+    while (true) {
+      ifs->read(&block[0], scan_block_size);
+      std::streamsize n = ifs->gcount();
+      if (n <= 0)
+        break;
+
+      const char* end = &block[0] + n;
+      for (const char* p = &block[0]; p < end; ) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (eol == 0)
+          break;
+        if (nlines % lines_per_frame == 0)
+          frame_indices.push_back(line_start);
+        ++nlines;
+        line_start = pos + (eol - &block[0]) + 1;
+        p = eol + 1;
+      }
+      pos += n;
+    }
 
-    // It seems that it's possible that, at the end of the trajectory,
-    // we may have read the last datum from the last frame but will not
-    // be physically at the EOF.  So, we also check inside the coord
-    // read loop to see if there is an EOF.  Rather than flag this as an
-    // error condition, just return a false indicating we've read past
-    // the end...
+    // A final line that is missing its newline...
+    if (line_start < pos) {
+      if (nlines % lines_per_frame == 0)
+        frame_indices.push_back(line_start);
+      ++nlines;
+    }
 
-    for (uint i=0; i<_natoms && !(ifs->eof()); i++) {
-      *(ifs) >> std::setw(8) >> x >> std::setw(8) >> y >> std::setw(8) >> z;
-      frame[i] = GCoord(x, y, z);
+    // Drop any incomplete frame at the end
+    if (nlines % lines_per_frame != 0)
+      frame_indices.pop_back();
+
+    ifs->clear();
+    if (!use_index)
+      return;
+
+    for (std::vector<size_t>::const_iterator i = frame_indices.begin(); i != frame_indices.end(); ++i) {
+      internal::TrajectoryFrameIndex::Frame f;
+      f.offset = *i;
+      f.natoms = _natoms;
+      index.push_back(f);
     }
+    index.save();
+  }
 
-    if (ifs->eof())
+
+  bool AmberTraj::parseFrame(void) {
+    if (next_frame >= frame_indices.size())
       return(false);
 
-    if (periodic) {
-      greal a, b, c;
-      *(ifs) >> std::setw(8) >> a >> std::setw(8) >> b >> std::setw(8) >> c;
-      box = GCoord(a, b, c);
+    size_t start = frame_indices[next_frame];
+    size_t end = (next_frame + 1 < frame_indices.size()) ? frame_indices[next_frame + 1] : file_size;
+    size_t n = end - start;
+
+    readbuf.resize(n + 1);
+    ifs->clear();
+    ifs->seekg(start);
+    ifs->read(&readbuf[0], n);
+    if (static_cast<size_t>(ifs->gcount()) != n)
+      throw(FileReadError(_filename, "Problem reading from Amber trajectory"));
+
+    const char* p = &readbuf[0];
+    const char* bufend = p + n;
+    double values[fields_per_line];
+    uint k = 0, nvalues = 3 * _natoms;
+
+    for (uint j=0; j<coord_lines; ++j) {
+      const char* eol = endOfLine(p, bufend);
+      uint m = parseLine(p, eol, values, fields_per_line < nvalues - k ? fields_per_line : nvalues - k, _filename);
+      for (uint l=0; l<m; ++l, ++k)
+        frame[k / 3][k % 3] = values[l];
+      p = (eol < bufend) ? eol + 1 : eol;
     }
 
-    if (ifs->fail())
+    if (k != nvalues)
       throw(FileReadError(_filename, "Problem reading from Amber trajectory"));
 
+    if (periodic) {
+      const char* eol = endOfLine(p, bufend);
+      if (parseLine(p, eol, values, 3, _filename) != 3)
+        throw(FileReadError(_filename, "Problem reading periodic box from Amber trajectory"));
+      box = GCoord(values[0], values[1], values[2]);
+    }
+
+    ++next_frame;
     return(true);
   }
 
@@ -120,17 +300,11 @@ namespace loos {
   void AmberTraj::seekFrameImpl(const uint i) {
 
     cached_first = false;
-    unsigned long fpos = i * frame_size + frame_offset;
     if (i >= _nframes)
       throw(FileError(_filename, "Attempting seek frame beyond end of trajectory"));
 
-
-    ifs->seekg(fpos);
-    if (ifs->fail())
-      throw(FileError(_filename, "Cannot seek to frame"));
+    next_frame = i;
   }
-
-
   void AmberTraj::updateGroupCoordsImpl(AtomicGroup& g) {
 
     for (AtomicGroup::iterator i = g.begin(); i != g.end(); ++i) {
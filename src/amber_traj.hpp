@@ -24,6 +24,7 @@
 
 
 #include <string>
+#include <vector>
 
 #include <loos_defs.hpp>
 #include <Coord.hpp>
@@ -43,16 +44,27 @@ namespace loos {
    *
    * Note that the Amber timestep is (presumably) defined in the parmtop
    * file, not in the trajectory file.  So we return a null-value here...
+   *
+   * Each frame is read from the file in a single block and the
+   * fixed-width (10F8.3) fields are parsed directly, rather than
+   * through iostream extraction.  The byte offset of every frame is
+   * found by counting lines when the trajectory is opened, so any
+   * frame can be read directly.  Since that scan requires reading the
+   * entire file, the offsets are cached on disk (see
+   * internal::TrajectoryFrameIndex) and reused the next time the
+   * trajectory is opened.
    */
 
   class AmberTraj : public Trajectory {
   public:
     explicit AmberTraj(const std::string& s, const int na) : Trajectory(s),
                                                              _natoms(na), frame_offset(0),
-                                                             frame_size(0), periodic(false) { init(); }
+                                                             file_size(0), coord_lines(0),
+                                                             next_frame(0), periodic(false) { init(); }
 
     explicit AmberTraj(std::istream& is, const int na) : Trajectory(is), _natoms(na),
-                                                     frame_offset(0), frame_size(0),
+                                                     frame_offset(0), file_size(0),
+                                                     coord_lines(0), next_frame(0),
                                                      periodic(false) { init(); }
 
     std::string description() const { return("Amber trajectory"); }
@@ -82,7 +94,8 @@ namespace loos {
 
   private:
     void init(void);
-    virtual void rewindImpl(void) { ifs->clear(); ifs->seekg(frame_offset); }
+    void scanFrames(void);
+    virtual void rewindImpl(void) { next_frame = 0; }
     virtual void seekNextFrameImpl(void) { }
     virtual void seekFrameImpl(const uint);
     virtual void updateGroupCoordsImpl(AtomicGroup&);
@@ -90,10 +103,14 @@ namespace loos {
 
   private:
     uint _natoms, _nframes;
-    unsigned long frame_offset, frame_size;
+    unsigned long frame_offset, file_size;
+    uint coord_lines;                      // Lines of coordinates per frame
+    uint next_frame;
     bool periodic;
     GCoord box;
     std::vector<GCoord> frame;
+    std::vector<size_t> frame_indices;
+    std::vector<char> readbuf;
 
   };
 
@@ -85,6 +85,7 @@ selectAtoms;
 %catches(loos::LOOSError) AtomicGroup::deleteAtom;
 %catches(std::out_of_range) AtomicGroup::subset;
 %catches(std::out_of_range) AtomicGroup::excise;
+%catches(std::out_of_range) AtomicGroup::subsetView;
 %catches(loos::LOOSError) AtomicGroup::reimage;
 %catches(loos::LOOSError) AtomicGroup::reimageByAtom;
 %catches(loos::LOOSError) AtomicGroup::mergeImage;
@@ -111,6 +112,7 @@ selectAtoms;
 // dcd
 %catches(loos::FileOpenError, loos::FileReadError, loos::FileError, loos::LOOSError) DCD::DCD;
 %catches(loos::FileOpenError, loos::FileReadError, loos::FileError, loos::LOOSError) DCD::create;
+%catches(loos::FileOpenError, loos::FileReadError, loos::FileError, loos::LOOSError) DCD::createMapped;
 %catches(loos::FileReadError, loos::LOOSError) DCD::parseFrame;
 
 // dcdwriter
@@ -205,6 +207,7 @@ Trajectory::parseFrame;
 %catches(loos::FileError, std::range_error) Trajectory::seekFrame;
 %catches(loos::FileError) Trajectory::rewind;
 %catches(loos::LOOSError, std::range_error) Trajectory::updateGroupCoords;
+%catches(loos::LOOSError) Trajectory::updateArenaCoords;
 
 
 
@@ -226,8 +229,49 @@ Trajectory::parseFrame;
 // xtc
 %catches(loos::FileOpenError, loos::FileReadError, loos::FileError, loos::XDRDataSizeError, loos::LOOSError) XTC::XTC;
 %catches(loos::FileOpenError, loos::FileReadError, loos::FileError, loos::XDRDataSizeError, loos::LOOSError) XTC::create;
+%catches(loos::FileOpenError, loos::FileReadError, loos::FileError, loos::XDRDataSizeError, loos::LOOSError) XTC::createParallel;
 
 // xtcwrite
 
 %catches(loos::FileReadError, loos::FileOpenError, loos::FileError, loos::LOOSError) XTCWriter::XTCWriter;
 %catches(loos::FileWriteError, loos::LOOSError) XTCWriter::writeFame;
+
+// lctwriter
+
+%catches(loos::FileReadError, loos::FileOpenError, loos::FileWriteError, loos::FileError, loos::LOOSError) LCTWriter::LCTWriter;
+%catches(loos::FileWriteError, loos::LOOSError) LCTWriter::writeFrame;
+%catches(loos::FileWriteError, loos::LOOSError) LCTWriter::close;
+
+// AtomicGroupView
+
+%catches(loos::LOOSError) AtomicGroupView::AtomicGroupView;
+%catches(loos::LOOSError) AtomicGroupView::rmsd;
+
+// DynamicSelection
+
+%catches(loos::ParseError, loos::LOOSError) DynamicSelection::DynamicSelection;
+%catches(loos::LOOSError) DynamicSelection::select;
+
+// CoordinateArena
+
+%catches(loos::LOOSError) CoordinateArena::CoordinateArena;
+%catches(loos::LOOSError) CoordinateArena::coords;
+%catches(loos::LOOSError) CoordinateArena::indices;
+%catches(loos::LOOSError) CoordinateArena::gather;
+%catches(loos::LOOSError) CoordinateArena::scatter;
+%catches(loos::LOOSError) CoordinateArena::rmsd;
+
+// CellList
+
+%catches(loos::LOOSError) CellList::CellList;
+%catches(loos::LOOSError) CellList::update;
+%catches(loos::LOOSError) CellList::within;
+%catches(loos::LOOSError) CellList::anyWithin;
+%catches(loos::LOOSError) CellList::countWithin;
+
+// VerletList
+
+%catches(loos::LOOSError) VerletList::VerletList;
+%catches(loos::LOOSError) VerletList::update;
+%catches(loos::LOOSError) VerletList::rebuild;
+%catches(loos::LOOSError) VerletList::count;
@@ -115,7 +115,7 @@ namespace loos {
         }
 
         // Create a new atom and fill in the values
-        pAtom pa(new Atom);
+        pAtom pa = _atom_factory.create();
         pa->index(_max_index++);
         pa->id(atom_num);
         pa->resid(res_num);
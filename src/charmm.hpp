@@ -79,6 +79,7 @@ namespace loos {
 
     CHARMM(const AtomicGroup& grp) : AtomicGroup(grp) { }
 
+    AtomFactory _atom_factory;
     uint _max_index;
     std::string _filename;
 
@@ -59,9 +59,20 @@ namespace loos {
   float DCD::timestep(void) const { return(_delta); }
   uint DCD::nframes(void) const { return(_nframes); }
 
-  std::vector<dcd_real> DCD::xcoords(void) const { return(xcrds); }
-  std::vector<dcd_real> DCD::ycoords(void) const { return(ycrds); }
-  std::vector<dcd_real> DCD::zcoords(void) const { return(zcrds); }
+  std::vector<dcd_real> DCD::xcoords(void) const {
+    const dcd_real* p = xcoordsData();
+    return(std::vector<dcd_real>(p, p + _natoms));
+  }
+
+  std::vector<dcd_real> DCD::ycoords(void) const {
+    const dcd_real* p = ycoordsData();
+    return(std::vector<dcd_real>(p, p + _natoms));
+  }
+
+  std::vector<dcd_real> DCD::zcoords(void) const {
+    const dcd_real* p = zcoordsData();
+    return(std::vector<dcd_real>(p, p + _natoms));
+  }
 
   // The following track CHARMm names (more or less...)
   unsigned int DCD::nsteps(void) const { return(_icntrl[3]); }
@@ -304,6 +315,14 @@ namespace loos {
     int n = _natoms * sizeof(dcd_real);
     unsigned int len;
 
+    if (!subset_runs.empty()) {
+      len = readRecordLen();
+      if (len == 0)
+        return(false);
+      if (len != (unsigned int)n)
+        throw(FileReadError(_filename, "Size of coords stored in frame does not match model size"));
+      return(readCoordSubset(v, len));
+    }
 
     op = readF77Line(&len);
     if (!op)
@@ -326,6 +345,131 @@ namespace loos {
   }
 
 
+  // Read only the runs of coordinates in the atom subset, seeking past
+  // everything else.  Assumes the leading record length has already
+  // been read.
+
+  bool DCD::readCoordSubset(std::vector<dcd_real>& v, const unsigned int len) {
+    std::streampos start = ifs->tellg();
+
+    for (std::vector<IndexRun>::const_iterator i = subset_runs.begin(); i != subset_runs.end(); ++i) {
+      ifs->seekg(start + static_cast<std::streamoff>(i->first * sizeof(dcd_real)));
+      ifs->read(reinterpret_cast<char*>(&(v[i->first])), i->second * sizeof(dcd_real));
+      if (ifs->fail())
+        throw(FileReadError(_filename, "Error reading data record from DCD"));
+
+      if (swabbing)
+        for (uint j=i->first; j<i->first + i->second; ++j)
+          v[j] = swab(v[j]);
+    }
+
+    ifs->seekg(start + static_cast<std::streamoff>(len));
+    if (readRecordLen() != len)
+      throw(FileReadError(_filename, "Mismatch in record length while reading from DCD"));
+
+    return(true);
+  }
+
+
+  // Runs of atoms separated by less than a page or so are read as one
+  void DCD::atomSubsetChangedImpl(void) {
+    subset_runs = atomSubsetRuns(1024);
+  }
+
+
+  // Record length from the mapped file, or 0 if pos is past the end
+  unsigned int DCD::mappedRecordLen(const unsigned long pos) const {
+    if (pos + sizeof(unsigned int) > mapped->size())
+      return(0);
+
+    unsigned int n;
+    memcpy(&n, mapped->data() + pos, sizeof(n));
+    if (swabbing)
+      n = swab(n);
+    return(n);
+  }
+
+
+  // Locate a line of coordinates in the mapped file, advancing pos
+  // past it.  The coords are only copied (into v) if they need to be
+  // byte-swapped...
+
+  bool DCD::mapCoordLine(unsigned long& pos, unsigned long& offset, std::vector<dcd_real>& v) {
+    unsigned int n = _natoms * sizeof(dcd_real);
+    unsigned int len = mappedRecordLen(pos);
+    if (len == 0)
+      return(false);
+
+    if (len != n)
+      throw(FileReadError(_filename, "Size of coords stored in frame does not match model size"));
+    if (pos + len + 8 > mapped->size())
+      return(false);
+    if (mappedRecordLen(pos + len + 4) != len)
+      throw(FileReadError(_filename, "Mismatch in record length while reading from DCD"));
+
+    offset = pos + 4;
+    pos += len + 8;
+
+    if (swabbing) {
+      const dcd_real* p = reinterpret_cast<const dcd_real*>(mapped->data() + offset);
+      if (_atom_subset.empty())
+        for (uint i=0; i<_natoms; ++i)
+          v[i] = swab(p[i]);
+      else
+        for (std::vector<uint>::const_iterator i = _atom_subset.begin(); i != _atom_subset.end(); ++i)
+          v[*i] = swab(p[*i]);
+    }
+
+    return(true);
+  }
+
+
+  // Parse a frame directly from the memory-mapped file
+
+  bool DCD::parseMappedFrame(void) {
+    unsigned long pos = map_pos;
+
+    if (pos + frame_size > mapped->size())
+      return(false);
+
+    if (hasCrystalParams()) {
+      if (mappedRecordLen(pos) != 48)
+        throw(FileReadError(_filename, "Cannot read crystal parameters"));
+
+      // Doubles may not be aligned in the file, so copy them out...
+      double dp[6];
+      memcpy(dp, mapped->data() + pos + 4, sizeof(dp));
+      pos += 56;
+
+      qcrys[0] = dp[0];
+      qcrys[1] = dp[2];
+      qcrys[2] = dp[5];
+      qcrys[3] = dp[1];
+      qcrys[4] = dp[3];
+      qcrys[5] = dp[4];
+
+      if (swabbing)
+        for (int i=0; i<6; ++i)
+          qcrys[i] = swab(qcrys[i]);
+    }
+
+    frame_mapped = false;
+    if (!mapCoordLine(pos, map_xoff, xcrds))
+      return(false);
+    if (!mapCoordLine(pos, map_yoff, ycrds))
+      throw(FileReadError(_filename, "Unexpected EOF reading Y-coordinates from DCD"));
+    if (!mapCoordLine(pos, map_zoff, zcrds))
+      throw(FileReadError(_filename, "Unexepcted EOF reading Z-coordinates from DCD"));
+    frame_mapped = !swabbing;
+
+    // Hint to the kernel that the next frame will likely be read soon
+    map_pos = pos;
+    mapped->willNeed(map_pos, frame_size);
+
+    return(true);
+  }
+
+
   void DCD::seekFrameImpl(const uint i) {
   
     if (first_frame_pos == 0)
@@ -334,6 +478,11 @@ namespace loos {
     if (i >= nframes())
       throw(FileError(_filename, "Requested DCD frame is out of range"));
 
+    if (use_mmap) {
+      map_pos = static_cast<unsigned long>(first_frame_pos) + static_cast<unsigned long>(i) * frame_size;
+      return;
+    }
+
     ifs->clear();
     ifs->seekg(first_frame_pos + i * frame_size);
     if (ifs->fail() || ifs->bad())
@@ -351,6 +500,9 @@ namespace loos {
     if (first_frame_pos == 0)
       throw(FileReadError(_filename, "Trying to read a DCD frame without first having read the header."));
 
+    if (use_mmap)
+      return(parseMappedFrame());
+
     // This will not catch most cases of reading to the end of the file...
     if (ifs->eof())
       return(false);
@@ -372,6 +524,11 @@ namespace loos {
 
 
   void DCD::rewindImpl(void) {
+    if (use_mmap) {
+      map_pos = first_frame_pos;
+      return;
+    }
+
     ifs->clear();
     ifs->seekg(first_frame_pos);
     if (ifs->fail() || ifs->bad())
@@ -384,11 +541,14 @@ namespace loos {
 
   std::vector<GCoord> DCD::coords(void) const {
     std::vector<GCoord> crds(_natoms);
+    const dcd_real* xp = xcoordsData();
+    const dcd_real* yp = ycoordsData();
+    const dcd_real* zp = zcoordsData();
 
     for (uint i=0; i<_natoms; i++) {
-      crds[i].x(xcrds[i]);
-      crds[i].y(ycrds[i]);
-      crds[i].z(zcrds[i]);
+      crds[i].x(xp[i]);
+      crds[i].y(yp[i]);
+      crds[i].z(zp[i]);
     }
 
     return(crds);
@@ -397,13 +557,16 @@ namespace loos {
   std::vector<GCoord> DCD::mappedCoords(const std::vector<int>& indices) {
     std::vector<int>::const_iterator iter;
     std::vector<GCoord> crds(indices.size());
+    const dcd_real* xp = xcoordsData();
+    const dcd_real* yp = ycoordsData();
+    const dcd_real* zp = zcoordsData();
 
     int j = 0;
     for (iter = indices.begin(); iter != indices.end(); iter++, j++) {
       int index = *iter;
-      crds[j].x(xcrds[index]);
-      crds[j].y(ycrds[index]);
-      crds[j].z(zcrds[index]);
+      crds[j].x(xp[index]);
+      crds[j].y(yp[index]);
+      crds[j].z(zp[index]);
     }
 
     return(crds);
@@ -411,11 +574,15 @@ namespace loos {
 
 
   void DCD::updateGroupCoordsImpl(AtomicGroup& g) {
+    const dcd_real* xp = xcoordsData();
+    const dcd_real* yp = ycoordsData();
+    const dcd_real* zp = zcoordsData();
+
     for (AtomicGroup::iterator i = g.begin(); i != g.end(); ++i) {
       uint idx = (*i)->index();
       if (idx >= _natoms)
         throw(LOOSError(**i, "Atom index into the trajectory frame is out of bounds"));
-      (*i)->coords(GCoord(xcrds[idx], ycrds[idx], zcrds[idx]));
+      (*i)->coords(GCoord(xp[idx], yp[idx], zp[idx]));
     }
 
     // Handle periodic boundary conditions (if present)
@@ -426,8 +593,30 @@ namespace loos {
 
 
 
+  void DCD::updateArenaCoordsImpl(CoordinateArena& arena) {
+    const dcd_real* xp = xcoordsData();
+    const dcd_real* yp = ycoordsData();
+    const dcd_real* zp = zcoordsData();
+    greal* x = arena.x();
+    greal* y = arena.y();
+    greal* z = arena.z();
+
+    uint n = arena.size();
+    for (uint i=0; i<n; ++i) {
+      x[i] = xp[i];
+      y[i] = yp[i];
+      z[i] = zp[i];
+    }
+  }
+
+
+
   void DCD::initTrajectory() {
         readHeader();
+        if (use_mmap) {
+            mapped = boost::shared_ptr<MappedFile>(new MappedFile(_filename));
+            map_pos = first_frame_pos;
+        }
         bool b = parseFrame();
         if (!b)
             throw(LOOSError("Cannot read first frame of DCD during initialization"));
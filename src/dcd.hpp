@@ -33,6 +33,7 @@
 #include <loos_defs.hpp>
 
 #include <Trajectory.hpp>
+#include <MappedFile.hpp>
 
 
 namespace loos {
@@ -59,6 +60,19 @@ namespace loos {
      *  - [Almost] everything returned is a copy
      *
      *  - Endian detection is based on the expected size of the header
+     *
+     *The DCD can optionally be memory-mapped rather than read through
+     *a stream (see DCD::createMapped(), or the "mmdcd" trajectory type
+     *in createTrajectory()).  In this case, the coordinates of the
+     *current frame are used directly from the mapped file without
+     *any intermediate copies (unless the DCD is not in the native
+     *endian format).  The xcoordsData() family of functions gives
+     *read-only access to the current frame's coordinates regardless
+     *of how the DCD is being read.
+     *
+     *If an atom subset is registered (see Trajectory::setAtomSubset()),
+     *only the coordinates for those atoms are read from each frame,
+     *seeking past the rest.
      */
     class DCD : public Trajectory {
         static bool suppress_warnings;
@@ -77,17 +91,27 @@ namespace loos {
         explicit DCD(const std::string s) :  Trajectory(s), _natoms(0), _nframes(0),
                                              qcrys(std::vector<double>(6)),
                                              frame_size(0), first_frame_pos(0),
-                                             swabbing(false) { initTrajectory(); }
+                                             swabbing(false), use_mmap(false),
+                                             map_pos(0), frame_mapped(false) { initTrajectory(); }
+
+        //! Begin reading from the file named s, optionally memory-mapping the file
+        DCD(const std::string& s, const bool memory_map) :  Trajectory(s), _natoms(0), _nframes(0),
+                                                            qcrys(std::vector<double>(6)),
+                                                            frame_size(0), first_frame_pos(0),
+                                                            swabbing(false), use_mmap(memory_map),
+                                                            map_pos(0), frame_mapped(false) { initTrajectory(); }
 
         //! Begin reading from the file named s
         explicit DCD(const char* s) :  Trajectory(s), _natoms(0), _nframes(0),
                                        qcrys(std::vector<double>(6)), frame_size(0),
-                                       first_frame_pos(0), swabbing(false) { initTrajectory(); }
+                                       first_frame_pos(0), swabbing(false), use_mmap(false),
+                                       map_pos(0), frame_mapped(false) { initTrajectory(); }
 
         //! Begin reading from the stream ifs
         explicit DCD(std::istream& fs) : Trajectory(fs), _natoms(0), _nframes(0),
                                          qcrys(std::vector<double>(6)), frame_size(0), first_frame_pos(0),
-                                         swabbing(false) { initTrajectory(); };
+                                         swabbing(false), use_mmap(false),
+                                         map_pos(0), frame_mapped(false) { initTrajectory(); };
 
         std::string description() const { return("CHARMM/NAMD DCD"); }
 
@@ -95,6 +119,11 @@ namespace loos {
             return(pTraj(new DCD(fname)));
         }
 
+        //! Create a DCD that is read via memory-mapping the file
+        static pTraj createMapped(const std::string& fname, const AtomicGroup& model) {
+            return(pTraj(new DCD(fname, true)));
+        }
+
 
 
         // Accessor methods...
@@ -125,6 +154,20 @@ namespace loos {
         //! Return the raw coords...
         std::vector<dcd_real> zcoords(void) const;
 
+        //! Read-only access to the current frame's x-coords (natoms() long)
+        /**
+         * When memory-mapped, this points directly into the mapped
+         * file.  The pointer is only valid until the next frame is read.
+         */
+        const dcd_real* xcoordsData(void) const { return(coordData(xcrds, map_xoff)); }
+        //! Read-only access to the current frame's y-coords (natoms() long)
+        const dcd_real* ycoordsData(void) const { return(coordData(ycrds, map_yoff)); }
+        //! Read-only access to the current frame's z-coords (natoms() long)
+        const dcd_real* zcoordsData(void) const { return(coordData(zcrds, map_zoff)); }
+
+        //! True if the DCD is being read by memory-mapping the file
+        bool isMemoryMapped(void) const { return(use_mmap); }
+
         // The following track CHARMm names (more or less...)
         unsigned int nsteps(void) const;
         float delta(void) const;
@@ -170,12 +213,28 @@ namespace loos {
         //! Update an AtomicGroup coordinates with the currently-read frame.
         virtual void updateGroupCoordsImpl(AtomicGroup& g);
 
+        //! Copy the currently-read frame straight into a CoordinateArena
+        virtual void updateArenaCoordsImpl(CoordinateArena& arena);
+
 
 
         void allocateSpace(const int n);
         bool readCrystalParams(void);
         bool readCoordLine(std::vector<float>& v);
 
+        bool readCoordSubset(std::vector<dcd_real>& v, const unsigned int len);
+        void atomSubsetChangedImpl(void);
+
+        bool parseMappedFrame(void);
+        unsigned int mappedRecordLen(const unsigned long pos) const;
+        bool mapCoordLine(unsigned long& pos, unsigned long& offset, std::vector<dcd_real>& v);
+
+        const dcd_real* coordData(const std::vector<dcd_real>& v, const unsigned long offset) const {
+            if (frame_mapped)
+                return(reinterpret_cast<const dcd_real*>(mapped->data() + offset));
+            return(v.empty() ? 0 : &(v[0]));
+        }
+
         void endianMatch(pStream& fsw);
 
         // For reading F77 I/O
@@ -199,6 +258,15 @@ namespace loos {
 
         std::vector<dcd_real> xcrds, ycrds, zcrds;
 
+        // Memory-mapped I/O support
+        bool use_mmap;
+        boost::shared_ptr<MappedFile> mapped;
+        unsigned long map_pos;              // Location of next frame to parse in the mapped file
+        bool frame_mapped;                  // Coords for current frame come directly from the map
+        unsigned long map_xoff, map_yoff, map_zoff;
+
+        std::vector<IndexRun> subset_runs;  // Contiguous runs of atoms to read when using a subset
+
     };
 
 }
@@ -39,6 +39,7 @@ namespace loos {
 	// Get the # of atoms;;;
 	getline(ifs, buf);
 	int natoms = parseStringAs<int>(buf);
+	AtomFactory factory(natoms > 0 ? natoms : 0);
 	while (natoms-- > 0) {
 	  getline(ifs, buf);
 
@@ -52,7 +53,7 @@ namespace loos {
 
 
 
-	  pAtom pa(new Atom);
+	  pAtom pa = factory.create();
 	  pa->index(_max_index++);
 	  pa->resid(resid);
 	  pa->id(atomid);
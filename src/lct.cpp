@@ -0,0 +1,391 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <lct.hpp>
+#include <AtomicGroup.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace loos {
+
+  namespace internal {
+
+    const char LCTFormat::magic[8] = { 'L', 'O', 'O', 'S', 'L', 'C', 'T', '\0' };
+    const char LCTFormat::trailer_magic[8] = { 'L', 'C', 'T', 'I', 'N', 'D', 'E', 'X' };
+
+
+    namespace {
+
+      template<typename T>
+      void writeRaw(std::ostream& os, const T& t) {
+        os.write(reinterpret_cast<const char*>(&t), sizeof(T));
+      }
+
+      template<typename T>
+      bool readRaw(std::istream& is, T& t) {
+        is.read(reinterpret_cast<char*>(&t), sizeof(T));
+        return(!is.fail());
+      }
+
+      // Size of the trailer on disk
+      const unsigned long trailer_size = sizeof(boost::uint64_t) + 8;
+
+      // Smallest possible size of each frame's metadata in the footer
+      const unsigned long frame_metadata_size = sizeof(boost::int32_t) + 4 * sizeof(double);
+
+    }
+
+
+    LCTFormat::Header LCTFormat::readHeader(std::istream& is, const std::string& fname) {
+      Header h;
+
+      is.read(h.magic, sizeof(h.magic));
+      readRaw(is, h.version);
+      readRaw(is, h.endian);
+      readRaw(is, h.natoms);
+      readRaw(is, h.frames_per_chunk);
+      readRaw(is, h.atoms_per_block);
+      if (!readRaw(is, h.compressed))
+        throw(FileOpenError(fname, "Cannot read LCT header"));
+
+      if (memcmp(h.magic, magic, sizeof(magic)) != 0)
+        throw(FileOpenError(fname, "File is not a LOOS chunked trajectory"));
+      if (h.endian != endian)
+        throw(FileOpenError(fname, "LCT file was written on a machine with a different byte order"));
+      if (h.version != version)
+        throw(FileOpenError(fname, "Unsupported LCT version"));
+      if (h.frames_per_chunk == 0 || h.atoms_per_block == 0)
+        throw(FileOpenError(fname, "Corrupt LCT header"));
+
+      return(h);
+    }
+
+
+    void LCTFormat::readIndex(std::istream& is, const std::string& fname, const Header& header,
+                              Index& index, boost::uint64_t& footer_offset) {
+      is.clear();
+      is.seekg(0, std::ios_base::end);
+      boost::uint64_t file_size = is.tellg();
+      if (file_size < sizeof(Header) + trailer_size)
+        throw(FileOpenError(fname, "LCT file is missing its index (was it closed properly?)"));
+
+      Trailer trailer;
+      is.seekg(file_size - trailer_size);
+      readRaw(is, trailer.footer_offset);
+      is.read(trailer.magic, sizeof(trailer.magic));
+      if (is.fail() || memcmp(trailer.magic, trailer_magic, sizeof(trailer_magic)) != 0
+          || trailer.footer_offset < sizeof(Header) || trailer.footer_offset > file_size - trailer_size)
+        throw(FileOpenError(fname, "LCT file is missing its index (was it closed properly?)"));
+
+      footer_offset = trailer.footer_offset;
+      is.seekg(footer_offset);
+
+      boost::uint64_t nframes, nchunks;
+      boost::uint32_t has_box, reserved;
+      readRaw(is, nframes);
+      readRaw(is, nchunks);
+      readRaw(is, has_box);
+      readRaw(is, reserved);
+      if (!readRaw(is, index.timestep))
+        throw(FileOpenError(fname, "Cannot read LCT index"));
+
+      // Sanity check sizes before allocating anything...
+      unsigned long footer_size = file_size - footer_offset;
+      if (nframes > footer_size / frame_metadata_size || nchunks > nframes)
+        throw(FileOpenError(fname, "Corrupt LCT index"));
+
+      index.has_box = has_box;
+      index.frames.resize(nframes);
+      for (std::vector<Frame>::iterator i = index.frames.begin(); i != index.frames.end(); ++i) {
+        readRaw(is, i->step);
+        readRaw(is, i->time);
+        readRaw(is, i->box[0]);
+        readRaw(is, i->box[1]);
+        readRaw(is, i->box[2]);
+      }
+
+      index.chunk_sizes.resize(nchunks);
+      boost::uint64_t total = 0;
+      for (uint i=0; i<nchunks; ++i) {
+        readRaw(is, index.chunk_sizes[i]);
+        if (index.chunk_sizes[i] == 0 || index.chunk_sizes[i] > header.frames_per_chunk)
+          throw(FileOpenError(fname, "Corrupt LCT index"));
+        total += index.chunk_sizes[i];
+      }
+      if (total != nframes)
+        throw(FileOpenError(fname, "Corrupt LCT index"));
+
+      index.blocks.resize(nchunks * numberOfBlocks(header.natoms, header.atoms_per_block));
+      for (std::vector<Block>::iterator i = index.blocks.begin(); i != index.blocks.end(); ++i) {
+        readRaw(is, i->offset);
+        readRaw(is, i->size);
+        readRaw(is, i->encoding);
+        if (i->offset < sizeof(Header) || i->offset + i->size > footer_offset)
+          throw(FileOpenError(fname, "Corrupt LCT index"));
+      }
+
+      if (is.fail())
+        throw(FileOpenError(fname, "Cannot read LCT index"));
+    }
+
+
+    void LCTFormat::writeIndex(std::ostream& os, const Index& index) {
+      boost::uint64_t footer_offset = os.tellp();
+
+      writeRaw(os, static_cast<boost::uint64_t>(index.frames.size()));
+      writeRaw(os, static_cast<boost::uint64_t>(index.chunk_sizes.size()));
+      writeRaw(os, static_cast<boost::uint32_t>(index.has_box));
+      writeRaw(os, static_cast<boost::uint32_t>(0));
+      writeRaw(os, index.timestep);
+
+      for (std::vector<Frame>::const_iterator i = index.frames.begin(); i != index.frames.end(); ++i) {
+        writeRaw(os, i->step);
+        writeRaw(os, i->time);
+        writeRaw(os, i->box[0]);
+        writeRaw(os, i->box[1]);
+        writeRaw(os, i->box[2]);
+      }
+
+      for (std::vector<boost::uint32_t>::const_iterator i = index.chunk_sizes.begin(); i != index.chunk_sizes.end(); ++i)
+        writeRaw(os, *i);
+
+      for (std::vector<Block>::const_iterator i = index.blocks.begin(); i != index.blocks.end(); ++i) {
+        writeRaw(os, i->offset);
+        writeRaw(os, i->size);
+        writeRaw(os, i->encoding);
+      }
+
+      writeRaw(os, footer_offset);
+      os.write(trailer_magic, sizeof(trailer_magic));
+    }
+
+
+    void LCTFormat::encodeBlock(const std::vector<float>& data, const unsigned long stride, std::vector<char>& out) {
+      unsigned long n = data.size();
+
+      std::vector<boost::uint32_t> words(n);
+      if (n > 0)
+        memcpy(&words[0], &data[0], n * sizeof(float));
+      for (unsigned long i = n; i > stride; --i)
+        words[i-1] ^= words[i-1-stride];
+
+      // Most significant bytes first, then run-length encode the zeros
+      out.clear();
+      out.reserve(4 * n);
+      for (int shift = 24; shift >= 0; shift -= 8) {
+        unsigned long i = 0;
+        while (i < n) {
+          unsigned char c = (words[i] >> shift) & 0xff;
+          if (c != 0) {
+            out.push_back(c);
+            ++i;
+            continue;
+          }
+
+          uint run = 0;
+          while (i < n && run < 255 && ((words[i] >> shift) & 0xff) == 0) {
+            ++run;
+            ++i;
+          }
+          out.push_back(0);
+          out.push_back(static_cast<char>(run));
+        }
+      }
+    }
+
+
+    bool LCTFormat::decodeBlock(const char* p, const unsigned long n, const unsigned long stride, std::vector<float>& data) {
+      unsigned long m = data.size();
+      const unsigned char* q = reinterpret_cast<const unsigned char*>(p);
+      const unsigned char* end = q + n;
+
+      std::vector<boost::uint32_t> words(m, 0);
+      for (int shift = 24; shift >= 0; shift -= 8) {
+        unsigned long i = 0;
+        while (i < m) {
+          if (q >= end)
+            return(false);
+          unsigned char c = *q++;
+          if (c != 0) {
+            words[i++] |= static_cast<boost::uint32_t>(c) << shift;
+            continue;
+          }
+
+          if (q >= end || *q == 0 || i + *q > m)
+            return(false);
+          i += *q++;
+        }
+      }
+      if (q != end)
+        return(false);
+
+      for (unsigned long i = stride; i < m; ++i)
+        words[i] ^= words[i-stride];
+      if (m > 0)
+        memcpy(&data[0], &words[0], m * sizeof(float));
+      return(true);
+    }
+
+  }
+
+
+
+  void LCT::init() {
+    header = internal::LCTFormat::readHeader(*ifs, _filename);
+    boost::uint64_t footer_offset;
+    internal::LCTFormat::readIndex(*ifs, _filename, header, index, footer_offset);
+
+    uint k = 0;
+    for (uint i=0; i<index.chunk_sizes.size(); ++i) {
+      chunk_starts.push_back(k);
+      k += index.chunk_sizes[i];
+    }
+
+    nblocks = internal::LCTFormat::numberOfBlocks(header.natoms, header.atoms_per_block);
+    block_data.resize(nblocks);
+    block_loaded.resize(nblocks, 0);
+    for (uint i=0; i<nblocks; ++i)
+      blocks_needed.push_back(i);
+
+    frame.resize(header.natoms);
+    frame_step = 0;
+    frame_time = 0.0;
+
+    if (!index.frames.empty()) {
+      parseFrame();
+      cached_first = true;
+    }
+  }
+
+
+  uint LCT::chunkForFrame(const uint i) const {
+    std::vector<uint>::const_iterator j = std::upper_bound(chunk_starts.begin(), chunk_starts.end(), i);
+    return(j - chunk_starts.begin() - 1);
+  }
+
+
+  void LCT::loadBlock(const uint chunk, const uint block) {
+    const internal::LCTFormat::Block& b = index.blocks[chunk * nblocks + block];
+    uint nf = index.chunk_sizes[chunk];
+    uint na = std::min(header.atoms_per_block, header.natoms - block * header.atoms_per_block);
+    unsigned long nvalues = 3ul * nf * na;
+
+    readbuf.resize(b.size + 1);
+    ifs->clear();
+    ifs->seekg(b.offset);
+    ifs->read(&readbuf[0], b.size);
+    if (ifs->fail())
+      throw(FileReadError(_filename, "Cannot read block from LCT trajectory"));
+
+    std::vector<float>& data = block_data[block];
+    data.resize(nvalues);
+    if (b.encoding == internal::LCTFormat::RAW) {
+      if (b.size != nvalues * sizeof(float))
+        throw(FileReadError(_filename, "LCT block has the wrong size"));
+      memcpy(&data[0], &readbuf[0], b.size);
+    } else if (b.encoding == internal::LCTFormat::XOR_SHUFFLE_RLE) {
+      if (!internal::LCTFormat::decodeBlock(&readbuf[0], b.size, na, data))
+        throw(FileReadError(_filename, "Corrupt compressed block in LCT trajectory"));
+    } else
+      throw(FileReadError(_filename, "Unknown block encoding in LCT trajectory"));
+
+    block_loaded[block] = 1;
+  }
+
+
+  bool LCT::parseFrame() {
+    if (next_frame >= index.frames.size())
+      return(false);
+
+    uint chunk = chunkForFrame(next_frame);
+    if (!chunk_loaded || chunk != current_chunk) {
+      std::fill(block_loaded.begin(), block_loaded.end(), 0);
+      current_chunk = chunk;
+      chunk_loaded = true;
+    }
+
+    uint f = next_frame - chunk_starts[chunk];
+    uint nf = index.chunk_sizes[chunk];
+
+    for (std::vector<uint>::const_iterator i = blocks_needed.begin(); i != blocks_needed.end(); ++i) {
+      uint b = *i;
+      if (!block_loaded[b])
+        loadBlock(chunk, b);
+
+      uint first = b * header.atoms_per_block;
+      uint na = std::min(header.atoms_per_block, header.natoms - first);
+      const float* x = &block_data[b][f * na];
+      const float* y = x + nf * na;
+      const float* z = y + nf * na;
+      for (uint a=0; a<na; ++a)
+        frame[first + a] = GCoord(x[a], y[a], z[a]);
+    }
+
+    const internal::LCTFormat::Frame& meta = index.frames[next_frame];
+    box = GCoord(meta.box[0], meta.box[1], meta.box[2]);
+    frame_step = meta.step;
+    frame_time = meta.time;
+
+    ++next_frame;
+    return(true);
+  }
+
+
+  void LCT::seekFrameImpl(const uint i) {
+    if (i >= index.frames.size())
+      throw(FileError(_filename, "Requested LCT frame is out of range"));
+    next_frame = i;
+  }
+
+
+  // Only read the blocks that contain atoms in the subset
+  void LCT::atomSubsetChangedImpl() {
+    blocks_needed.clear();
+    if (_atom_subset.empty()) {
+      for (uint i=0; i<nblocks; ++i)
+        blocks_needed.push_back(i);
+      return;
+    }
+
+    for (std::vector<uint>::const_iterator i = _atom_subset.begin(); i != _atom_subset.end(); ++i) {
+      uint b = *i / header.atoms_per_block;
+      if (blocks_needed.empty() || blocks_needed.back() != b)
+        blocks_needed.push_back(b);
+    }
+  }
+
+
+  void LCT::updateGroupCoordsImpl(AtomicGroup& g) {
+    for (AtomicGroup::iterator i = g.begin(); i != g.end(); ++i) {
+      uint idx = (*i)->index();
+      if (idx >= header.natoms)
+        throw(LOOSError(**i, "Atom index into trajectory frame is out of bounds"));
+      (*i)->coords(frame[idx]);
+    }
+
+    if (index.has_box)
+      g.periodicBox(box);
+  }
+
+}
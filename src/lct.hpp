@@ -0,0 +1,236 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if !defined(LOOS_LCT_HPP)
+#define LOOS_LCT_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include <loos_defs.hpp>
+#include <Coord.hpp>
+#include <Trajectory.hpp>
+
+
+namespace loos {
+
+  namespace internal {
+
+    //! Layout of the LOOS chunked trajectory (LCT) format
+    /**
+     * An LCT file is laid out as:
+     *
+     *   - A fixed-size header (LCTFormat::Header)
+     *   - The coordinate data, grouped into chunks of consecutive
+     *     frames.  Each chunk is split into blocks covering a fixed
+     *     range of atoms.  A block stores all x-coordinates (frame
+     *     by frame) for its atoms, followed by all y and then all z,
+     *     as single-precision floats.  Blocks may be stored raw or
+     *     compressed (see encodeBlock())
+     *   - A footer with the step, time, and periodic box for every
+     *     frame, and the number of frames in each chunk along with
+     *     the offset, size, and encoding of each block
+     *   - A trailer holding the offset of the footer
+     *
+     * All values are in the native byte order of the machine that
+     * wrote the file.  Since the footer is written when the file is
+     * closed, a trajectory that was not closed properly cannot be
+     * read.
+     */
+    struct LCTFormat {
+      static const char magic[8];
+      static const char trailer_magic[8];
+      static const boost::uint32_t version = 1;
+      static const boost::uint32_t endian = 0x01020304;
+
+      enum BlockEncoding { RAW = 0, XOR_SHUFFLE_RLE = 1 };
+
+      struct Header {
+        char magic[8];
+        boost::uint32_t version;
+        boost::uint32_t endian;
+        boost::uint32_t natoms;
+        boost::uint32_t frames_per_chunk;
+        boost::uint32_t atoms_per_block;
+        boost::uint32_t compressed;
+      };
+
+      struct Trailer {
+        boost::uint64_t footer_offset;
+        char magic[8];
+      };
+
+      //! Location of a block within the file
+      struct Block {
+        boost::uint64_t offset;
+        boost::uint64_t size;
+        boost::uint32_t encoding;
+      };
+
+      //! Per-frame metadata
+      struct Frame {
+        boost::int32_t step;
+        double time;
+        double box[3];
+      };
+
+      //! Everything stored in the footer
+      struct Index {
+        Index() : has_box(false), timestep(0.0) { }
+
+        bool has_box;
+        double timestep;
+        std::vector<Frame> frames;
+        std::vector<boost::uint32_t> chunk_sizes;   // Frames per chunk
+        std::vector<Block> blocks;                  // All blocks, chunk by chunk
+      };
+
+      //! Number of blocks needed to cover natoms
+      static uint numberOfBlocks(const uint natoms, const uint atoms_per_block) {
+        return((natoms + atoms_per_block - 1) / atoms_per_block);
+      }
+
+      //! Reads the header, throwing a FileOpenError if it is not an LCT file
+      static Header readHeader(std::istream& is, const std::string& fname);
+
+      //! Reads the footer, throwing on any inconsistency
+      static void readIndex(std::istream& is, const std::string& fname, const Header& header,
+                            Index& index, boost::uint64_t& footer_offset);
+
+      //! Writes the footer and trailer at the current position of \a os
+      static void writeIndex(std::ostream& os, const Index& index);
+
+      //! Compresses a block of coordinates
+      /**
+       * Lossless.  Each value is XOR'd with the value \a stride
+       * elements before it (i.e. the same coordinate in the previous
+       * frame), the bytes are then shuffled so the most
+       * significant bytes of all values are together, and runs of
+       * zero bytes are collapsed.  Coordinates that change little
+       * between frames share their sign, exponent, and high mantissa
+       * bits, so those bytes mostly vanish.
+       */
+      static void encodeBlock(const std::vector<float>& data, const unsigned long stride, std::vector<char>& out);
+
+      //! Reverses encodeBlock(), returning false if the data is corrupt
+      /**
+       * \a data must already be sized to hold the decoded block
+       */
+      static bool decodeBlock(const char* p, const unsigned long n, const unsigned long stride, std::vector<float>& data);
+    };
+
+  }
+
+
+  //! Class for reading LOOS chunked trajectories (LCT)
+  /**
+   * This is a LOOS-native format designed for fast reading by
+   * analysis tools, rather than for compactness or interchange (see
+   * internal::LCTFormat for the layout).  Any frame can be read
+   * directly via the index stored at the end of the file.
+   *
+   * The coordinates are stored in blocks that cover a range of
+   * atoms for a group of frames (a chunk).  The blocks for a chunk
+   * are decoded when a frame from the chunk is first needed, so
+   * reading frames sequentially decodes each block only once.  If
+   * an atom subset is registered (see Trajectory::setAtomSubset()),
+   * only the blocks that contain atoms from the subset are read.
+   *
+   * Use LCTWriter (or the traj2lct tool) to create these files.
+   */
+  class LCT : public Trajectory {
+  public:
+    explicit LCT(const std::string& s) : Trajectory(s), next_frame(0), current_chunk(0), chunk_loaded(false) { init(); }
+    explicit LCT(const char* s) : Trajectory(s), next_frame(0), current_chunk(0), chunk_loaded(false) { init(); }
+    explicit LCT(std::istream& is) : Trajectory(is), next_frame(0), current_chunk(0), chunk_loaded(false) { init(); }
+
+    std::string description() const { return("LOOS chunked trajectory"); }
+
+    static pTraj create(const std::string& fname, const AtomicGroup&) {
+      return(pTraj(new LCT(fname)));
+    }
+
+    virtual uint natoms() const { return(header.natoms); }
+    virtual uint nframes() const { return(index.frames.size()); }
+    virtual float timestep() const { return(index.timestep); }
+
+    virtual bool hasPeriodicBox() const { return(index.has_box); }
+    virtual GCoord periodicBox() const { return(box); }
+
+    virtual std::vector<GCoord> coords() const { return(frame); }
+
+    //! Step stored with the current frame
+    int step() const { return(frame_step); }
+
+    //! Time stored with the current frame
+    double time() const { return(frame_time); }
+
+    //! Number of frames grouped together in each chunk
+    uint framesPerChunk() const { return(header.frames_per_chunk); }
+
+    //! Number of atoms covered by each block
+    uint atomsPerBlock() const { return(header.atoms_per_block); }
+
+    //! Whether or not blocks were compressed when written
+    bool isCompressed() const { return(header.compressed); }
+
+  private:
+    void init();
+    void loadBlock(const uint chunk, const uint block);
+    uint chunkForFrame(const uint i) const;
+
+    virtual void rewindImpl() { next_frame = 0; }
+    virtual void seekNextFrameImpl() { }
+    virtual void seekFrameImpl(const uint);
+    virtual bool parseFrame();
+    virtual void updateGroupCoordsImpl(AtomicGroup&);
+    virtual void updateArenaCoordsImpl(CoordinateArena& arena) { arena.coords(frame); }
+    virtual void atomSubsetChangedImpl();
+
+  private:
+    internal::LCTFormat::Header header;
+    internal::LCTFormat::Index index;
+    std::vector<uint> chunk_starts;             // First frame of each chunk
+
+    uint nblocks;
+    std::vector<uint> blocks_needed;            // Blocks covering the atom subset
+
+    uint next_frame;
+    uint current_chunk;
+    bool chunk_loaded;
+    std::vector< std::vector<float> > block_data;
+    std::vector<char> block_loaded;
+    std::vector<char> readbuf;
+
+    std::vector<GCoord> frame;
+    GCoord box;
+    int frame_step;
+    double frame_time;
+  };
+
+
+}
+
+
+#endif
@@ -0,0 +1,208 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <lctwriter.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace loos {
+
+
+  void LCTWriter::init(const uint frames_per_chunk, const uint atoms_per_block, const bool compress) {
+    if (frames_per_chunk == 0 || atoms_per_block == 0)
+      throw(LOOSError("LCT chunk and block sizes must be greater than zero"));
+
+    memcpy(header_.magic, internal::LCTFormat::magic, sizeof(header_.magic));
+    header_.version = internal::LCTFormat::version;
+    header_.endian = internal::LCTFormat::endian;
+    header_.natoms = 0;
+    header_.frames_per_chunk = frames_per_chunk;
+    header_.atoms_per_block = atoms_per_block;
+    header_.compressed = compress;
+
+    npending_ = 0;
+    header_written_ = closed_ = false;
+
+    if (appending_)
+      prepareToAppend();
+  }
+
+
+  LCTWriter::~LCTWriter() {
+    // Destructors must not throw, so errors here are lost.  Call
+    // close() explicitly to catch them...
+    try {
+      close();
+    }
+    catch (...) { }
+  }
+
+
+  // Reads the existing header and index, then positions the stream
+  // so new chunks overwrite the old index
+  void LCTWriter::prepareToAppend() {
+    stream_->seekg(0);
+    header_ = internal::LCTFormat::readHeader(*stream_, _filename);
+
+    boost::uint64_t footer_offset;
+    internal::LCTFormat::readIndex(*stream_, _filename, header_, index_, footer_offset);
+
+    stream_->clear();
+    stream_->seekp(footer_offset);
+    if (stream_->fail())
+      throw(FileWriteError(_filename, "Cannot seek to end of LCT trajectory for appending"));
+    header_written_ = true;
+  }
+
+
+  void LCTWriter::writeHeader() {
+    stream_->seekp(0);
+    stream_->write(header_.magic, sizeof(header_.magic));
+    stream_->write(reinterpret_cast<const char*>(&header_.version), sizeof(header_.version));
+    stream_->write(reinterpret_cast<const char*>(&header_.endian), sizeof(header_.endian));
+    stream_->write(reinterpret_cast<const char*>(&header_.natoms), sizeof(header_.natoms));
+    stream_->write(reinterpret_cast<const char*>(&header_.frames_per_chunk), sizeof(header_.frames_per_chunk));
+    stream_->write(reinterpret_cast<const char*>(&header_.atoms_per_block), sizeof(header_.atoms_per_block));
+    stream_->write(reinterpret_cast<const char*>(&header_.compressed), sizeof(header_.compressed));
+    if (stream_->fail())
+      throw(FileWriteError(_filename, "Error while writing LCT header"));
+
+    header_written_ = true;
+  }
+
+
+  void LCTWriter::writeFrame(const AtomicGroup& model) {
+    uint step = framesWritten();
+    writeFrame(model, step, step * index_.timestep);
+  }
+
+
+  void LCTWriter::writeFrame(const AtomicGroup& model, const uint step, const double time) {
+    if (closed_)
+      throw(LOOSError("Cannot write to an LCT trajectory after it has been closed"));
+
+    if (!header_written_) {   // First frame of a new trajectory...
+      header_.natoms = model.size();
+      index_.has_box = model.isPeriodic();
+      writeHeader();
+    } else {
+      if (model.size() != header_.natoms)
+        throw(LOOSError("Frame group atom count mismatch"));
+      if (index_.has_box && !model.isPeriodic())
+        throw(LOOSError("Periodic box data was requested for the LCT but the passed frame is missing it"));
+    }
+
+    uint natoms = header_.natoms;
+    pending_.resize(static_cast<unsigned long>(header_.frames_per_chunk) * natoms * 3);
+    float* p = &pending_[static_cast<unsigned long>(npending_) * natoms * 3];
+    for (uint i=0; i<natoms; ++i) {
+      const GCoord& c = model[i]->coords();
+      *p++ = c.x();
+      *p++ = c.y();
+      *p++ = c.z();
+    }
+
+    internal::LCTFormat::Frame frame;
+    frame.step = step;
+    frame.time = time;
+    GCoord box = index_.has_box ? model.periodicBox() : GCoord(0,0,0);
+    frame.box[0] = box.x();
+    frame.box[1] = box.y();
+    frame.box[2] = box.z();
+    index_.frames.push_back(frame);
+
+    if (++npending_ == header_.frames_per_chunk)
+      writeChunk();
+  }
+
+
+  // Transposes the buffered frames into blocks and writes them out
+  void LCTWriter::writeChunk() {
+    if (npending_ == 0)
+      return;
+
+    uint natoms = header_.natoms;
+    uint apb = header_.atoms_per_block;
+    uint nblocks = internal::LCTFormat::numberOfBlocks(natoms, apb);
+    uint nf = npending_;
+
+    std::vector<float> data;
+    std::vector<char> encoded;
+
+    for (uint b=0; b<nblocks; ++b) {
+      uint first = b * apb;
+      uint na = std::min(apb, natoms - first);
+
+      data.resize(3ul * nf * na);
+      for (uint k=0; k<3; ++k)
+        for (uint f=0; f<nf; ++f) {
+          const float* src = &pending_[(static_cast<unsigned long>(f) * natoms + first) * 3 + k];
+          float* dst = &data[(static_cast<unsigned long>(k) * nf + f) * na];
+          for (uint a=0; a<na; ++a)
+            dst[a] = src[3*a];
+        }
+
+      internal::LCTFormat::Block block;
+      block.offset = stream_->tellp();
+      block.encoding = internal::LCTFormat::RAW;
+      block.size = data.size() * sizeof(float);
+      const char* bytes = reinterpret_cast<const char*>(&data[0]);
+
+      if (header_.compressed) {
+        internal::LCTFormat::encodeBlock(data, na, encoded);
+        if (encoded.size() < block.size) {
+          block.encoding = internal::LCTFormat::XOR_SHUFFLE_RLE;
+          block.size = encoded.size();
+          bytes = &encoded[0];
+        }
+      }
+
+      stream_->write(bytes, block.size);
+      index_.blocks.push_back(block);
+    }
+
+    if (stream_->fail())
+      throw(FileWriteError(_filename, "Error while writing LCT chunk"));
+
+    index_.chunk_sizes.push_back(nf);
+    npending_ = 0;
+  }
+
+
+  void LCTWriter::close() {
+    if (closed_)
+      return;
+    closed_ = true;
+
+    if (!header_written_)
+      writeHeader();
+    writeChunk();
+
+    internal::LCTFormat::writeIndex(*stream_, index_);
+    stream_->flush();
+    if (stream_->fail())
+      throw(FileWriteError(_filename, "Error while writing LCT index"));
+  }
+
+}
@@ -0,0 +1,123 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(LOOS_LCTWRITER_HPP)
+#define LOOS_LCTWRITER_HPP
+
+#include <string>
+#include <vector>
+
+#include <loos_defs.hpp>
+#include <AtomicGroup.hpp>
+#include <trajwriter.hpp>
+#include <lct.hpp>
+
+
+namespace loos {
+
+  //! Class for writing LOOS chunked trajectories (LCT)
+  /**
+   * Frames are buffered until a full chunk has been collected, at
+   * which point the chunk is written out (see internal::LCTFormat).
+   * The index of frames is written when the trajectory is closed,
+   * either explicitly by close() or when the LCTWriter is destroyed.
+   * A trajectory that is not closed cannot be read.
+   *
+   * When appending, the chunk size, block size, and compression are
+   * taken from the existing trajectory.  New frames are written over
+   * the old index, so the existing trajectory is unreadable until
+   * the LCTWriter is closed.
+   */
+  class LCTWriter : public TrajectoryWriter {
+  public:
+
+    static const uint default_frames_per_chunk = 16;
+    static const uint default_atoms_per_block = 4096;
+
+    static pTrajectoryWriter create(const std::string& s, const bool append = false) {
+      return(pTrajectoryWriter(new LCTWriter(s, append)));
+    }
+
+    //! Write to the file named \a fname, using the default layout (with compression)
+    explicit LCTWriter(const std::string& fname, const bool append = false) :
+      TrajectoryWriter(fname, append)
+    {
+      init(default_frames_per_chunk, default_atoms_per_block, true);
+    }
+
+    //! Write to the file named \a fname with the given layout
+    /**
+     * \a frames_per_chunk frames are grouped together and split into
+     * blocks of \a atoms_per_block atoms.  Larger chunks and blocks
+     * generally compress better, but require more memory to read.
+     * Smaller blocks make reading small subsets of atoms faster.
+     */
+    LCTWriter(const std::string& fname, const uint frames_per_chunk, const uint atoms_per_block,
+              const bool compress, const bool append = false) :
+      TrajectoryWriter(fname, append)
+    {
+      init(frames_per_chunk, atoms_per_block, compress);
+    }
+
+    ~LCTWriter();
+
+    void writeFrame(const AtomicGroup& model);
+    void writeFrame(const AtomicGroup& model, const uint step, const double time);
+
+    bool hasFrameStep() const { return(true); }
+    bool hasFrameTime() const { return(true); }
+
+    uint framesWritten() const { return(index_.frames.size()); }
+
+    //! Time between frames, stored in the trajectory
+    double timestep() const { return(index_.timestep); }
+    void timestep(const double dt) { index_.timestep = dt; }
+
+    uint framesPerChunk() const { return(header_.frames_per_chunk); }
+    uint atomsPerBlock() const { return(header_.atoms_per_block); }
+    bool isCompressed() const { return(header_.compressed); }
+
+    //! Writes any buffered frames and the index
+    /**
+     * No more frames may be written after the trajectory is closed.
+     */
+    void close();
+
+  private:
+    void init(const uint frames_per_chunk, const uint atoms_per_block, const bool compress);
+    void prepareToAppend();
+    void writeHeader();
+    void writeChunk();
+
+  private:
+    internal::LCTFormat::Header header_;
+    internal::LCTFormat::Index index_;
+
+    std::vector<float> pending_;      // Buffered frames (xyz interleaved)
+    uint npending_;
+    bool header_written_, closed_;
+  };
+
+}
+
+
+#endif
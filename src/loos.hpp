@@ -67,6 +67,10 @@
 #include <AtomicNumberDeducer.hpp>
 #include <Atom.hpp>
 #include <AtomicGroup.hpp>
+#include <AtomicGroupView.hpp>
+#include <DynamicSelection.hpp>
+#include <CoordinateArena.hpp>
+#include <VerletList.hpp>
 #include <pdb.hpp>
 #include <psf.hpp>
 #include <amber.hpp>
@@ -76,10 +80,12 @@
 #include <dcd.hpp>
 #include <dcd_utils.hpp>
 #include <MultiTraj.hpp>
+#include <PrefetchTraj.hpp>
 
 #include <trajwriter.hpp>
 #include <dcdwriter.hpp>
 #include <xtcwriter.hpp>
+#include <lctwriter.hpp>
 
 #include <amber_traj.hpp>
 
@@ -94,6 +100,7 @@
 #include <xtc.hpp>
 #include <gro.hpp>
 #include <trr.hpp>
+#include <lct.hpp>
 
 
 
@@ -111,9 +118,11 @@
 
 #include <sorting.hpp>
 
+#include <ThreadPool.hpp>
 #include <OptionsFramework.hpp>
 
 #include <alignment.hpp>
+#include <RMSDMatrix.hpp>
 #endif
 
 
@@ -65,6 +65,12 @@ namespace loos {
 %include "pdb_remarks.i"
 %include "XForm.i"
 %include "AtomicGroup.i"
+%include "AtomicGroupView.i"
+%include "DynamicSelection.i"
+%include "CoordinateArena.i"
+%include "BondTable.i"
+%include "CellList.i"
+%include "VerletList.i"
 %include "Trajectory.i"
 %include "utils.i"
 %include "cryst.i"
@@ -76,6 +82,7 @@ namespace loos {
 %include "trajwriter.i"
 %include "dcdwriter.i"
 %include "xtcwriter.i"
+%include "lctwriter.i"
 %include "sfactories.i"
 %include "alignment.i"
 %include "gro.i"
@@ -125,6 +125,7 @@ namespace loos {
   class TrajectoryWriter;
   class DCDWriter;
   class XTCWriter;
+  class LCTWriter;
 
   // Trajectory and subclasses...
   class Atom;
@@ -139,6 +140,7 @@ namespace loos {
   class PDBTraj;
   class XTC;
   class TRR;
+  class LCT;
 
 
   typedef boost::shared_ptr<Atom> pAtom;
@@ -153,6 +155,7 @@ namespace loos {
   typedef boost::shared_ptr<PDBTraj> pPDBTraj;
   typedef boost::shared_ptr<XTC> pXTC;
   typedef boost::shared_ptr<TRR> pTRR;
+  typedef boost::shared_ptr<LCT> pLCT;
   typedef boost::shared_ptr<TrajectoryWriter> pTrajectoryWriter;
 
   // AtomicGroup and subclasses (i.e. systems formats)
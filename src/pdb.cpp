@@ -67,7 +67,7 @@ namespace loos {
     gint i;
     std::string t;
     GCoord c;
-    pAtom pa(new Atom);
+    pAtom pa = _atom_factory.create();
 
     pa->index(_max_index++);
 
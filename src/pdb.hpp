@@ -180,6 +180,7 @@ namespace loos {
         void uniqueBonds();
 
     private:
+        AtomFactory _atom_factory;
         uint _max_index;
         bool _show_charge;
         bool _auto_ter;
@@ -81,6 +81,8 @@ namespace loos {
     if (!(std::stringstream(input) >> num_atoms))
       throw(FileReadError(_filename, "PSF has malformed natom line"));
 
+    if (num_atoms > 0)
+      _atom_factory.reserve(num_atoms);
     for (int i=0; i<num_atoms; i++) {
       if (!getline(is, input)) {
 	std::ostringstream oss;
@@ -156,7 +158,7 @@ namespace loos {
     gint fixed;
     std::string buf;
 
-    pAtom pa(new Atom);
+    pAtom pa = _atom_factory.create();
     pa->index(_max_index++);
 
     std::stringstream ss(s);
@@ -91,6 +91,7 @@ namespace loos {
     PSF(const AtomicGroup& grp) : AtomicGroup(grp) { }
     void parseAtomRecord(const std::string s);  
 
+    AtomFactory _atom_factory;
     uint _max_index;
     std::string _filename;
   };
@@ -49,11 +49,13 @@
 #include <gro.hpp>
 #include <xtc.hpp>
 #include <trr.hpp>
+#include <lct.hpp>
 
 
 #include <trajwriter.hpp>
 #include <dcdwriter.hpp>
 #include <xtcwriter.hpp>
+#include <lctwriter.hpp>
 
 namespace loos {
 
@@ -142,9 +144,12 @@ namespace loos {
       { "rst", "Amber Restart", &AmberRst::create},
       { "rst7", "Amber Restart", &AmberRst::create},
       { "dcd", "CHARMM/NAMD DCD", &DCD::create},
+      { "mmdcd", "CHARMM/NAMD DCD (memory-mapped)", &DCD::createMapped},
+      { "lct", "LOOS chunked trajectory", &LCT::create},
       { "pdb", "Concatenated PDB", &CCPDB::create},
       { "trr", "Gromacs TRR", &TRR::create},
       { "xtc", "Gromacs XTC", &XTC::create},
+      { "pxtc", "Gromacs XTC (parallel decoding)", &XTC::createParallel},
       { "arc", "Tinker ARC", &TinkerArc::create},
       { "", "", 0}
     };
@@ -203,6 +208,7 @@ namespace loos {
     OutputTrajectoryNameBindingType output_trajectory_name_bindings[] = {
       { "dcd", "NAMD DCD", &DCDWriter::create},
       { "xtc", "Gromacs XTC (compressed trajectory)", &XTCWriter::create},
+      { "lct", "LOOS chunked trajectory", &LCTWriter::create},
       { "", "", 0}
     };
 
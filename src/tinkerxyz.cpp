@@ -102,7 +102,7 @@ namespace loos {
     //greal mass=1.0;
     //gint atomic_number = 1;
 
-    pAtom pa(new Atom);
+    pAtom pa = _atom_factory.create();
     pa->index(_max_index++);
          
     std::stringstream ss(s);
@@ -87,6 +87,7 @@ namespace loos {
      */
     bool parseBoxRecord(const std::string& s);
 
+    AtomFactory _atom_factory;
     uint _max_index;
     std::string _filename;
   };
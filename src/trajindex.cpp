@@ -0,0 +1,231 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <trajindex.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/cstdint.hpp>
+
+
+namespace loos {
+
+  namespace internal {
+
+    bool TrajectoryFrameIndex::use_cache_ = true;
+
+
+    // Magic, version, and byte-order tag for the index file.  Any
+    // mismatch simply causes the index to be rebuilt.
+    static const char index_magic[8] = { 'L', 'O', 'O', 'S', 'I', 'D', 'X', '\0' };
+    static const boost::uint32_t index_version = 1;
+    static const boost::uint32_t index_endian = 0x01020304;
+
+
+    template<typename T>
+    static void writeRaw(std::ostream& os, const T& t) {
+      os.write(reinterpret_cast<const char*>(&t), sizeof(T));
+    }
+
+    template<typename T>
+    static bool readRaw(std::istream& is, T& t) {
+      is.read(reinterpret_cast<char*>(&t), sizeof(T));
+      return(!is.fail());
+    }
+
+
+
+    TrajectoryFrameIndex::TrajectoryFrameIndex(const std::string& trajname, const std::string& format)
+      : trajname_(trajname), format_(format), traj_size_(0), traj_mtime_(0)
+    {
+      std::string::size_type i = trajname.rfind('/');
+      if (i == std::string::npos)
+        index_name_ = "." + trajname + ".lidx";
+      else
+        index_name_ = trajname.substr(0, i+1) + "." + trajname.substr(i+1) + ".lidx";
+    }
+
+
+    bool TrajectoryFrameIndex::statTrajectory(unsigned long& size, long& mtime) const {
+      struct stat sb;
+      if (stat(trajname_.c_str(), &sb) != 0 || !S_ISREG(sb.st_mode))
+        return(false);
+
+      size = sb.st_size;
+      mtime = sb.st_mtime;
+      return(true);
+    }
+
+
+    void TrajectoryFrameIndex::stamp() {
+      if (!statTrajectory(traj_size_, traj_mtime_))
+        traj_size_ = traj_mtime_ = 0;
+    }
+
+
+    std::vector<size_t> TrajectoryFrameIndex::offsets() const {
+      std::vector<size_t> offs(frames_.size());
+      for (uint i=0; i<frames_.size(); ++i)
+        offs[i] = frames_[i].offset;
+      return(offs);
+    }
+
+
+    bool TrajectoryFrameIndex::load() {
+      frames_.clear();
+      if (!use_cache_)
+        return(false);
+
+      unsigned long size;
+      long mtime;
+      if (!statTrajectory(size, mtime))
+        return(false);
+
+      std::ifstream ifs(index_name_.c_str(), std::ios_base::in | std::ios_base::binary);
+      if (!ifs.good())
+        return(false);
+
+      char magic[8];
+      char format[8];
+      boost::uint32_t version, endian;
+      boost::uint64_t stored_size, nframes;
+      boost::int64_t stored_mtime;
+
+      ifs.read(magic, sizeof(magic));
+      readRaw(ifs, version);
+      readRaw(ifs, endian);
+      ifs.read(format, sizeof(format));
+      readRaw(ifs, stored_size);
+      readRaw(ifs, stored_mtime);
+      if (!readRaw(ifs, nframes))
+        return(false);
+
+      if (memcmp(magic, index_magic, sizeof(magic)) != 0
+          || version != index_version
+          || endian != index_endian
+          || strncmp(format, format_.c_str(), sizeof(format)) != 0)
+        return(false);
+
+      // Trajectory has changed since the index was built...
+      if (stored_size != size || stored_mtime != mtime)
+        return(false);
+
+      // Sanity check, since every frame must occupy at least one byte
+      if (nframes > size)
+        return(false);
+
+      frames_.reserve(nframes);
+      for (boost::uint64_t i=0; i<nframes; ++i) {
+        Frame f;
+        boost::uint64_t offset;
+        boost::uint32_t natoms;
+        boost::int32_t step;
+
+        readRaw(ifs, offset);
+        readRaw(ifs, natoms);
+        readRaw(ifs, step);
+        readRaw(ifs, f.time);
+        readRaw(ifs, f.box[0]);
+        readRaw(ifs, f.box[1]);
+        if (!readRaw(ifs, f.box[2]) || offset >= size) {
+          frames_.clear();
+          return(false);
+        }
+
+        f.offset = offset;
+        f.natoms = natoms;
+        f.step = step;
+        frames_.push_back(f);
+      }
+
+      traj_size_ = size;
+      traj_mtime_ = mtime;
+      return(true);
+    }
+
+
+    bool TrajectoryFrameIndex::save() const {
+      if (!use_cache_ || traj_size_ == 0)
+        return(false);
+
+      // Write to a temporary file first and then rename, so concurrent
+      // readers never see a partially written index.  mkstemp() gives
+      // each writer (process or thread) its own temporary file...
+      std::string tmpname = index_name_ + ".tmp.XXXXXX";
+      std::vector<char> buf(tmpname.begin(), tmpname.end());
+      buf.push_back('\0');
+      int fd = mkstemp(&buf[0]);
+      if (fd < 0)
+        return(false);
+      fchmod(fd, 0644);     // mkstemp() creates the file owner-only
+      ::close(fd);
+      tmpname = &buf[0];
+
+      std::ofstream ofs(tmpname.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+      if (!ofs.good()) {
+        unlink(tmpname.c_str());
+        return(false);
+      }
+
+      char format[8];
+      memset(format, 0, sizeof(format));
+      strncpy(format, format_.c_str(), sizeof(format) - 1);
+
+      ofs.write(index_magic, sizeof(index_magic));
+      writeRaw(ofs, index_version);
+      writeRaw(ofs, index_endian);
+      ofs.write(format, sizeof(format));
+      writeRaw(ofs, static_cast<boost::uint64_t>(traj_size_));
+      writeRaw(ofs, static_cast<boost::int64_t>(traj_mtime_));
+      writeRaw(ofs, static_cast<boost::uint64_t>(frames_.size()));
+
+      for (std::vector<Frame>::const_iterator i = frames_.begin(); i != frames_.end(); ++i) {
+        writeRaw(ofs, static_cast<boost::uint64_t>(i->offset));
+        writeRaw(ofs, static_cast<boost::uint32_t>(i->natoms));
+        writeRaw(ofs, static_cast<boost::int32_t>(i->step));
+        writeRaw(ofs, i->time);
+        writeRaw(ofs, i->box[0]);
+        writeRaw(ofs, i->box[1]);
+        writeRaw(ofs, i->box[2]);
+      }
+
+      ofs.close();
+      if (ofs.fail() || rename(tmpname.c_str(), index_name_.c_str()) != 0) {
+        unlink(tmpname.c_str());
+        return(false);
+      }
+
+      return(true);
+    }
+
+  }
+
+}
@@ -0,0 +1,123 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2019, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#if !defined(LOOS_TRAJINDEX_HPP)
+#define LOOS_TRAJINDEX_HPP
+
+#include <string>
+#include <vector>
+
+#include <loos_defs.hpp>
+
+
+namespace loos {
+
+  namespace internal {
+
+    //! Persistent, on-disk frame index for trajectories without fixed-size frames
+    /**
+     * Formats such as XTC and TRR have no frame index in the file, so
+     * the whole trajectory must be scanned before the first frame can
+     * be used.  This class caches the results of that scan in a small
+     * sidecar file that lives next to the trajectory (a hidden file
+     * named ".<trajectory>.lidx").  Along with the byte offset of each
+     * frame, the number of atoms, step, time, and periodic box are
+     * kept for each frame.
+     *
+     * The size and modification time of the trajectory are recorded
+     * when the index is built.  If either differs when the index is
+     * loaded (e.g. the trajectory was appended to), the index is
+     * considered stale and load() will fail, forcing a rescan.
+     *
+     * Failure to write the index (e.g. a read-only directory) is not
+     * an error; the trajectory will simply be scanned every time.
+     * Caching can be globally disabled via
+     * TrajectoryFrameIndex::useCache(false).
+     */
+    class TrajectoryFrameIndex {
+    public:
+
+      //! Metadata stored for each frame
+      struct Frame {
+        Frame() : offset(0), natoms(0), step(0), time(0.0) {
+          box[0] = box[1] = box[2] = 0.0;
+        }
+
+        unsigned long offset;   // Byte offset to start of the frame
+        uint natoms;
+        int step;
+        double time;
+        double box[3];
+      };
+
+      //! \a trajname is the trajectory filename, \a format is a short tag identifying the format (e.g. "XTC")
+      TrajectoryFrameIndex(const std::string& trajname, const std::string& format);
+
+      //! Loads a previously saved index, returning false if it is missing or stale
+      bool load();
+
+      //! Writes the index to disk, returning false on failure
+      /**
+       * The trajectory's size and modification time are taken from
+       * when stamp() was last called, so that a trajectory that
+       * changes while it is being scanned will not be marked as
+       * valid.
+       */
+      bool save() const;
+
+      //! Record the current size and modification time of the trajectory
+      void stamp();
+
+      void clear() { frames_.clear(); }
+      void push_back(const Frame& f) { frames_.push_back(f); }
+
+      uint size() const { return(frames_.size()); }
+      bool empty() const { return(frames_.empty()); }
+      const Frame& operator[](const uint i) const { return(frames_[i]); }
+
+      //! Byte offsets for all frames
+      std::vector<size_t> offsets() const;
+
+      //! Name of the sidecar index file
+      std::string indexName() const { return(index_name_); }
+
+      //! Globally enable/disable reading and writing of index files
+      static void useCache(const bool b) { use_cache_ = b; }
+      static bool useCache() { return(use_cache_); }
+
+    private:
+      bool statTrajectory(unsigned long& size, long& mtime) const;
+
+      std::string trajname_, format_, index_name_;
+      unsigned long traj_size_;
+      long traj_mtime_;
+      std::vector<Frame> frames_;
+
+      static bool use_cache_;
+    };
+
+  }
+
+}
+
+
+#endif
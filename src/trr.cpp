@@ -29,6 +29,7 @@
 
 
 #include <trr.hpp>
+#include <trajindex.hpp>
 
 
 namespace loos {
@@ -116,6 +117,8 @@ namespace loos {
 
 	// Initialize the object, along with scanning file for frames to
 	// build the frame index, and finally caches the first frame.
+	// The frame index is cached on disk, so if a valid one is found,
+	// the scan is skipped.
 	void TRR::init(void) {
 		Header h;
 		h.natoms = 0;
@@ -127,18 +130,55 @@ namespace loos {
 		rewindImpl();
 		frame_indices.clear();
 
+		bool use_index = (_filename != "istream");
+		internal::TrajectoryFrameIndex index(_filename, "TRR");
+		if (use_index && index.load()) {
+			frame_indices = index.offsets();
+			for (uint i=0; i<index.size(); ++i)
+				if (static_cast<int>(index[i].natoms) > maxatoms)
+					maxatoms = index[i].natoms;
+
+			coords_.reserve(maxatoms);
+			velo_.reserve(maxatoms);
+			forc_.reserve(maxatoms);
+
+			parseFrame();
+			cached_first = true;
+			return;
+		}
+		index.stamp();
+
 		size_t frame_start = (xdr_file.get())->tellg();
 		while (readHeader(h)) {
 			frame_indices.push_back(frame_start);
 			if (h.natoms > maxatoms)
 				maxatoms = h.natoms;
 
+			internal::TrajectoryFrameIndex::Frame frame;
+			frame.offset = frame_start;
+			frame.natoms = h.natoms;
+			frame.step = h.step;
+			frame.time = h.bDouble ? h.td : h.tf;
+
 			uint b = sizeof(internal::XDRReader::block_type);
 			// Correct if double-precision TRR file...
 			if (h.bDouble)
 				b = sizeof(double);
 
-			size_t offset = (h.box_size ? DIM*DIM*b : 0) + (h.vir_size ? DIM*DIM*b : 0)
+			// The box immediately follows the header, so grab it for the index
+			if (h.box_size) {
+				std::vector<double> frame_box;
+				if (h.bDouble)
+					readBlock<double>(frame_box, DIM*DIM, "box");
+				else
+					readBlock<float>(frame_box, DIM*DIM, "box");
+				frame.box[0] = frame_box[0] * 10.0;
+				frame.box[1] = frame_box[4] * 10.0;
+				frame.box[2] = frame_box[8] * 10.0;
+			}
+			index.push_back(frame);
+
+			size_t offset = (h.vir_size ? DIM*DIM*b : 0)
 				+ (h.pres_size ? DIM*DIM*b : 0) + (h.x_size ? h.natoms*DIM*b : 0)
 				+ (h.v_size ? h.natoms*DIM*b : 0) + (h.f_size ? h.natoms*DIM*b : 0);
 
@@ -146,6 +186,9 @@ namespace loos {
 			frame_start = (xdr_file.get())->tellg();
 		}
 
+		if (use_index)
+			index.save();
+
 		coords_.reserve(maxatoms);
 		velo_.reserve(maxatoms);
 		forc_.reserve(maxatoms);
@@ -69,6 +69,8 @@ namespace loos {
 	 * Since the TRR frame size is not fixed, the entire
 	 * trajectory will be quickly scanned to build up an index of where
 	 * the frames begin (see the loos::XTC class for more information).
+	 * As with XTC, this index is cached on disk and reused as long as
+	 * the trajectory file is unchanged.
 	 *
 	 * Finally, note that GROMACS stores data in nm whereas LOOS uses
 	 * angstroms, so coordinate/box data will be automatically scaled by
@@ -42,6 +42,7 @@
 
 #include <Selectors.hpp>
 #include <Parser.hpp>
+#include <DynamicSelection.hpp>
 
 #include <utils.hpp>
 
@@ -193,6 +194,16 @@ namespace loos {
    *  catcher cannot disambiguate between the two.
    */
   AtomicGroup selectAtoms(const AtomicGroup& source, const std::string selection) {
+
+    if (DynamicSelection::hasSpatialTerms(selection)) {
+      try {
+        DynamicSelection dynamic(source, selection);
+        return(dynamic.select());
+      }
+      catch(ParseError& e) {
+        throw(ParseError("Error in parsing '" + selection + "' ... " + e.what()));
+      }
+    }
   
     Parser parser;
 
@@ -290,6 +290,12 @@ namespace loos {
   }
 
   //! Applies a string-based selection to an atomic group...
+  /**
+   * Selections using the spatial terms (within, around, byres) are
+   * handled by a DynamicSelection, using the current coordinates.
+   * To re-evaluate them for each frame of a trajectory, use a
+   * DynamicSelection directly.
+   */
   AtomicGroup selectAtoms(const AtomicGroup&, const std::string);
 
 
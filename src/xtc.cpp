@@ -29,6 +29,16 @@
 
 
 #include <xtc.hpp>
+#include <trajindex.hpp>
+
+#include <deque>
+
+#include <boost/cstdint.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 
 namespace loos {
@@ -98,39 +108,87 @@ namespace loos {
   }
 
   
-  int XTC::decodebits(int* buf, uint nbits) {
+  // Reads bits from the compressed stream, most significant bit first.
+  // Rather than shifting in one byte at a time, each read loads the
+  // 64-bit word containing the current bit position.  The stream must
+  // be padded with at least 8 bytes past its end.
+
+  class XTC::BitReader {
+  public:
+    BitReader(const unsigned char* p) : data_(p), pos_(0) { }
+
+    //! Returns the next 64 bits, left-aligned, without consuming them.
+    /** At least 57 bits of the returned word are valid */
+    boost::uint64_t peek() const {
+      const unsigned char* p = data_ + (pos_ >> 3);
+      boost::uint64_t w = (static_cast<boost::uint64_t>(p[0]) << 56)
+        | (static_cast<boost::uint64_t>(p[1]) << 48)
+        | (static_cast<boost::uint64_t>(p[2]) << 40)
+        | (static_cast<boost::uint64_t>(p[3]) << 32)
+        | (static_cast<boost::uint64_t>(p[4]) << 24)
+        | (static_cast<boost::uint64_t>(p[5]) << 16)
+        | (static_cast<boost::uint64_t>(p[6]) << 8)
+        | static_cast<boost::uint64_t>(p[7]);
+      return(w << (pos_ & 0x07));
+    }
 
-    int mask = (1 << nbits) -1;
+    void skip(const uint nbits) { pos_ += nbits; }
 
-    unsigned char *cbuf = reinterpret_cast<unsigned char*>(buf) + 3*sizeof(*buf);
-    int cnt = buf[0];
-    uint lastbits = static_cast<uint>(buf[1]);
-    uint lastbyte = static_cast<uint>(buf[2]);
-    
-    int num = 0;
-    while (nbits >= 8) {
-      lastbyte = ( lastbyte << 8 ) | cbuf[cnt++];
-      num |=  (lastbyte >> lastbits) << (nbits - 8);
-      nbits -=8;
+    //! Reads an \a nbits (at most 32) unsigned integer
+    uint bits(const uint nbits) {
+      if (nbits == 0)
+        return(0);
+      uint num = static_cast<uint>(peek() >> (64 - nbits));
+      pos_ += nbits;
+      return(num);
     }
-    if (nbits > 0) {
-      if (lastbits < nbits) {
-        lastbits += 8;
-        lastbyte = (lastbyte << 8) | cbuf[cnt++];
+
+  private:
+    const unsigned char* data_;
+    unsigned long pos_;
+  };
+
+
+
+  // Reciprocals of magicints, so the small-integer unpacking can
+  // multiply rather than divide.  For a divisor d with l = ceil(log2(d)),
+  // m = floor(2^(32+l) / d) + 1 gives floor(n/d) == (n*m) >> (32+l) for
+  // all n < 2^32 (Granlund & Montgomery, 1994).  Since the numerators
+  // are limited to 31 bits, the product fits in 64 bits.
+
+  struct XTC::MagicReciprocals {
+    MagicReciprocals() {
+      for (int i=0; i<lastidx; ++i) {
+        uint d = magicints[i];
+        if (d == 0) {
+          multiplier[i] = 0;
+          shift[i] = 0;
+          continue;
+        }
+
+        uint l = 0;
+        while ((static_cast<boost::uint64_t>(1) << l) < d)
+          ++l;
+        shift[i] = 32 + l;
+        multiplier[i] = ((static_cast<boost::uint64_t>(1) << shift[i]) / d) + 1;
       }
-      lastbits -= nbits;
-      num |= (lastbyte >> lastbits) & ((1 << nbits) -1);
     }
-    num &= mask;
-    buf[0] = cnt;
-    buf[1] = static_cast<int>(lastbits);
-    buf[2] = static_cast<int>(lastbyte);
 
-    return(num);
-  }
+    boost::uint64_t multiplier[73];
+    uint shift[73];
+  };
+
+  const XTC::MagicReciprocals XTC::magic_reciprocals;
+
 
 
-  void XTC::decodeints(int* buf, const int nints, int nbits,
+  // Unpacks nints integers stored in mixed radix (given by sizes) in
+  // nbits.  The packed number is stored as a little-endian sequence of
+  // bytes, each read from the stream as 8 bits (with any remainder in
+  // the last one).  This is the general version that handles numbers
+  // of any size using long division on the bytes.
+
+  void XTC::decodeints(BitReader& reader, const int nints, int nbits,
                        uint* sizes, int* nums) {
     int bytes[32];
     int i, j, num_of_bytes, p, num;
@@ -138,11 +196,11 @@ namespace loos {
     bytes[1] = bytes[2] = bytes[3] = 0;
     num_of_bytes = 0;
     while (nbits > 8) {
-      bytes[num_of_bytes++] = decodebits(buf, 8);
+      bytes[num_of_bytes++] = reader.bits(8);
       nbits -= 8;
     }
     if (nbits > 0) {
-      bytes[num_of_bytes++] = decodebits(buf, nbits);
+      bytes[num_of_bytes++] = reader.bits(nbits);
     }
     for (i = nints-1; i > 0; i--) {
       num = 0;
@@ -158,48 +216,191 @@ namespace loos {
   }
 
 
+  // Reads a packed number of up to 56 bits (stored as described for
+  // decodeints()) as a single 64-bit integer.  The leading whole bytes
+  // are byte-swapped into place in one go, followed by the trailing
+  // partial byte.
+
+  inline boost::uint64_t XTC::readPacked(BitReader& reader, const uint nbits) {
+    boost::uint64_t w = reader.peek();
+    reader.skip(nbits);
+
+    uint nfull = (nbits - 1) / 8;
+    uint last = nbits - 8 * nfull;
+    boost::uint64_t lastbyte = (w << (8 * nfull)) >> (64 - last);
+    if (nfull == 0)
+      return(lastbyte);
+
+    const boost::uint64_t byte = 0xff;
+    boost::uint64_t swapped = ((w >> 56) & byte)
+      | ((w >> 40) & (byte << 8))
+      | ((w >> 24) & (byte << 16))
+      | ((w >> 8) & (byte << 24))
+      | ((w << 8) & (byte << 32))
+      | ((w << 24) & (byte << 40))
+      | ((w << 40) & (byte << 48));
+    swapped &= (static_cast<boost::uint64_t>(1) << (8 * nfull)) - 1;
+
+    return(swapped | (lastbyte << (8 * nfull)));
+  }
+
+
+  // Unpacks 3 integers in mixed radix, using 64-bit arithmetic when the
+  // packed number is small enough (which it nearly always is)
+
+  inline void XTC::decodeTriplet(BitReader& reader, const int nbits, uint* sizes, int* nums) {
+    if (nbits > 56) {
+      decodeints(reader, 3, nbits, sizes, nums);
+      return;
+    }
+
+    boost::uint64_t v = readPacked(reader, nbits);
+    boost::uint64_t q = v / sizes[2];
+    nums[2] = static_cast<int>(v - q * sizes[2]);
+    v = q;
+    q = v / sizes[1];
+    nums[1] = static_cast<int>(v - q * sizes[1]);
+    nums[0] = static_cast<int>(q);
+  }
+
+
+  // Fast path for the run-length encoded small integers.  All three
+  // use magicints[smallidx] as their radix, and the packed number is
+  // smallidx bits long.
+
+  inline void XTC::decodeSmallTriplet(BitReader& reader, const int smallidx, int* nums) {
+    if (smallidx > 31) {
+      uint sizes[3];
+      sizes[0] = sizes[1] = sizes[2] = magicints[smallidx];
+      decodeTriplet(reader, smallidx, sizes, nums);
+      return;
+    }
+
+    boost::uint64_t m = magic_reciprocals.multiplier[smallidx];
+    uint s = magic_reciprocals.shift[smallidx];
+    boost::uint64_t d = magicints[smallidx];
+
+    boost::uint64_t v = readPacked(reader, smallidx);
+    boost::uint64_t q = (v * m) >> s;
+    nums[2] = static_cast<int>(v - q * d);
+    v = q;
+    q = (v * m) >> s;
+    nums[1] = static_cast<int>(v - q * d);
+    nums[0] = static_cast<int>(q);
+  }
+
+
 
-  // Coordinates are converted into GCoords and stored in the object's
-  // coords_ vector
+  // Reads the compressed coordinate block of a frame into raw.  No
+  // decoding is done here (see decodeFrame()), so this only needs the
+  // file for as long as it takes to read the bytes.
 
-  bool XTC::readCompressedCoords(void)
+  bool XTC::readCompressedCoords(internal::XDRReader& xdr, RawFrame& raw)
   {
-    int minint[3], maxint[3], *lip;
-    int smallidx;
-    uint sizeint[3], sizesmall[3], bitsizeint[3] = {0,0,0}, size3;
-    int k, *buf1, *buf2, lsize, flag;
-    int smallnum, smaller, i, is_smaller, run;
-    xtc_t precision, inv_precision;
-    int tmp, *thiscoord,  prevcoord[3];
-    unsigned int bitsize;
-  
+    int lsize;
      
-    if (!xdr_file.read(lsize))
+    if (!xdr.read(lsize))
       return(false);
 
-    size3 = lsize * 3;
+    raw.lsize = lsize;
+    uint size3 = lsize * 3;
 
     /* Dont bother with compression for three atoms or less */
     if(lsize<=9) {
-      float* tmp = new xtc_t[size3];
-      xdr_file.read(tmp, size3);
-      for (uint i=0; i<size3; i += 3)
-        coords_.push_back(GCoord(tmp[i], tmp[i+1], tmp[i+2]) * 10.0);
-      delete[] tmp;
+      raw.compressed = false;
+      raw.xyz.resize(size3);
+      if (size3 > 0)
+        xdr.read(&(raw.xyz[0]), size3);
       return(true);
     }
 
     /* Compression-time if we got here. Read precision first */
-    xdr_file.read(precision);
-    precision_ = precision;
+    raw.compressed = true;
+    xdr.read(raw.precision);
+    xdr.read(raw.minint, 3);
+    xdr.read(raw.maxint, 3);
   
+    if (!xdr.read(raw.smallidx))
+      return(false);
+
+    int nbytes;
+    if (!xdr.read(nbytes))
+      return(false);
+
+    // Pad the buffer since the BitReader loads 8 bytes at a time
+    raw.bytes.assign(nbytes + 16, 0);
+    if (!xdr.read(reinterpret_cast<char*>(&(raw.bytes[0])), static_cast<uint>(nbytes)))
+      return(false);
+
+    return(true);
+  }
+
+
+
+  bool XTC::readUncompressedCoords(internal::XDRReader& xdr, const std::string& fname, RawFrame& raw) 
+  {
+      uint lsize;
+      
+      if (!xdr.read(lsize))
+	  return(false);
+      
+      raw.compressed = false;
+      raw.lsize = lsize;
+      uint size3 = lsize * 3;
+      raw.xyz.resize(size3);
+      uint n = (size3 == 0) ? 0 : xdr.read(&(raw.xyz[0]), size3);
+      if (n != size3)
+	throw(FileReadError(fname, "XTC Error: number of uncompressed coords read did not match number expected"));
+      
+      return(true);
+  }
+
+
+  // Reads the next frame (header and coordinate data) from the
+  // stream, but does not decode the coordinates
+
+  bool XTC::readRawFrame(internal::XDRReader& xdr, const std::string& fname, const uint natoms, RawFrame& raw) {
+    if (!readFrameHeader(xdr, fname, raw.header))
+      return(false);
+
+    if (natoms <= min_compressed_system_size)
+      return(readUncompressedCoords(xdr, fname, raw));
+    else
+      return(readCompressedCoords(xdr, raw));
+  }
+
+
+
+  // Coordinates are converted into GCoords and stored in coords
+
+  void XTC::decodeFrame(const RawFrame& raw, std::vector<GCoord>& coords)
+  {
+    int *lip;
+    int smallidx;
+    uint sizeint[3], bitsizeint[3] = {0,0,0}, size3;
+    int k, lsize, flag;
+    int smallnum, smaller, i, is_smaller, run;
+    xtc_t inv_precision;
+    int tmp, *thiscoord,  prevcoord[3];
+    unsigned int bitsize;
+    const int* minint = raw.minint;
+    const int* maxint = raw.maxint;
+
+    coords.clear();
+    lsize = raw.lsize;
+    size3 = lsize * 3;
+
+    if (!raw.compressed) {
+      coords.reserve(lsize);
+      for (uint i=0; i<size3; i += 3)
+        coords.push_back(GCoord(raw.xyz[i], raw.xyz[i+1], raw.xyz[i+2]) * 10.0);
+      return;
+    }
+
+    coords.reserve(lsize);
     int size3padded = static_cast<int>(size3 * 1.2);
-    buf1 = new int[size3padded];
-    buf2 = new int[size3padded];
-    /* buf2[0-2] are special and do not contain actual data */
-    buf2[0] = buf2[1] = buf2[2] = 0;
-    xdr_file.read(minint, 3);
-    xdr_file.read(maxint, 3);
+    std::vector<int> buf1(size3padded);
+    BitReader reader(&(raw.bytes[0]));
   
     sizeint[0] = maxint[0] - minint[0]+1;
     sizeint[1] = maxint[1] - minint[1]+1;
@@ -215,47 +416,25 @@ namespace loos {
       bitsize = sizeofints(sizeint, 3);
     }
 	
-    if (!xdr_file.read(smallidx)) {
-      delete[] buf1;
-      delete[] buf2;
-      return(false);
-    }
-
-    tmp=smallidx+8;
+    smallidx = raw.smallidx;
     tmp = smallidx-1;
     tmp = (firstidx>tmp) ? firstidx : tmp;
     smaller = magicints[tmp] / 2;
     smallnum = magicints[smallidx] / 2;
-    sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx] ;
 
-    /* buf2[0] holds the length in bytes */
-  
-    if (!xdr_file.read(buf2, 1)) {
-      delete[] buf1;
-      delete[] buf2;
-      return(false);
-    }
-
-    if (!xdr_file.read(reinterpret_cast<char*>(&(buf2[3])), static_cast<uint>(buf2[0]))) {
-      delete[] buf1;
-      delete[] buf2;
-      return(false);
-    }
-    buf2[0] = buf2[1] = buf2[2] = 0;
-  
-    inv_precision = 1.0 / precision;
+    inv_precision = 1.0 / raw.precision;
     run = 0;
     i = 0;
-    lip = buf1;
+    lip = &(buf1[0]);
     while ( i < lsize ) {
       thiscoord = (int *)(lip) + i * 3;
     
       if (bitsize == 0) {
-        thiscoord[0] = decodebits(buf2, bitsizeint[0]);
-        thiscoord[1] = decodebits(buf2, bitsizeint[1]);
-        thiscoord[2] = decodebits(buf2, bitsizeint[2]);
+        thiscoord[0] = reader.bits(bitsizeint[0]);
+        thiscoord[1] = reader.bits(bitsizeint[1]);
+        thiscoord[2] = reader.bits(bitsizeint[2]);
       } else {
-        decodeints(buf2, 3, bitsize, sizeint, thiscoord);
+        decodeTriplet(reader, bitsize, sizeint, thiscoord);
       }
     
       i++;
@@ -267,10 +446,10 @@ namespace loos {
       prevcoord[1] = thiscoord[1];
       prevcoord[2] = thiscoord[2];
     
-      flag = decodebits(buf2, 1);
+      flag = reader.bits(1);
       is_smaller = 0;
       if (flag == 1) {
-        run = decodebits(buf2, 5);
+        run = reader.bits(5);
         is_smaller = run % 3;
         run -= is_smaller;
         is_smaller--;
@@ -278,7 +457,7 @@ namespace loos {
       if (run > 0) {
         thiscoord += 3;
         for (k = 0; k < run; k+=3) {
-          decodeints(buf2, 3, smallidx, sizesmall, thiscoord);
+          decodeSmallTriplet(reader, smallidx, thiscoord);
           i++;
           thiscoord[0] += prevcoord[0] - smallnum;
           thiscoord[1] += prevcoord[1] - smallnum;
@@ -294,7 +473,7 @@ namespace loos {
             tmp = thiscoord[2]; thiscoord[2] = prevcoord[2];
             prevcoord[2] = tmp;
 
-            coords_.push_back(GCoord(prevcoord[0] * inv_precision,
+            coords.push_back(GCoord(prevcoord[0] * inv_precision,
                                 prevcoord[1] * inv_precision,
                                 prevcoord[2] * inv_precision) * 10.0);
           } else {
@@ -302,12 +481,12 @@ namespace loos {
             prevcoord[1] = thiscoord[1];
             prevcoord[2] = thiscoord[2];
           }
-          coords_.push_back(GCoord(thiscoord[0] * inv_precision,
+          coords.push_back(GCoord(thiscoord[0] * inv_precision,
                               thiscoord[1] * inv_precision,
                               thiscoord[2] * inv_precision) * 10.0);
         }
       } else {
-        coords_.push_back(GCoord(thiscoord[0] * inv_precision,
+        coords.push_back(GCoord(thiscoord[0] * inv_precision,
                             thiscoord[1] * inv_precision,
                             thiscoord[2] * inv_precision) * 10.0);
       }
@@ -323,39 +502,181 @@ namespace loos {
         smaller = smallnum;
         smallnum = magicints[smallidx] / 2;
       }
-      sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx] ;
     }
 
-    delete[] buf1;
-    delete[] buf2;
-    return(true);
   }
 
 
+  // Reads and decodes frames on a pool of threads.  Reading from the
+  // stream is serialized (it is shared with the XTC object), but the
+  // decoding is done concurrently.  Frames are queued in the order
+  // they were scheduled, so they are always handed back in order even
+  // though they may finish decoding out of order.
+
+  class XTC::DecodePool {
+
+    struct Slot {
+      Slot(const uint i) : index(i), ready(false), ok(false) { }
+
+      uint index;
+      bool ready, ok;
+      std::string error;
+      RawFrame raw;
+      std::vector<GCoord> coords;
+    };
+
+  public:
+    DecodePool(std::istream* stream, const std::vector<size_t>& offsets, const std::string& fname,
+               const uint natoms, const uint nthreads, const uint depth)
+      : stream_(stream), xdr_(stream), offsets_(offsets), filename_(fname), natoms_(natoms),
+        nthreads_(nthreads), depth_(depth), stop_(false), running_(false),
+        next_(0), step_(1), last_(0), have_last_(false)
+    { }
+
+    ~DecodePool() { stop(); }
+
+
+    // Returns frame i.  If it isn't the next one in the queue, the
+    // pool is restarted beginning with that frame.
+    bool get(const uint i, RawFrame& raw, std::vector<GCoord>& coords) {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+
+      if (!running_ || slots_.empty() || slots_.front().index != i) {
+        uint step = (have_last_ && i > last_) ? i - last_ : 1;
+        lock.unlock();
+        restart(i, step);
+        lock.lock();
+      }
+      last_ = i;
+      have_last_ = true;
+
+      while (slots_.empty() || !slots_.front().ready)
+        cond_.wait(lock);
+
+      Slot& slot = slots_.front();
+      bool ok = slot.ok;
+      std::string error = slot.error;
+      raw = slot.raw;
+      coords.swap(slot.coords);
+      slots_.pop_front();
+      cond_.notify_all();
+      lock.unlock();
+
+      if (!error.empty())
+        throw(FileReadError(filename_, error));
+      return(ok);
+    }
+
+
+  private:
+
+    void restart(const uint first, const uint step) {
+      stop();
+
+      next_ = first;
+      step_ = step;
+      running_ = true;
+      for (uint i=0; i<nthreads_; ++i)
+        threads_.push_back(new boost::thread(boost::bind(&DecodePool::worker, this)));
+    }
+
+
+    void stop() {
+      if (!running_)
+        return;
+
+      {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        stop_ = true;
+        cond_.notify_all();
+      }
+
+      for (std::vector<boost::thread*>::iterator i = threads_.begin(); i != threads_.end(); ++i) {
+        (*i)->join();
+        delete *i;
+      }
+      threads_.clear();
+
+      slots_.clear();
+      stop_ = running_ = false;
+    }
+
+
+    void worker() {
+      while (true) {
+        Slot* slot;
+        uint index;
+
+        {
+          boost::unique_lock<boost::mutex> lock(mutex_);
+          while (true) {
+            if (stop_ || next_ >= offsets_.size())
+              return;
+            if (slots_.size() < depth_)
+              break;
+            cond_.wait(lock);
+          }
+
+          index = next_;
+          next_ += step_;
+          slots_.push_back(Slot(index));
+          slot = &(slots_.back());     // Safe, since the slot cannot be popped until ready
+        }
+
+        RawFrame raw;
+        std::vector<GCoord> coords;
+        bool ok = false;
+        std::string error;
+
+        try {
+          {
+            boost::lock_guard<boost::mutex> lock(io_mutex_);
+            stream_->clear();
+            stream_->seekg(offsets_[index], std::ios_base::beg);
+            ok = readRawFrame(xdr_, filename_, natoms_, raw);
+          }
+
+          if (ok) {
+            decodeFrame(raw, coords);
+            std::vector<unsigned char>().swap(raw.bytes);     // No longer needed, so avoid copying it
+            std::vector<xtc_t>().swap(raw.xyz);
+          }
+        }
+        catch (std::exception& e) {
+          error = e.what();
+        }
+        catch (...) {
+          error = "Unknown error while decoding XTC frame";
+        }
+
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        slot->raw = raw;
+        slot->coords.swap(coords);
+        slot->ok = ok;
+        slot->error = error;
+        slot->ready = true;
+        cond_.notify_all();
+      }
+    }
+
+
+    std::istream* stream_;
+    internal::XDRReader xdr_;
+    std::vector<size_t> offsets_;
+    std::string filename_;
+    uint natoms_;
+    uint nthreads_, depth_;
+
+    boost::mutex mutex_, io_mutex_;
+    boost::condition_variable cond_;
+    std::deque<Slot> slots_;
+    std::vector<boost::thread*> threads_;
+    bool stop_, running_;
+    uint next_, step_;
+    uint last_;
+    bool have_last_;
+  };
 
-  bool XTC::readUncompressedCoords(void) 
-  {
-      uint lsize;
-      
-      if (!xdr_file.read(lsize))
-	  return(false);
-      
-      uint size3 = lsize * 3;
-      coords_ = std::vector<GCoord>(lsize);
-      float* tmp_coords = new float[size3];
-      uint n = xdr_file.read(tmp_coords, size3);
-      if (n != size3)
-	throw(FileReadError(_filename, "XTC Error: number of uncompressed coords read did not match number expected"));
-      
-      uint i = 0;
-      for (uint j=0; j<lsize; ++j, i += 3)
-	  coords_[j] = GCoord(tmp_coords[i], tmp_coords[i+1], tmp_coords[i+2]) * 10.0;
-      
-      delete[] tmp_coords;
-      return(true);
-  }
-    
-	      
 
   void XTC::updateGroupCoordsImpl(AtomicGroup& g) {
 
@@ -371,7 +692,29 @@ namespace loos {
   }
 
 
+  void XTC::useFrameHeader(const RawFrame& raw) {
+    current_header_ = raw.header;
+    box = GCoord(current_header_.box[0], 
+		 current_header_.box[4], 
+		 current_header_.box[8]) * 10.0; // Convert to Angstroms
+    if (raw.compressed)
+      precision_ = raw.precision;
+  }
+
+
   bool XTC::parseFrame(void) {
+    if (pool_) {
+      uint i = currentFrame();
+      if (i >= frame_indices.size())
+        return(false);
+
+      coords_.clear();
+      if (!pool_->get(i, raw_, coords_))
+        return(false);
+      useFrameHeader(raw_);
+      return(true);
+    }
+
     if (ifs->eof())
       return(false);
 
@@ -379,20 +722,16 @@ namespace loos {
     // point will invalidate the current object's coord state
 
     coords_.clear();
-    if (!readFrameHeader(current_header_))
+    if (!readRawFrame(xdr_file, _filename, natoms_, raw_))
       return(false);
     
-    box = GCoord(current_header_.box[0], 
-		 current_header_.box[4], 
-		 current_header_.box[8]) * 10.0; // Convert to Angstroms
-    if (natoms_ <= min_compressed_system_size)
-	return(readUncompressedCoords());
-    else
-	return(readCompressedCoords());
+    useFrameHeader(raw_);
+    decodeFrame(raw_, coords_);
+    return(true);
   }
 
 
-  bool XTC::readFrameHeader(XTC::Header& hdr) {
+  bool XTC::readFrameHeader(internal::XDRReader& xdr_file, const std::string& fname, XTC::Header& hdr) {
     int magic_no;
     int ok = xdr_file.read(magic_no);
     if (!ok)
@@ -400,7 +739,7 @@ namespace loos {
     if (magic_no != magic) {
       std::ostringstream oss;
       oss << "Invalid XTC magic number (got " << magic_no << " but expected " << magic << ")";
-      throw(FileReadError(_filename, oss.str()));
+      throw(FileReadError(fname, oss.str()));
     }
 
     // Defer error-checks until the end...
@@ -410,7 +749,7 @@ namespace loos {
     xdr_file.read(hdr.time);
     ok = xdr_file.read(hdr.box, 9);
     if (!ok)
-      throw(FileReadError(_filename, "Problem reading XTC header"));
+      throw(FileReadError(fname, "Problem reading XTC header"));
 
     return(true);
   }
@@ -419,8 +758,22 @@ namespace loos {
   // Scan the trajectory file, skipping each compressed frame.  In the
   // process, we build up an index relating file-pos to frame index.
   // This permits fast seeking of indivual frames.
+  //
+  // If a valid on-disk index exists for this trajectory, it is used
+  // instead and no scan is necessary.  Otherwise, the index is saved
+  // after the scan for subsequent use.
   void XTC::scanFrames(void) {
     frame_indices.clear();
+
+    bool use_index = (_filename != "istream");
+    internal::TrajectoryFrameIndex index(_filename, "XTC");
+    if (use_index) {
+      if (index.load()) {
+        restoreFromIndex(index);
+        return;
+      }
+      index.stamp();
+    }
     
     rewindImpl();
 
@@ -429,13 +782,25 @@ namespace loos {
     while (! ifs->eof()) {
       size_t pos = ifs->tellg();
 
-      bool ok = readFrameHeader(h);
+      bool ok = readFrameHeader(xdr_file, _filename, h);
       if (!ok) {
         rewindImpl();
+        if (use_index)
+          index.save();
         return;
       }
 
       frame_indices.push_back(pos);
+
+      internal::TrajectoryFrameIndex::Frame frame;
+      frame.offset = pos;
+      frame.natoms = h.natoms;
+      frame.step = h.step;
+      frame.time = h.time;
+      frame.box[0] = h.box[0] * 10.0;
+      frame.box[1] = h.box[4] * 10.0;
+      frame.box[2] = h.box[8] * 10.0;
+      index.push_back(frame);
       if (natoms_ == 0)
         natoms_ = h.natoms;
       else if (natoms_ != h.natoms)
@@ -477,13 +842,70 @@ namespace loos {
   }
 
 
+  void XTC::restoreFromIndex(const internal::TrajectoryFrameIndex& index) {
+    frame_indices = index.offsets();
+    natoms_ = index.empty() ? 0 : index[0].natoms;
+
+    // Mimic the timestep estimate from scanFrames()
+    for (uint i=0; i<index.size(); ++i)
+      if (index[i].step != 0)
+        timestep_ = index[i].time / index[i].step;
+
+    rewindImpl();
+  }
+
+
   void XTC::seekFrameImpl(const uint i) {
     if (i >= frame_indices.size())
       throw(FileError(_filename, "Requested XTC frame is out of range"));
     
+    // The decode pool does its own seeking...
+    if (pool_)
+      return;
+
     ifs->clear();
     ifs->seekg(frame_indices[i], std::ios_base::beg);
   }
 
+
+  void XTC::rewindImpl(void) {
+    if (pool_)
+      return;
+
+    ifs->clear();
+    ifs->seekg(0);
+  }
+
+
+  void XTC::decodeThreads(const uint n, const uint depth) {
+    pool_.reset();
+    decode_threads_ = (n > 1) ? n : 0;
+
+    if (decode_threads_ == 0) {
+      // Leave the stream where the serial reader expects it to be,
+      // i.e. at the start of the next frame
+      uint next = currentFrame() + 1;
+      ifs->clear();
+      if (next < frame_indices.size())
+        ifs->seekg(frame_indices[next], std::ios_base::beg);
+      else
+        ifs->seekg(0, std::ios_base::end);
+      return;
+    }
+
+    pool_ = boost::shared_ptr<DecodePool>(new DecodePool(ifs.get(), frame_indices, _filename, natoms_,
+                                                         decode_threads_, depth ? depth : 2 * decode_threads_));
+  }
+
+
+  pTraj XTC::createParallel(const std::string& fname, const AtomicGroup&) {
+    XTC* xtc = new XTC(fname);
+    pTraj traj(xtc);
+
+    uint n = boost::thread::hardware_concurrency();
+    xtc->decodeThreads(n > 8 ? 8 : n);
+    return(traj);
+  }
+
 }
 
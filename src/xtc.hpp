@@ -44,9 +44,15 @@
 #include <Trajectory.hpp>
 
 #include <boost/format.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/cstdint.hpp>
 
 namespace loos {
 
+  namespace internal {
+    class TrajectoryFrameIndex;
+  }
+
 
   //! Class representing GROMACS reduced precision, compressed trajectories
   /**
@@ -56,7 +62,18 @@ namespace loos {
    * frames and to build an index that allows seeking to specific
    * frames.  This is done by reading only enough of each frame header
    * to permit building the index, so it should be a pretty fast
-   * operation.
+   * operation.  The resulting index is cached on disk alongside the
+   * trajectory (see internal::TrajectoryFrameIndex) so subsequent
+   * opens of the same file can skip the scan.
+   *
+   * Decompressing the coordinates is expensive.  When decodeThreads()
+   * is set to more than one thread, frames following the current one
+   * are read and decoded concurrently by a pool of threads and handed
+   * back in order.  The pool guesses the step between frames from the
+   * last two frames requested, so both sequential reads and reads
+   * with a fixed stride benefit.  Any other access pattern still
+   * works, but is slower since the pool must be restarted.  The "pxtc"
+   * trajectory type enables this automatically.
    */
   class XTC : public Trajectory {
 
@@ -81,12 +98,30 @@ namespace loos {
     //! Size of the data stored in the XTC file
     typedef float    xtc_t;
 
+    // The undecoded contents of a frame, as read from the file
+    struct RawFrame {
+      Header header;
+      bool compressed;
+      int lsize;
+      float precision;
+      int minint[3], maxint[3];
+      int smallidx;
+      std::vector<xtc_t> xyz;    // Uncompressed coordinates
+      std::vector<unsigned char> bytes;   // Compressed bit-stream (zero padded)
+    };
+
+    class DecodePool;
+    class BitReader;
+    struct MagicReciprocals;
+
+    static const MagicReciprocals magic_reciprocals;
+
   public:
-    explicit XTC(const std::string& s) : Trajectory(s), xdr_file(ifs.get()),natoms_(0) {
+    explicit XTC(const std::string& s) : Trajectory(s), xdr_file(ifs.get()),natoms_(0), decode_threads_(0) {
       init();
     }
 
-    explicit XTC(std::istream& is) : Trajectory(is), xdr_file(ifs.get()), natoms_(0) {
+    explicit XTC(std::istream& is) : Trajectory(is), xdr_file(ifs.get()), natoms_(0), decode_threads_(0) {
       init();
     }
 
@@ -95,6 +130,19 @@ namespace loos {
       return(pTraj(new XTC(fname)));
     }
 
+    //! Creates an XTC that decodes frames in parallel (using up to 8 threads)
+    static pTraj createParallel(const std::string& fname, const AtomicGroup& model);
+
+    //! Decode upcoming frames using \a n threads (0 or 1 decodes serially)
+    /**
+     * Up to \a depth frames will be decoded ahead of the current one.
+     * The default is twice the number of threads.
+     */
+    void decodeThreads(const uint n, const uint depth = 0);
+
+    //! Number of threads used for decoding frames
+    uint decodeThreads() const { return(decode_threads_); }
+
     uint natoms(void) const { return(natoms_); }
     float timestep(void) const { return(timestep_); }
     uint nframes(void) const { return(frame_indices.size()); }
@@ -128,24 +176,34 @@ namespace loos {
     std::vector<GCoord> coords_;
     double timestep_;
     Header current_header_;
+    RawFrame raw_;
+    uint decode_threads_;
+    boost::shared_ptr<DecodePool> pool_;
     
     bool parseFrame(void);
 
   private:
 
-    int sizeofint(int);
-    int sizeofints(uint*, const uint);
-    int decodebits(int*, uint);
-    void decodeints(int*, const int, int, uint*, int*);
-    bool readFrameHeader(Header&);
+    static int sizeofint(int);
+    static int sizeofints(uint*, const uint);
+    static void decodeints(BitReader&, const int, int, uint*, int*);
+    static boost::uint64_t readPacked(BitReader&, const uint);
+    static void decodeTriplet(BitReader&, const int, uint*, int*);
+    static void decodeSmallTriplet(BitReader&, const int, int*);
+    static bool readFrameHeader(internal::XDRReader&, const std::string&, Header&);
+    static bool readRawFrame(internal::XDRReader&, const std::string&, const uint, RawFrame&);
+    static bool readCompressedCoords(internal::XDRReader&, RawFrame&);
+    static bool readUncompressedCoords(internal::XDRReader&, const std::string&, RawFrame&);
+    static void decodeFrame(const RawFrame&, std::vector<GCoord>&);
+    void useFrameHeader(const RawFrame&);
     void scanFrames(void);
+    void restoreFromIndex(const internal::TrajectoryFrameIndex&);
     
     void seekNextFrameImpl(void) { }
     void seekFrameImpl(uint);
-    void rewindImpl(void) { ifs->clear(); ifs->seekg(0); }
+    void rewindImpl(void);
     void updateGroupCoordsImpl(AtomicGroup& g);
-    bool readCompressedCoords(void);
-    bool readUncompressedCoords(void);
+    void updateArenaCoordsImpl(CoordinateArena& arena) { arena.coords(coords_); }
   };
 
 }
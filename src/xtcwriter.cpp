@@ -23,6 +23,16 @@
 #include <xtcwriter.hpp>
 #include <xtc.hpp>
 
+#include <deque>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
 namespace loos 
 {
   
@@ -219,6 +229,8 @@ Library.
 
   const int XTCWriter::DIM = 3;
 
+  uint XTCWriter::default_threads_ = 0;
+
   /* Internal support routines for reading/writing compressed coordinates 
    * sizeofint - calculate smallest number of bits necessary
    * to represent a certain integer.
@@ -384,7 +396,8 @@ Library.
 
 
 
-  void XTCWriter::writeCompressedCoordsFloat(float* ptr, int size, float precision) 
+  void XTCWriter::writeCompressedCoordsFloat(internal::XDRWriter& out, float* ptr, int size, float precision,
+                                             int* buf1, int* buf2) const
   {
     int minint[3], maxint[3], mindiff, *lip, diff;
     int lint1, lint2, lint3, oldlint1, oldlint2, oldlint3, smallidx;
@@ -403,21 +416,20 @@ Library.
     bitsizeint[1] = 0;
     bitsizeint[2] = 0;
 
-    allocateBuffers(size);
-    if (!xdr.write(size))
+    if (!out.write(size))
       throw(FileWriteError(_filename, "Could not write size to XTC file"));
 
     /* Dont bother with compression for three atoms or less */
     if(size<=9) 
     {
-      xdr.write(ptr, size3);
+      out.write(ptr, size3);
       return;
     }
     /* Compression-time if we got here. Write precision first */
     if (precision <= 0)
       precision = 1000;
 
-    xdr.write(precision);
+    out.write(precision);
     /* buf2[0-2] are special and do not contain actual data */
     buf2[0] = buf2[1] = buf2[2] = 0;
     minint[0] = minint[1] = minint[2] = INT_MAX;
@@ -480,8 +492,8 @@ Library.
       oldlint2 = lint2;
       oldlint3 = lint3;
     }  
-    xdr.write(minint, 3);
-    xdr.write(maxint, 3);
+    out.write(minint, 3);
+    out.write(maxint, 3);
   
     if ((float)maxint[0] - (float)minint[0] >= INT_MAX-2 ||
 	(float)maxint[1] - (float)minint[1] >= INT_MAX-2 ||
@@ -514,7 +526,7 @@ Library.
     {
       smallidx++;
     }
-    xdr.write(smallidx);
+    out.write(smallidx);
     tmp=smallidx+8;
     maxidx = (lastidx<tmp) ? lastidx : tmp;
     minidx = maxidx - 8; /* often this equal smallidx */
@@ -646,8 +658,8 @@ Library.
       }   
     }
     if (buf2[1] != 0) buf2[0]++;
-    xdr.write(buf2[0]);
-    tmp=xdr.write((char *)&(buf2[3]),(unsigned int)buf2[0]);
+    out.write(buf2[0]);
+    tmp=out.write((char *)&(buf2[3]),(unsigned int)buf2[0]);
     if(tmp!=(unsigned int)buf2[0])
       throw(FileWriteError(_filename, "Error while writing compressed coordinates to XTC file"));
   }
@@ -676,19 +688,259 @@ Library.
   }
 
 
+  namespace internal {
+
+    // Compresses frames for an XTCWriter on a pool of threads.  Each
+    // frame is compressed into its own buffer by whichever worker gets
+    // to it first, and a single writer thread appends the buffers to
+    // the file in the order the frames were submitted.
+
+    class XTCCompressionPool {
+
+      struct Job {
+        uint seq;
+        uint step;
+        float time;
+        float precision;
+        GCoord box;
+        std::vector<float> crds;
+      };
+
+    public:
+      XTCCompressionPool(const XTCWriter* writer, std::ostream* stream, const std::string& fname,
+                         const uint nthreads, const uint depth)
+        : writer_(writer), stream_(stream), filename_(fname), depth_(depth),
+          stop_(false), reported_(false), next_seq_(0), written_(0)
+      {
+        for (uint i=0; i<nthreads; ++i)
+          threads_.push_back(new boost::thread(boost::bind(&XTCCompressionPool::worker, this)));
+        threads_.push_back(new boost::thread(boost::bind(&XTCCompressionPool::writer, this)));
+      }
+
+
+      // Writes out anything still queued.  This may be called from a
+      // destructor, so an error no one has seen yet goes to stderr
+      // rather than being thrown.
+      ~XTCCompressionPool() {
+        {
+          boost::unique_lock<boost::mutex> lock(mutex_);
+          while (written_ < next_seq_ && error_.empty())
+            cond_.wait(lock);
+          stop_ = true;
+          cond_.notify_all();
+        }
+
+        for (std::vector<boost::thread*>::iterator i = threads_.begin(); i != threads_.end(); ++i) {
+          (*i)->join();
+          delete *i;
+        }
+
+        // Whatever the stream still buffers would fail silently otherwise
+        if (error_.empty())
+          flushStream();
+
+        if (!error_.empty() && !reported_)
+          std::cerr << "Error- " << error_ << " (" << filename_ << ")\n"
+                    << "\tSome frames were not written.  Call XTCWriter::flush() to catch this.\n";
+      }
+
+
+      // Queues a frame, blocking if too many are already in flight.
+      // crds is swapped out, so its contents are lost.
+      void submit(const uint step, const float time, const GCoord& box, std::vector<float>& crds, const float precision) {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        while (next_seq_ - written_ >= depth_ && error_.empty())
+          cond_.wait(lock);
+        if (!error_.empty()) {
+          reported_ = true;
+          throw(FileWriteError(filename_, error_));
+        }
+
+        jobs_.push_back(Job());
+        Job& job = jobs_.back();
+        job.seq = next_seq_++;
+        job.step = step;
+        job.time = time;
+        job.precision = precision;
+        job.box = box;
+        job.crds.swap(crds);
+        cond_.notify_all();
+      }
+
+
+      void flush() {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        while (written_ < next_seq_ && error_.empty())
+          cond_.wait(lock);
+        if (error_.empty())
+          flushStream();
+        if (!error_.empty()) {
+          reported_ = true;
+          throw(FileWriteError(filename_, error_));
+        }
+      }
+
+
+    private:
+
+      // Only safe when the writer thread is idle or gone
+      void flushStream() {
+        stream_->flush();
+        if (stream_->fail())
+          error_ = "Error while writing compressed coordinates to XTC file";
+      }
+
+
+      void worker() {
+        std::vector<int> buf1, buf2;
+
+        while (true) {
+          Job job;
+          {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            while (jobs_.empty() && !stop_)
+              cond_.wait(lock);
+            if (stop_)
+              return;
+            job.seq = jobs_.front().seq;
+            job.step = jobs_.front().step;
+            job.time = jobs_.front().time;
+            job.precision = jobs_.front().precision;
+            job.box = jobs_.front().box;
+            job.crds.swap(jobs_.front().crds);
+            jobs_.pop_front();
+          }
+
+          std::string output;
+          std::string error;
+          try {
+            uint n = job.crds.size() / 3;
+            uint size3 = n * 3;
+            if (buf1.size() < size3 || buf1.empty()) {
+              buf1.resize(size3 > 0 ? size3 : 1);
+              buf2.resize(size3 > 0 ? static_cast<size_t>(size3 * 1.2) : 1);
+            }
+
+            std::ostringstream oss(std::ios_base::out | std::ios_base::binary);
+            XDRWriter out(&oss);
+            writer_->writeHeader(out, n, job.step, job.time);
+            writer_->writeBox(out, job.box);
+            writer_->writeCompressedCoordsFloat(out, job.crds.empty() ? 0 : &(job.crds[0]), n, job.precision,
+                                                &(buf1[0]), &(buf2[0]));
+            output = oss.str();
+          }
+          catch (std::exception& e) {
+            error = e.what();
+          }
+          catch (...) {
+            error = "Unknown error while compressing XTC frame";
+          }
+
+          boost::unique_lock<boost::mutex> lock(mutex_);
+          if (!error.empty()) {
+            if (error_.empty())
+              error_ = error;
+          } else
+            done_[job.seq].swap(output);
+          cond_.notify_all();
+        }
+      }
+
+
+      void writer() {
+        while (true) {
+          std::string output;
+          {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            std::map<uint, std::string>::iterator i;
+            while (true) {
+              if (stop_ || !error_.empty())
+                return;
+              i = done_.find(written_);
+              if (i != done_.end())
+                break;
+              cond_.wait(lock);
+            }
+            output.swap(i->second);
+            done_.erase(i);
+          }
+
+          stream_->write(output.data(), output.size());
+
+          boost::unique_lock<boost::mutex> lock(mutex_);
+          if (stream_->fail())
+            error_ = "Error while writing compressed coordinates to XTC file";
+          else
+            ++written_;
+          cond_.notify_all();
+        }
+      }
+
+
+      const XTCWriter* writer_;
+      std::ostream* stream_;
+      std::string filename_;
+      uint depth_;
+
+      boost::mutex mutex_;
+      boost::condition_variable cond_;
+      std::deque<Job> jobs_;
+      std::map<uint, std::string> done_;
+      std::vector<boost::thread*> threads_;
+      std::string error_;
+      bool stop_;
+      bool reported_;        // error_ has been thrown to the caller
+      uint next_seq_, written_;
+    };
+
+  }
+
+
+
+  XTCWriter::~XTCWriter() {
+    pool_.reset();
+    delete[] buf1;
+    delete[] buf2;
+    delete[] crds_;
+  }
+
+
+  void XTCWriter::compressionThreads(const uint n, const uint depth) {
+    if (pool_)
+      pool_->flush();
+    pool_.reset();
+
+    threads_ = (n > 1) ? n : 0;
+    if (threads_ > 0)
+      pool_ = boost::shared_ptr<internal::XTCCompressionPool>(new internal::XTCCompressionPool(this, stream_, _filename, threads_,
+                                                                                               depth ? depth : 4 * threads_));
+  }
+
+
+  void XTCWriter::flush() {
+    if (pool_)
+      pool_->flush();
+    else {
+      stream_->flush();
+      if (stream_->fail())
+        throw(FileWriteError(_filename, "Error while writing to XTC file"));
+    }
+  }
+
+
   // Write a frame header
-  void XTCWriter::writeHeader(const int natoms, const int step, const float time) {
+  void XTCWriter::writeHeader(internal::XDRWriter& out, const int natoms, const int step, const float time) const {
     int magic = 1995;
 
-    xdr.write(magic);
-    xdr.write(natoms);
-    xdr.write(step);
-    xdr.write(time);
+    out.write(magic);
+    out.write(natoms);
+    out.write(step);
+    out.write(time);
   }
 
 
   // Write a periodic box, translating from A to nm
-  void XTCWriter::writeBox(const GCoord& box) {
+  void XTCWriter::writeBox(internal::XDRWriter& out, const GCoord& box) const {
     float outbox[DIM*DIM];
     for (uint i=0; i < DIM*DIM; ++i)
       outbox[i] = 0.0;
@@ -696,7 +948,7 @@ Library.
     outbox[4] = box[1] / 10.0;
     outbox[8] = box[2] / 10.0; 
 
-    xdr.write(outbox, DIM*DIM);
+    out.write(outbox, DIM*DIM);
   }
 
   
@@ -704,10 +956,24 @@ Library.
   // Write a frame, converting units from A to nm.  Will allocate a temp array to hold coords...
   void XTCWriter::writeFrame(const AtomicGroup& model, const uint step, const double time) {
 
-    writeHeader(model.size(), step, time);
-    writeBox(model.periodicBox());
     uint n = model.size();
 
+    if (pool_) {
+      std::vector<float> crds(n * 3);
+      for (uint i=0,k=0; i<n; ++i) {
+        GCoord c = model[i]->coords();
+        crds[k++] = c.x() / 10.0;       // Convert to nm
+        crds[k++] = c.y() / 10.0;
+        crds[k++] = c.z() / 10.0;
+      }
+      pool_->submit(step, time, model.periodicBox(), crds, precision_);
+      ++current_;
+      return;
+    }
+
+    writeHeader(xdr, n, step, time);
+    writeBox(xdr, model.periodicBox());
+
     if (n > crds_size_) {
       delete[] crds_;
       crds_ = new float[n * 3];
@@ -720,7 +986,8 @@ Library.
       crds_[k++] = c.y() / 10.0;
       crds_[k++] = c.z() / 10.0;
     }
-    writeCompressedCoordsFloat(crds_, n, precision_);
+    allocateBuffers(n);
+    writeCompressedCoordsFloat(xdr, crds_, n, precision_, buf1, buf2);
 
     ++current_;
   }
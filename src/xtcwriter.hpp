@@ -35,6 +35,10 @@
 
 namespace loos {
 
+  namespace internal {
+    class XTCCompressionPool;
+  }
+
   //! Class for writing Gromacs XTC trajectories
   /**
    * This code borrows heavily from the xdrfile-1.1b library provided
@@ -46,6 +50,18 @@ namespace loos {
    * counters, so you should use on form of writeFrame() or the other
    * and not mix them.  If you must, use currentStep() to update the
    * internal step counter (and possibly timePerStep()).
+   *
+   * Compressing the coordinates is expensive.  If compressionThreads()
+   * is set to more than one thread, writeFrame() instead queues the
+   * frame and returns.  Queued frames are compressed concurrently into
+   * separate buffers, which are then written to the file in order, so
+   * the output is identical to writing serially.  Only a limited
+   * number of frames are kept in flight; writeFrame() will block
+   * until there is room.  Errors may therefore be reported by a later
+   * writeFrame() or by flush().  Call flush() after the last frame;
+   * otherwise the destructor, which cannot throw, only prints errors
+   * for frames still in flight to stderr.  The default number of threads for new
+   * writers can be set with defaultCompressionThreads().
    */
 
 
@@ -77,11 +93,13 @@ namespace loos {
       current_(0),
       crds_size_(0),
       crds_(0),
-      precision_(1e3)
+      precision_(1e3),
+      threads_(0)
     {
       xdr.setStream(stream_);
       if (appending_)
 	prepareToAppend();
+      compressionThreads(default_threads_);
     }
 
 
@@ -96,11 +114,13 @@ namespace loos {
       current_(0),
       crds_size_(0),
       crds_(0),
-      precision_(1e3)
+      precision_(1e3),
+      threads_(0)
     {
       xdr.setStream(stream_);
       if (appending_)
 	prepareToAppend();
+      compressionThreads(default_threads_);
     }
 
 
@@ -115,11 +135,13 @@ namespace loos {
       current_(0),
       crds_size_(0),
       crds_(0),
-      precision_(precision)
+      precision_(precision),
+      threads_(0)
     {
       xdr.setStream(stream_);
       if (appending_)
 	prepareToAppend();
+      compressionThreads(default_threads_);
     }
 
 
@@ -128,11 +150,7 @@ namespace loos {
 
 
 
-    ~XTCWriter() {
-      delete[] buf1;
-      delete[] buf2;
-      delete[] crds_;
-    }
+    ~XTCWriter();
 
 
     //! Get the time per step
@@ -162,18 +180,46 @@ namespace loos {
 
     uint framesWritten() const { return(current_); }
 
+    //! Compress frames using \a n threads (0 or 1 compresses serially)
+    /**
+     * Up to \a depth frames may be queued.  The default is four times
+     * the number of threads.  Any frames already queued are written
+     * first.
+     */
+    void compressionThreads(const uint n, const uint depth = 0);
+
+    //! Number of threads used to compress frames
+    uint compressionThreads() const { return(threads_); }
+
+    //! Waits until all queued frames have been written to the file
+    /**
+     * Throws a FileWriteError if any queued frame could not be
+     * written.  This is the only way to see errors for the last
+     * frames written with compression threads.
+     */
+    void flush();
+
+    //! Sets the number of compression threads used by new XTCWriters
+    static void defaultCompressionThreads(const uint n) { default_threads_ = n; }
+
+    //! Number of compression threads used by new XTCWriters
+    static uint defaultCompressionThreads() { return(default_threads_); }
+
   private:
+    friend class internal::XTCCompressionPool;
+
     int sizeofint(const int size) const;
     int sizeofints(const int num_of_bits, const unsigned int sizes[]) const;
     void encodebits(int* buf, int num_of_bits, const int num) const;
     void encodeints(int* buf, const int num_of_ints, const int num_of_bits,
 		    const unsigned int* sizes, const unsigned int* nums) const;
-    void writeCompressedCoordsFloat(float* ptr, int size, float precision);
+    void writeCompressedCoordsFloat(internal::XDRWriter& out, float* ptr, int size, float precision,
+                                    int* buf1, int* buf2) const;
        
     void allocateBuffers(const size_t size);
 
-    void writeHeader(const int natoms, const int step, const float time);
-    void writeBox(const GCoord& box);
+    void writeHeader(internal::XDRWriter& out, const int natoms, const int step, const float time) const;
+    void writeBox(internal::XDRWriter& out, const GCoord& box) const;
 
     void prepareToAppend();
     
@@ -191,6 +237,10 @@ namespace loos {
     float precision_;
 
     internal::XDRWriter xdr;
+
+    uint threads_;
+    boost::shared_ptr<internal::XTCCompressionPool> pool_;
+    static uint default_threads_;
   };
 
 